@@ -27,32 +27,94 @@ struct PointLight {
     vec3 specular;
 };
 
-#define NR_POINT_LIGHTS 2
+// variants (see ShaderVariants) define NR_POINT_LIGHTS, the lights in use (at least 1), and HAS_SPECULAR_MAP when
+// the material has one. without them, the generic shader tests both at run time
+#ifdef NR_POINT_LIGHTS
+#define POINT_LIGHT_SLOTS NR_POINT_LIGHTS
+#else
+#define GENERIC_MATERIAL
+#ifdef FRAME_BLOCKS
+#define POINT_LIGHT_SLOTS 7
+#else
+#define POINT_LIGHT_SLOTS 8
+uniform int pointLightCount;
+#endif
+uniform bool hasSpecularMap;
+#endif
 
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
 
+// FRAME_BLOCKS reads the camera and lights from the blocks FrameUniforms writes once per frame for every
+// program (see frame_uniforms.h): lights[0] is the directional light, the point lights follow
+#ifdef FRAME_BLOCKS
+struct Light {
+    vec4 position;
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+    vec4 attenuation;
+};
+layout (std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+};
+layout (std140) uniform Lights
+{
+    Light lights[8];
+    int lightCount;
+};
+#define VIEW_POS viewPos.xyz
+#define POINT_LIGHT_COUNT (lightCount - 1)
+#define DIR_LIGHT BlockDirLight()
+#define POINT_LIGHT(i) BlockPointLight(i)
+DirLight BlockDirLight()
+{
+    Light light = lights[0];
+    return DirLight(light.position.xyz, light.ambient.rgb, light.diffuse.rgb, light.specular.rgb);
+}
+PointLight BlockPointLight(int i)
+{
+    Light light = lights[i + 1];
+    return PointLight(light.position.xyz, light.attenuation.x, light.attenuation.y, light.attenuation.z,
+                      light.ambient.rgb, light.diffuse.rgb, light.specular.rgb);
+}
+#else
 uniform vec3 viewPos;
 uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
+uniform PointLight pointLights[POINT_LIGHT_SLOTS];
+#define VIEW_POS viewPos
+#define POINT_LIGHT_COUNT pointLightCount
+#define DIR_LIGHT dirLight
+#define POINT_LIGHT(i) pointLights[i]
+#endif
 uniform Material material;
 
 // function prototypes
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 SpecularMap();
 
 void main()
 {    
     // properties
     vec3 norm = normalize(Normal);
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 viewDir = normalize(VIEW_POS - FragPos);
     
     // directional lighting
-    vec3 result = CalcDirLight(dirLight, norm, viewDir);
+    vec3 result = CalcDirLight(DIR_LIGHT, norm, viewDir);
     // point lights
-    for(int i = 0; i < NR_POINT_LIGHTS; i++)
-        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
+    for(int i = 0; i < POINT_LIGHT_SLOTS; i++)
+    {
+#ifdef GENERIC_MATERIAL
+        if(i >= POINT_LIGHT_COUNT)
+            break;
+#endif
+        result += CalcPointLight(POINT_LIGHT(i), norm, FragPos, viewDir);
+    }
     
     FragColor = vec4(result, 1.0);
 }
@@ -69,7 +131,7 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     // combine results
     vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 specular = light.specular * spec * SpecularMap();
     return (ambient + diffuse + specular);
 }
 
@@ -88,10 +150,21 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     // combine results
     vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 specular = light.specular * spec * SpecularMap();
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
     return (ambient + diffuse + specular);
 }
 
+// the specular intensity of the fragment, none without a specular map
+vec3 SpecularMap()
+{
+#if defined(GENERIC_MATERIAL)
+    return hasSpecularMap ? vec3(texture(material.specular, TexCoords)) : vec3(0.0);
+#elif defined(HAS_SPECULAR_MAP)
+    return vec3(texture(material.specular, TexCoords));
+#else
+    return vec3(0.0);
+#endif
+}
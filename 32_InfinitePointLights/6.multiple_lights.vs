@@ -9,8 +9,17 @@ out vec3 Normal;
 out vec2 TexCoords;
 
 uniform mat4 model;
+#ifdef FRAME_BLOCKS
+layout (std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+};
+#else
 uniform mat4 view;
 uniform mat4 projection;
+#endif
 
 void main()
 {
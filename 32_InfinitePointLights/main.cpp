@@ -2,6 +2,8 @@
 //      Mouse: Arcball manipulation
 //      Keyboard: 'r' - reset arcball
 //                'a' - toggle camera/object rotation
+//                'u' - cycle how the light uniforms are set every frame, per program or once in the Lights block
+//                'v' - toggle the generic lighting shader and its variant for the scene
 //
 //      DON'T FORGET to edit your source directory name correctly:
 //         see the global variable: string sourceDir.
@@ -13,8 +15,12 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
 #include <cmath>
+#include <chrono>
 
 #include <shader.h>
+#include <learnopengl/shader_variants.h>
+#include <learnopengl/frame_uniforms.h>
+#include <learnopengl/program_cache.h>
 #include <cube.h>
 #include <arcball.h>
 #define STB_IMAGE_IMPLEMENTATION
@@ -30,6 +36,10 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action , int mo
 void mouse_button_callback(GLFWwindow *window, int button, int action, int mods);
 void cursor_position_callback(GLFWwindow *window, double x, double y);
 unsigned int loadTexture(const char *);
+void initLightingShader(Shader *shader, UniformHandle *handles);
+void setLights(Shader *shader, const UniformHandle *handles);
+void setBlockLights();
+void benchmarkUniforms(Shader *shader, const UniformHandle *handles);
 void render();
 
 // Global variables
@@ -38,8 +48,18 @@ void render();
 string sourceDirStr = "W:/Lecture/Graphics/Codes/Windows2024/32_InfinitePointLights/32_InfinitePointLights";
 
 GLFWwindow *mainWindow = NULL;
-Shader *lightingShader = NULL;
+Shader *lightingShader = NULL;     // the one drawing the cubes, picked by uniformMode and variantShader
 Shader *lampShader = NULL;
+// 6.multiple_lights.fs, generic and specialized on the scene's light count and material
+ShaderVariants<Shader> *lightingVariants = NULL;
+Shader *genericLightingShader = NULL;
+Shader *lightingVariant = NULL;
+// the same two reading the camera and lights from the Camera and Lights blocks (FRAME_BLOCKS)
+Shader *genericBlockShader = NULL;
+Shader *blockVariant = NULL;
+bool variantShader = true;
+// camera and lights written once per frame for every program, in the uniform block mode
+FrameUniforms *frameUniforms = NULL;
 unsigned int SCR_WIDTH = 600;
 unsigned int SCR_HEIGHT = 600;
 Cube *cube;
@@ -65,6 +85,60 @@ glm::vec3 pointLightPositions[] = {
     glm::vec3( 2.0f, -1.3f, -1.0f)
 };
 
+// lighting parameters of the fragment shader, set every frame as they would be with moving lights
+struct LightUniform {
+    const char *name;
+    int components;         // 1: float, 3: vec3
+    glm::vec3 value;
+};
+LightUniform lightUniforms[] = {
+    // directional light
+    { "dirLight.direction", 3, glm::vec3(-0.2f, -1.0f, -0.3f) },
+    { "dirLight.ambient", 3, glm::vec3(0.05f, 0.05f, 0.05f) },
+    { "dirLight.diffuse", 3, glm::vec3(0.4f, 0.4f, 0.4f) },
+    { "dirLight.specular", 3, glm::vec3(0.5f, 0.5f, 0.5f) },
+    // point light 1
+    { "pointLights[0].position", 3, pointLightPositions[0] },
+    { "pointLights[0].ambient", 3, glm::vec3(0.05f, 0.05f, 0.05f) },
+    { "pointLights[0].diffuse", 3, glm::vec3(0.8f, 0.8f, 0.8f) },
+    { "pointLights[0].specular", 3, glm::vec3(1.0f, 1.0f, 1.0f) },
+    { "pointLights[0].constant", 1, glm::vec3(1.0f) },
+    { "pointLights[0].linear", 1, glm::vec3(0.09f) },
+    { "pointLights[0].quadratic", 1, glm::vec3(0.032f) },
+    // point light 2
+    { "pointLights[1].position", 3, pointLightPositions[1] },
+    { "pointLights[1].ambient", 3, glm::vec3(0.05f, 0.05f, 0.05f) },
+    { "pointLights[1].diffuse", 3, glm::vec3(0.8f, 0.8f, 0.8f) },
+    { "pointLights[1].specular", 3, glm::vec3(1.0f, 1.0f, 1.0f) },
+    { "pointLights[1].constant", 1, glm::vec3(1.0f) },
+    { "pointLights[1].linear", 1, glm::vec3(0.09f) },
+    { "pointLights[1].quadratic", 1, glm::vec3(0.032f) },
+};
+const int NUM_LIGHT_UNIFORMS = sizeof(lightUniforms) / sizeof(lightUniforms[0]);
+const int NUM_POINT_LIGHTS = 2;
+// handles of lightUniforms in genericLightingShader [0] and lightingVariant [1]
+UniformHandle lightHandles[2][NUM_LIGHT_UNIFORMS];
+
+// 0: glGetUniformLocation and glUniform per set, 1: setters by name, 2: setters by handle, 3: Lights block
+int uniformMode = 2;
+const int NUM_UNIFORM_MODES = 4;
+const char *uniformModeNames[] = { "glGetUniformLocation", "by name", "by handle", "uniform block" };
+
+// light sets per timed run of benchmarkUniforms
+const int UNIFORM_RUNS = 10000;
+
+// uniform counts, printed every couple of seconds
+const double REPORT_SECONDS = 2.0;
+double reportStart = 0.0;
+int reportFrames = 0;
+unsigned long reportSets = 0, reportUploads = 0, reportLookups = 0;
+
+// GPU time of the cube draws, read one frame late so the CPU does not wait for it
+GLuint cubeQuery;
+bool cubeQueryPending = false;
+double reportGpuNanoseconds = 0.0;
+int reportGpuFrames = 0;
+
 // for texture
 static unsigned int diffuseMap, specularMap;  // texture ids for diffuse and specular maps
 
@@ -73,21 +147,27 @@ int main()
 {
     mainWindow = glAllInit();
     
-    // shader loading and compile (by calling the constructor)
+    // shader loading and compile (by calling the constructor), or loading of the programs linked by an earlier run
+    bool programCache = ProgramCache::Get().SetDirectory(sourceDirStr + "/shader_cache");
+    auto shaderStart = chrono::steady_clock::now();
     string vs = sourceDirStr + "/6.multiple_lights.vs";
     string fs = sourceDirStr + "/6.multiple_lights.fs";
-    lightingShader = new Shader(vs.c_str(), fs.c_str());
+    lightingVariants = new ShaderVariants<Shader>(vs, fs);
+    genericLightingShader = &lightingVariants->Get();
 
     vs = sourceDirStr + "/6.lamp.vs";
     fs = sourceDirStr + "/6.lamp.fs";
     lampShader = new Shader(vs.c_str(), fs.c_str());
+    // a warm start is the second run on the same driver
+    const ProgramCacheStats &cacheStats = ProgramCache::Get().GetStats();
+    printf("shaders ready in %.2f ms, program cache %s (%u loaded, %u compiled)\n",
+           chrono::duration<double, milli>(chrono::steady_clock::now() - shaderStart).count(),
+           !programCache ? "not available" : cacheStats.misses + cacheStats.rejected ? "cold" : "warm",
+           cacheStats.hits, cacheStats.misses + cacheStats.rejected);
     
     // projection and view matrix
-    lightingShader->use();
     projection = glm::perspective(glm::radians(45.0f),
                                   (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-    lightingShader->setMat4("projection", projection);
-    
     lampShader->use();
     lampShader->setMat4("projection", projection);
     
@@ -97,36 +177,27 @@ int main()
     imgFileName + sourceDirStr + "/container2_specular.bmp";
     specularMap = loadTexture(imgFileName.c_str());
     
-    // transfer texture id to fragment shader
-    lightingShader->use();
-    lightingShader->setInt("material.diffuse", 0);
-    lightingShader->setInt("material.specular", 1);
-    lightingShader->setFloat("material.shininess", 32);
-    
-    lightingShader->setVec3("viewPos", cameraPos);
-    
-    // transfer lighting parameters to fragment shader
-    // directional light
-    lightingShader->setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-    lightingShader->setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
-    lightingShader->setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-    lightingShader->setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
-    // point light 1
-    lightingShader->setVec3("pointLights[0].position", pointLightPositions[0]);
-    lightingShader->setVec3("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-    lightingShader->setVec3("pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
-    lightingShader->setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-    lightingShader->setFloat("pointLights[0].constant", 1.0f);
-    lightingShader->setFloat("pointLights[0].linear", 0.09);
-    lightingShader->setFloat("pointLights[0].quadratic", 0.032);
-    // point light 2
-    lightingShader->setVec3("pointLights[1].position", pointLightPositions[1]);
-    lightingShader->setVec3("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-    lightingShader->setVec3("pointLights[1].diffuse", 0.8f, 0.8f, 0.8f);
-    lightingShader->setVec3("pointLights[1].specular", 1.0f, 1.0f, 1.0f);
-    lightingShader->setFloat("pointLights[1].constant", 1.0f);
-    lightingShader->setFloat("pointLights[1].linear", 0.09);
-    lightingShader->setFloat("pointLights[1].quadratic", 0.032);
+    // the variant of the scene : no loop bound or specular map test left to the fragments
+    ShaderDefines defines;
+    defines.Set("NR_POINT_LIGHTS", NUM_POINT_LIGHTS);
+    if (specularMap != 0)
+        defines.Set("HAS_SPECULAR_MAP");
+    lightingVariant = &lightingVariants->Get(defines);
+    genericBlockShader = &lightingVariants->Get(ShaderDefines().Set("FRAME_BLOCKS"));
+    blockVariant = &lightingVariants->Get(defines.Set("FRAME_BLOCKS"));
+    initLightingShader(genericLightingShader, lightHandles[0]);
+    initLightingShader(lightingVariant, lightHandles[1]);
+    initLightingShader(genericBlockShader, NULL);
+    initLightingShader(blockVariant, NULL);
+    // every program of the demo exists now : drop the binaries of edited shaders
+    unsigned int prunedPrograms = ProgramCache::Get().Prune();
+    if (prunedPrograms > 0)
+        printf("program cache: %u stale binaries removed\n", prunedPrograms);
+    lightingShader = lightingVariant;
+    frameUniforms = new FrameUniforms();
+    frameUniforms->SetProjection(projection);
+    benchmarkUniforms(genericLightingShader, lightHandles[0]);
+    glGenQueries(1, &cubeQuery);
     
     // create a cubes
     cube = new Cube();
@@ -136,6 +207,9 @@ int main()
         glfwPollEvents();
     }
     
+    glDeleteQueries(1, &cubeQuery);
+    delete frameUniforms;
+    delete lightingVariants;
     glfwTerminate();
     return 0;
 }
@@ -203,6 +277,7 @@ unsigned int loadTexture(const char *texFileName) {
     int width, height, nrChannels;
     stbi_set_flip_vertically_on_load(true);   // vertical flip the texture
     unsigned char *image = stbi_load(texFileName, &width, &height, &nrChannels, 0);
+    stbi_set_flip_vertically_on_load(false);  // the flag is global : back off, as TextureCache expects it
     if (!image) {
         printf("texture %s loading error ... \n", texFileName);
     }
@@ -219,16 +294,120 @@ unsigned int loadTexture(const char *texFileName) {
     return texture;
 }
 
+// the uniforms set once, and the handles of the lighting parameters for the per-frame sets in render().
+// the FRAME_BLOCKS shaders take no handles : their camera and lights are in the blocks
+void initLightingShader(Shader *shader, UniformHandle *handles) {
+    shader->use();
+    shader->setMat4("projection", projection);
+    
+    // transfer texture id to fragment shader
+    shader->setInt("material.diffuse", 0);
+    shader->setInt("material.specular", 1);
+    shader->setFloat("material.shininess", 32);
+    
+    shader->setVec3("viewPos", cameraPos);
+    
+    // what the generic shader tests per fragment; a variant does not have these uniforms
+    shader->setInt("pointLightCount", NUM_POINT_LIGHTS);
+    shader->setBool("hasSpecularMap", specularMap != 0);
+    
+    for (int i = 0; handles != NULL && i < NUM_LIGHT_UNIFORMS; i++)
+        handles[i] = shader->uniform(lightUniforms[i].name);
+}
+
+// transfer lighting parameters to fragment shader, the way uniformMode selects
+void setLights(Shader *shader, const UniformHandle *handles) {
+    if (uniformMode == 3) {
+        setBlockLights();
+        frameUniforms->Upload();
+        return;
+    }
+    for (int i = 0; i < NUM_LIGHT_UNIFORMS; i++) {
+        const LightUniform &light = lightUniforms[i];
+        if (uniformMode == 0) {
+            GLint location = glGetUniformLocation(shader->ID, light.name);
+            if (light.components == 3) glUniform3fv(location, 1, &light.value[0]);
+            else glUniform1f(location, light.value.x);
+        }
+        else if (uniformMode == 1) {
+            if (light.components == 3) shader->setVec3(light.name, light.value);
+            else shader->setFloat(light.name, light.value.x);
+        }
+        else {
+            if (light.components == 3) shader->setVec3(handles[i], light.value);
+            else shader->setFloat(handles[i], light.value.x);
+        }
+    }
+    // the raw calls went around the shader's record of the values
+    if (uniformMode == 0)
+        shader->invalidateUniforms();
+}
+
+// the lights of lightUniforms in the Lights block : the directional light first, then the point lights
+void setBlockLights() {
+    const LightUniform *dir = &lightUniforms[0];
+    frameUniforms->SetDirectionalLight(0, dir[0].value, dir[1].value, dir[2].value, dir[3].value);
+    for (int i = 0; i < NUM_POINT_LIGHTS; i++) {
+        const LightUniform *point = &lightUniforms[4 + 7 * i];
+        frameUniforms->SetPointLight(i + 1, point[0].value, point[1].value, point[2].value, point[3].value,
+                                     point[4].value.x, point[5].value.x, point[6].value.x);
+    }
+    frameUniforms->SetLightCount(1 + NUM_POINT_LIGHTS);
+}
+
+/*CPU time of one light uniform set, for every mode: once with the values
+forgotten before each run so every set reaches GL, and once repeating the
+values already set, which the setters skip. the block mode writes all the
+lights and uploads the buffer in every run, however many programs read it*/
+void benchmarkUniforms(Shader *shader, const UniformHandle *handles) {
+    shader->use();
+    int savedMode = uniformMode;
+    for (int repeated = 0; repeated < 2; repeated++) {
+        printf("light uniforms, %s values:", repeated ? "repeated" : "changed ");
+        for (uniformMode = 0; uniformMode < NUM_UNIFORM_MODES; uniformMode++) {
+            glFinish();
+            auto start = chrono::steady_clock::now();
+            for (int run = 0; run < UNIFORM_RUNS; run++) {
+                if (!repeated)
+                    shader->invalidateUniforms();
+                setLights(shader, handles);
+            }
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            glFinish();
+            printf("  %s %.1f ns", uniformModeNames[uniformMode], ms * 1.0e6 / ((double)UNIFORM_RUNS * NUM_LIGHT_UNIFORMS));
+        }
+        printf("\n");
+    }
+    uniformMode = savedMode;
+}
+
 void render() {
     
+    if (cubeQueryPending) {
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(cubeQuery, GL_QUERY_RESULT, &nanoseconds);
+        reportGpuNanoseconds += (double)nanoseconds;
+        reportGpuFrames++;
+        cubeQueryPending = false;
+    }
+    
+    UniformStats::Get().Reset();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     
     view = glm::lookAt(cameraPos, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
     view = view * camArcBall.createRotationMatrix();
     
     // cube objects
+    if (uniformMode == 3) {
+        lightingShader = variantShader ? blockVariant : genericBlockShader;
+        frameUniforms->SetView(view, cameraPos);
+    }
+    else
+        lightingShader = variantShader ? lightingVariant : genericLightingShader;
     lightingShader->use();
-    lightingShader->setMat4("view", view);
+    if (uniformMode != 3)
+        lightingShader->setMat4("view", view);
+    setLights(lightingShader, lightHandles[variantShader ? 1 : 0]);
     
     // texture
     glActiveTexture(GL_TEXTURE0);
@@ -237,6 +416,7 @@ void render() {
     glBindTexture(GL_TEXTURE_2D, specularMap);
     
     // cube1
+    glBeginQuery(GL_TIME_ELAPSED, cubeQuery);
     model = glm::mat4(1.0f);
     model = model * modelArcBall.createRotationMatrix();
     lightingShader->setMat4("model", model);
@@ -253,6 +433,8 @@ void render() {
     model = glm::translate(model, glm::vec3(-1.5f, 2.0f, 1.0f));
     lightingShader->setMat4("model", model);
     cube->draw(lightingShader);
+    glEndQuery(GL_TIME_ELAPSED);
+    cubeQueryPending = true;
     
     // lamps (point lights)
     lampShader->use();
@@ -265,6 +447,26 @@ void render() {
         cube->draw(lampShader);
     }
     
+    // uniform cost of the frame, averaged over REPORT_SECONDS
+    reportFrames++;
+    reportSets += UniformStats::Get().sets;
+    reportUploads += UniformStats::Get().uploads;
+    reportLookups += UniformStats::Get().lookups;
+    double now = glfwGetTime();
+    if (now - reportStart >= REPORT_SECONDS) {
+        printf("%-20s: %lu sets/frame, %lu uploaded, %lu skipped, %lu glGetUniformLocation/frame\n",
+               uniformModeNames[uniformMode], reportSets / reportFrames, reportUploads / reportFrames,
+               (reportSets - reportUploads) / reportFrames, reportLookups / reportFrames);
+        if (reportGpuFrames > 0)
+            printf("%-20s: %.1f us GPU/frame for the cubes\n", variantShader ? "lighting variant" : "lighting generic",
+                   reportGpuNanoseconds / reportGpuFrames / 1.0e3);
+        reportGpuNanoseconds = 0.0;
+        reportGpuFrames = 0;
+        reportFrames = 0;
+        reportSets = reportUploads = reportLookups = 0;
+        reportStart = now;
+    }
+    
     glfwSwapBuffers(mainWindow);
 }
 
@@ -287,6 +489,22 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
         camArcBall.init(SCR_WIDTH, SCR_HEIGHT, arcballSpeed, true, true);
         modelArcBall.init(SCR_WIDTH, SCR_HEIGHT, arcballSpeed, true, true);
     }
+    else if (key == GLFW_KEY_U && action == GLFW_PRESS) {
+        uniformMode = (uniformMode + 1) % NUM_UNIFORM_MODES;
+        cout << "UNIFORMS: " << uniformModeNames[uniformMode] << endl;
+        // the block mode draws with other programs
+        reportGpuNanoseconds = 0.0;
+        reportGpuFrames = 0;
+        cubeQueryPending = false;
+    }
+    else if (key == GLFW_KEY_V && action == GLFW_PRESS) {
+        variantShader = !variantShader;
+        cout << "LIGHTING: " << (variantShader ? "variant" : "generic") << " shader" << endl;
+        // time the new shader only
+        reportGpuNanoseconds = 0.0;
+        reportGpuFrames = 0;
+        cubeQueryPending = false;
+    }
     else if (key == GLFW_KEY_A && action == GLFW_PRESS) {
         arcballCamRot = !arcballCamRot;
         if (arcballCamRot) {
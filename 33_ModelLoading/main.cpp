@@ -7,6 +7,7 @@
 
 // Std. Includes
 #include <string>
+#include <chrono>
 #include <iostream>
 
 // GLAD
@@ -17,6 +18,7 @@
 
 // GL includes
 #include <shader.h>
+#include <learnopengl/frame_uniforms.h>
 #include <arcball.h>
 #include <Model.h>
 #define STB_IMAGE_IMPLEMENTATION
@@ -47,6 +49,7 @@ unsigned int SCR_HEIGHT = 600;
 GLFWwindow *mainWindow = NULL;
 glm::mat4 projection;
 Shader *shader = NULL;
+FrameUniforms *frameUniforms = NULL;    // projection and view, shared by every program
 
 // For model
 Model *ourModel = NULL;
@@ -62,15 +65,21 @@ glm::vec3 cameraOrigPos(0.0f, 0.0f, 9.0f);
 glm::vec3 cameraPos; // current position of camera
 glm::vec3 modelPan(0.0f, 0.0f, 0.0f);  // model panning vector
 
+// false compiles and links the shader before loading the model, to compare the time to the first frame
+bool deferShaderLinks = true;
+
 
 int main( )
 {
+    auto startupStart = std::chrono::steady_clock::now();
     mainWindow = glAllInit();
 
-    // Create shader program object
+    // Create shader program object; a deferred link goes on in the driver while the model loads
+    bool parallelCompile = ShaderLinking::Get().SetDeferred(deferShaderLinks);
     string vs = sourceDirStr + "/modelLoading.vs";
     string fs = sourceDirStr + "/modelLoading.fs";
     shader = new Shader(vs.c_str(), fs.c_str());
+    frameUniforms = new FrameUniforms();
     
     // Load a model
     //string modelPath = modelDirStr + "/benz/gltf/benz.gltf";
@@ -80,16 +89,20 @@ int main( )
     //string modelPath = modelDirStr + "/planet/planet.obj";
     //string modelPath = modelDirStr + "/press1/gltf/scene.gltf";
     //string modelPath = modelDirStr + "/rock/rock.obj";
+    // tell stb_image.h to flip loaded texture's on the y-axis while the model loads. the flag is
+    // global, and TextureCache (learnopengl/texture_cache.h) decodes on threads expecting it off
+    stbi_set_flip_vertically_on_load(true);
     ourModel = new Model(modelPath);
+    stbi_set_flip_vertically_on_load(false);
     
     // Initializing projection transformation
     projection = glm::perspective(glm::radians(45.0f),
                                   (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 10000.0f);
-    shader->use();
-    shader->setMat4("projection", projection);
+    frameUniforms->SetProjection(projection);
     cameraPos = cameraOrigPos;
     
     // Game loop
+    bool firstFrame = true;
     while( !glfwWindowShouldClose( mainWindow ) )
     {
         glfwPollEvents( );
@@ -97,6 +110,14 @@ int main( )
         render();
         
         glfwSwapBuffers( mainWindow );
+        
+        if (firstFrame) {
+            glFinish();
+            printf("first frame after %.2f ms, shader links %s%s\n",
+                   std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupStart).count(),
+                   deferShaderLinks ? "deferred" : "immediate", parallelCompile ? ", parallel compile" : "");
+            firstFrame = false;
+        }
     }
     
     glfwTerminate( );
@@ -108,11 +129,12 @@ void render()
 {
     glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
     
-    shader->use();
-    
     glm::mat4 view = glm::lookAt(cameraPos, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
     view = view * camArcBall.createRotationMatrix();
-    shader->setMat4("view", view);
+    frameUniforms->SetView(view, glm::vec3(glm::inverse(view)[3]));
+    frameUniforms->Upload();
+    
+    shader->use();
     
     // Draw the loaded model
     glm::mat4 model(1.0);
@@ -167,9 +189,6 @@ GLFWwindow *glAllInit()
         exit(0);
     }
     
-    // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
-    stbi_set_flip_vertically_on_load(true);
-    
     // OpenGL initialization stuffs
     glViewport( 0, 0, SCR_WIDTH, SCR_HEIGHT );
     glClearColor( 0.1f, 0.1f, 0.1f, 1.0f );
@@ -187,8 +206,7 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     SCR_HEIGHT = height;
     projection = glm::perspective(glm::radians(45.0f),
                                   (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-    shader->use();
-    shader->setMat4("projection", projection); 
+    frameUniforms->SetProjection(projection);
 }
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
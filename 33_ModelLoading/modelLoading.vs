@@ -6,8 +6,12 @@ layout ( location = 2 ) in vec2 texCoords;
 out vec2 TexCoords;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+};
 
 void main( )
 {
@@ -0,0 +1,11 @@
+// bone palette : 4 RGBA32F texels per matrix, one matrix per bone
+uniform samplerBuffer finalBonesMatrices;
+
+mat4 getBoneMatrix(int boneId)
+{
+    int base = boneId * 4;
+    return mat4(texelFetch(finalBonesMatrices, base),
+                texelFetch(finalBonesMatrices, base + 1),
+                texelFetch(finalBonesMatrices, base + 2),
+                texelFetch(finalBonesMatrices, base + 3));
+}
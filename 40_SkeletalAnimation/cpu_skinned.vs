@@ -0,0 +1,18 @@
+#version 330 core
+
+// vertices already skinned on the CPU (learnopengl/cpu_skinning.h)
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec3 norm;
+layout(location = 2) in vec2 tex;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 model;
+
+out vec2 TexCoords;
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(pos, 1.0f);
+	TexCoords = tex;
+}
@@ -12,28 +12,73 @@ uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
 
-const int MAX_BONES = 100;
-const int MAX_BONE_INFLUENCE = 4;
-uniform mat4 finalBonesMatrices[MAX_BONES];
+#include "packed_vertex.glsl"
+#include "bone_palette.glsl"
 
 out vec2 TexCoords;
 
-void main()
+#ifdef BONE_INFLUENCES
+// variant (see ShaderVariants) : no vertex of the mesh has more than BONE_INFLUENCES influences.
+// the ones a vertex lacks have weight 0, so they add nothing without being tested. variants have
+// no skippedInfluences : the animation lod drops influences with the generic shader only
+vec4 skin(vec3 position)
+{
+#if BONE_INFLUENCES == 0
+    return vec4(position, 1.0f);
+#else
+    vec4 totalPosition = vec4(0.0f);
+    float totalWeight = 0.0f;
+    for(int i = 0 ; i < BONE_INFLUENCES ; i++)
+    {
+        totalPosition += getBoneMatrix(max(boneIds[i], 0)) * vec4(position, 1.0f) * weights[i];
+        totalWeight += weights[i];
+    }
+    // a vertex without influences isn't skinned : it stays in the bind pose, like on the CPU path
+    if(totalWeight == 0.0f)
+        return vec4(position, 1.0f);
+    return totalPosition;
+#endif
+}
+#else
+const int MAX_BONE_INFLUENCE = 4;
+// animation lod : influences are sorted by weight, far characters drop the last ones
+uniform int skippedInfluences;
+
+vec4 skin(vec3 position)
 {
+    int numBones = textureSize(finalBonesMatrices) / 4;
     vec4 totalPosition = vec4(0.0f);
-    for(int i = 0 ; i < MAX_BONE_INFLUENCE ; i++)
+    float totalWeight = 0.0f;
+    for(int i = 0 ; i < MAX_BONE_INFLUENCE - skippedInfluences ; i++)
     {
         if(boneIds[i] == -1) 
             continue;
-        if(boneIds[i] >=MAX_BONES) 
+        if(boneIds[i] >= numBones) 
         {
-            totalPosition = vec4(pos,1.0f);
+            totalPosition = vec4(position,1.0f);
+            totalWeight = 1.0f;
             break;
         }
-        vec4 localPosition = finalBonesMatrices[boneIds[i]] * vec4(pos,1.0f);
+        mat4 boneMatrix = getBoneMatrix(boneIds[i]);
+        vec4 localPosition = boneMatrix * vec4(position,1.0f);
         totalPosition += localPosition * weights[i];
-        vec3 localNormal = mat3(finalBonesMatrices[boneIds[i]]) * norm;
+        totalWeight += weights[i];
+        vec3 localNormal = mat3(boneMatrix) * unpackNormal(norm);
    }
+    // a vertex without influences isn't skinned : it stays in the bind pose, like on the CPU path
+    if(totalWeight == 0.0f)
+        return vec4(position, 1.0f);
+    // the kept weights no longer sum to 1
+    if(skippedInfluences > 0 && totalWeight > 0.0f)
+        totalPosition /= totalWeight;
+    return totalPosition;
+}
+#endif
+
+void main()
+{
+    vec3 position = unpackPosition(pos);
+    vec4 totalPosition = skin(position);
 	
     mat4 viewModel = view * model;
     gl_Position =  projection * viewModel * totalPosition;
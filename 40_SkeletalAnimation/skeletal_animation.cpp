@@ -6,10 +6,21 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <learnopengl/shader_m.h>
+#include <learnopengl/shader_variants.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/animator.h>
+#include <learnopengl/animation_blender.h>
+#include <learnopengl/bone_palette.h>
+#include <learnopengl/cpu_skinning.h>
 #include <learnopengl/model_animation.h>
+#include <learnopengl/animation_library.h>
+#include <learnopengl/program_cache.h>
+#include <chrono>
+#include <iomanip>
 #include <iostream>
+#include <sys/resource.h>
+#include <memory>
+#include <vector>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -20,6 +31,13 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 //void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
+long peakResidentKB();
+int runSelfTests(AnimationLibrary& library);
+bool testBlender(Animation* clipA, Animation* clipB);
+bool testPoseSampler(Animation* clip);
+void benchmarkKeySearch();
+void benchmarkClipSampling(Animation* clip);
+void benchmarkCpuSkinning(const string& modelPath);
 
 // GLOBAL VARIABLES
 
@@ -31,6 +49,22 @@ const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 GLFWwindow *mainWindow = NULL;
 Shader *ourShader = NULL;
+Shader *cpuSkinnedShader = NULL;
+// skel_anim.vs specialized per mesh on its bone influence count
+ShaderVariants<Shader> *skinVariants = NULL;
+
+// C: skin on the CPU and stream the vertices, G: skin in skel_anim.vs
+bool cpuSkinning = false;
+
+// V: draw every mesh with its skel_anim.vs variant, B: with the generic skel_anim.vs
+bool shaderVariants = true;
+
+// false compiles and links every shader before loading the model, to compare the time to the first frame
+bool deferShaderLinks = true;
+
+// run with --self-test (or set this) to check and benchmark the animation code on the loaded clips and exit,
+// instead of opening the demo. kept out of the normal startup so the time to the first frame measures startup only
+bool selfTests = false;
 
 // camera
 Camera camera(glm::vec3(0.0f, 0.0f, 5.0f));
@@ -42,15 +76,32 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-int main()
+int main(int argc, char** argv)
 {
+    for (int i = 1; i < argc; i++)
+        selfTests = selfTests || string(argv[i]) == "--self-test";
+
+    auto startupStart = std::chrono::steady_clock::now();
     mainWindow = glAllInit();
 
-	// build and compile shaders
-	// -------------------------
+	// build and compile shaders, or load the programs linked by an earlier run.
+	// deferred links go on in the driver while the model loads
+	// -------------------------------------------------------------------------
+    bool programCache = ProgramCache::Get().SetDirectory(sourceDirStr + "/shader_cache");
+    bool parallelCompile = ShaderLinking::Get().SetDeferred(deferShaderLinks);
+    auto shaderStart = std::chrono::steady_clock::now();
     string vs = sourceDirStr + "/skel_anim.vs";
     string fs = sourceDirStr + "/skel_anim.fs";
-	ourShader = new Shader(vs.c_str(), fs.c_str());
+    skinVariants = new ShaderVariants<Shader>(vs, fs);
+	ourShader = &skinVariants->Get();
+    vs = sourceDirStr + "/cpu_skinned.vs";
+	cpuSkinnedShader = new Shader(vs.c_str(), fs.c_str());
+    // a warm start is the second run on the same driver
+    const ProgramCacheStats& cacheStats = ProgramCache::Get().GetStats();
+    std::cout << (deferShaderLinks ? "Shaders submitted in " : "Shaders ready in ")
+        << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shaderStart).count()
+        << " ms, program cache " << (!programCache ? "not available" : cacheStats.misses + cacheStats.rejected ? "cold" : "warm")
+        << " (" << cacheStats.hits << " loaded, " << cacheStats.misses + cacheStats.rejected << " compiled)" << std::endl;
 
 	// load models
 	// -----------
@@ -58,9 +109,73 @@ int main()
     string modelPath = modelDirStr + "/boxing/dae/boxing.dae";
     //string modelPath = modelDirStr + "/chapa/dae/Chapa-Giratoria.dae";
     
-    Model ourModel(modelPath);
-    Animation anim(modelPath, &ourModel);
+    // one import for the model and all of its clips, on one shared skeleton
+    AnimationLibrary library(modelPath);
+    //AnimationLibrary library(modelDirStr + "/farry/farry.fbx", { modelDirStr + "/farry/joyfulJump.fbx" });
+    if (!library.IsLoaded() || library.GetClipCount() == 0)
+        return -1;
+    std::cout << "Loaded " << library.GetClipCount() << " clips in " << library.GetLoadSeconds() * 1000.0
+        << " ms, peak resident memory " << peakResidentKB() << " KB" << std::endl;
+    if (selfTests)
+    {
+        int status = runSelfTests(library);
+        delete skinVariants;
+        glfwTerminate();
+        return status;
+    }
+    Model& ourModel = library.GetModel();
+    Animation& anim = *library.GetClip(0);
+    anim.Compress();
     Animator animator(&anim);
+    BonePalette bonePalette;
+
+    // the variant of every mesh, picked once : a loop over exactly the influences its vertices have.
+    // nothing uses them before the first draw, so deferred links finish while the setup below runs.
+    // variants ignore skippedInfluences : animation lod (42_AnimatedCrowd) draws with the generic shader
+    auto variantStart = std::chrono::steady_clock::now();
+    std::vector<Shader*> meshShaders;
+    for (unsigned int i = 0; i < ourModel.meshes.size(); i++)
+        meshShaders.push_back(&skinVariants->Get(ShaderDefines().Set("BONE_INFLUENCES", ourModel.meshes[i].getInfluenceCount())));
+    std::cout << skinVariants->GetCount() - 1 << " skinning variants for " << ourModel.meshes.size() << " meshes, "
+        << (deferShaderLinks ? "submitted in " : "ready in ")
+        << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - variantStart).count() << " ms" << std::endl;
+    // every program of the demo exists now : drop the binaries of edited shaders
+    unsigned int prunedPrograms = ProgramCache::Get().Prune();
+    if (prunedPrograms > 0)
+        std::cout << "Program cache: " << prunedPrograms << " stale binaries removed" << std::endl;
+
+    // CPU skinning : one SkinnedMesh per mesh, all skinned by the same engine. meshes without CPU-side vertices get none and keep GPU skinning
+    CpuSkinningEngine skinningEngine;
+    std::vector<std::unique_ptr<SkinnedMesh>> skinnedMeshes;
+    int skinnedVertexCount = 0;
+    int gpuOnlyMeshes = 0;
+    for (unsigned int i = 0; i < ourModel.meshes.size(); i++)
+    {
+        if (!SkinnedMesh::CanSkin(ourModel.meshes[i]))
+        {
+            skinnedMeshes.push_back(NULL);
+            gpuOnlyMeshes++;
+            continue;
+        }
+        skinnedMeshes.push_back(std::unique_ptr<SkinnedMesh>(new SkinnedMesh(ourModel.meshes[i], animator.GetBoneCount())));
+        skinnedVertexCount += skinnedMeshes.back()->GetVertexCount();
+    }
+    if (gpuOnlyMeshes > 0)
+        std::cout << gpuOnlyMeshes << " of " << ourModel.meshes.size() << " meshes have no CPU vertex data and stay GPU skinned in CPU skinning mode" << std::endl;
+
+    // benchmark : CPU skinning throughput, printed every two seconds while it is on
+    double skinSeconds = 0.0;
+    int skinFrames = 0;
+    bool firstFrame = true;
+
+    // benchmark : GPU time of the skinned draws, generic shader against the variants, printed every 200 frames.
+    // a query is read one frame late so the CPU does not wait for it
+    GLuint skinQuery;
+    glGenQueries(1, &skinQuery);
+    bool skinQueryPending = false;
+    double gpuSkinNanoseconds = 0.0;
+    int gpuSkinFrames = 0;
+    bool timedVariants = shaderVariants;
     
 	// draw in wireframe
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -79,39 +194,116 @@ int main()
 		// -----
 		processInput(mainWindow);
 		animator.UpdateAnimation(deltaTime);
+
+        if (skinQueryPending)
+        {
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(skinQuery, GL_QUERY_RESULT, &nanoseconds);
+            gpuSkinNanoseconds += (double)nanoseconds;
+            skinQueryPending = false;
+            if (timedVariants != shaderVariants)
+            {
+                // the frame timed the other shaders
+                timedVariants = shaderVariants;
+                gpuSkinNanoseconds = 0.0;
+                gpuSkinFrames = 0;
+            }
+            else if (++gpuSkinFrames == 200)
+            {
+                double perFrame = gpuSkinNanoseconds / gpuSkinFrames;
+                std::cout << "GPU skinning (" << (shaderVariants ? "variants" : "generic") << "): " << perFrame / 1.0e3
+                    << " us per frame, " << perFrame / skinnedVertexCount << " ns per vertex" << std::endl;
+                gpuSkinNanoseconds = 0.0;
+                gpuSkinFrames = 0;
+            }
+        }
 		
 		// render
 		// ------
 		glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		// don't forget to enable shader before setting uniforms
-		ourShader->use();
-
 		// view/projection transformations
 		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
 		glm::mat4 view = camera.GetViewMatrix();
-		ourShader->setMat4("projection", projection);
-		ourShader->setMat4("view", view);
-
-        auto transforms = animator.GetFinalBoneMatrices();
-		for (int i = 0; i < transforms.size(); ++i)
-			ourShader->setMat4("finalBonesMatrices[" + std::to_string(i) + "]", transforms[i]);
 
 		// render the loaded model
 		glm::mat4 model = glm::mat4(1.0f);
 		model = glm::translate(model, glm::vec3(0.0f, -0.4f, 0.0f)); // translate it down so it's at the center of the scene
 		model = glm::scale(model, glm::vec3(.5f, .5f, .5f));	// it's a bit too big for our scene, so scale it down
-		ourShader->setMat4("model", model);
-		ourModel.Draw(*ourShader);
+
+        if (cpuSkinning)
+        {
+            cpuSkinnedShader->use();
+            cpuSkinnedShader->setMat4("projection", projection);
+            cpuSkinnedShader->setMat4("view", view);
+            cpuSkinnedShader->setMat4("model", model);
+            for (unsigned int i = 0; i < skinnedMeshes.size(); i++)
+            {
+                if (!skinnedMeshes[i])
+                    continue;
+                skinningEngine.Skin(*skinnedMeshes[i], animator.GetFinalBoneMatrices().data());
+                skinSeconds += skinningEngine.GetLastSkinSeconds();
+                skinnedMeshes[i]->Upload();
+                skinnedMeshes[i]->Draw(ourModel.meshes[i], *cpuSkinnedShader);
+            }
+            if (skinnedVertexCount > 0 && ++skinFrames == 200)
+            {
+                double perCore = skinnedVertexCount * skinFrames / skinSeconds / skinningEngine.GetThreadCount();
+                std::cout << "CPU skinning: " << skinnedVertexCount << " vertices, " << skinningEngine.GetThreadCount()
+                    << " threads, " << perCore / 1.0e6 << " M vertices/s per core" << std::endl;
+                skinSeconds = 0.0;
+                skinFrames = 0;
+            }
+        }
+        // GPU skinning, in CPU mode only for the meshes that have no SkinnedMesh
+        if (!cpuSkinning || gpuOnlyMeshes > 0)
+        {
+            bonePalette.Upload(animator.GetFinalBoneMatrices());
+            bonePalette.Bind();
+
+            if (!cpuSkinning)
+                glBeginQuery(GL_TIME_ELAPSED, skinQuery);
+            for (unsigned int i = 0; i < ourModel.meshes.size(); i++)
+            {
+                if (cpuSkinning && skinnedMeshes[i])
+                    continue;
+                // don't forget to enable shader before setting uniforms; unchanged ones are skipped after the first mesh.
+                // the first use of a program waits for its link, inside the timed first frame
+                Shader* shader = shaderVariants ? meshShaders[i] : ourShader;
+                shader->use();
+                shader->setInt("finalBonesMatrices", BONE_PALETTE_TEXTURE_UNIT);
+                shader->setMat4("projection", projection);
+                shader->setMat4("view", view);
+                shader->setMat4("model", model);
+                ourModel.meshes[i].Draw(*shader);
+            }
+            if (!cpuSkinning)
+            {
+                glEndQuery(GL_TIME_ELAPSED);
+                skinQueryPending = true;
+            }
+        }
 
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
 		glfwSwapBuffers(mainWindow);
 		glfwPollEvents();
+
+        if (firstFrame)
+        {
+            glFinish();
+            std::cout << "First frame after " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupStart).count()
+                << " ms, shader links " << (deferShaderLinks ? "deferred" : "immediate")
+                << (parallelCompile ? ", parallel compile" : "") << std::endl;
+            firstFrame = false;
+        }
 	}
 
+    glDeleteQueries(1, &skinQuery);
+    delete skinVariants;
+
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 	// ------------------------------------------------------------------
 	glfwTerminate();
@@ -155,9 +347,6 @@ GLFWwindow *glAllInit()
         exit(-1);
     }
     
-    // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
-    stbi_set_flip_vertically_on_load(true);
-    
     // configure global opengl state
     // -----------------------------
     glEnable(GL_DEPTH_TEST);
@@ -171,6 +360,14 @@ void processInput(GLFWwindow* window)
 {
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, true);
+	if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS)
+		cpuSkinning = true;
+	if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS)
+		cpuSkinning = false;
+	if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS)
+		shaderVariants = true;
+	if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS)
+		shaderVariants = false;
 
     /*
 	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
@@ -199,3 +396,398 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
 	camera.ProcessMouseScroll(yoffset);
 }
+
+// peak resident set size of the process so far
+long peakResidentKB()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+// largest difference between two bone palettes, element by element
+float paletteDistance(const std::vector<glm::mat4>& a, const std::vector<glm::mat4>& b)
+{
+    float distance = 0.0f;
+    for (size_t i = 0; i < a.size() && i < b.size(); i++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            glm::vec4 d = glm::abs(a[i][c] - b[i][c]);
+            distance = std::max(distance, std::max(std::max(d.x, d.y), std::max(d.z, d.w)));
+        }
+    }
+    return distance;
+}
+
+/*the checks and benchmarks of --self-test, on the clips of library : pose
+sampling, key search, compression of every clip and its sampling cost, and
+the blender on the two farry clips, CPU skinning of the vampire and the
+boxer. returns 1 when a check failed*/
+int runSelfTests(AnimationLibrary& library)
+{
+    Animation& anim = *library.GetClip(0);
+    bool ok = testPoseSampler(&anim);
+    benchmarkKeySearch();
+    for (int i = 0; i < library.GetClipCount(); i++)
+    {
+        Animation* clip = library.GetClip(i);
+        clip->Compress();
+        const ClipCompressionStats& stats = clip->GetCompressionStats();
+        std::cout << "Animation keys of " << clip->GetName() << ": " << stats.sourceBytes << " bytes -> " << stats.compressedBytes
+            << " bytes compressed, max joint error " << stats.maxJointError << " (tolerance " << ClipCompressionSettings().positionTolerance
+            << (stats.refinements ? ", refined " + std::to_string(stats.refinements) + "x" : "") << ")"
+            << (stats.withinTolerance ? "  ok" : "  FAILED") << std::endl;
+        ok = ok && stats.withinTolerance;
+    }
+    benchmarkClipSampling(&anim);
+    benchmarkCpuSkinning(modelDirStr + "/vampire/dae/dancing_vampire.dae");
+    benchmarkCpuSkinning(modelDirStr + "/boxing/dae/boxing.dae");
+
+    // the blender needs two different clips of one rig
+    AnimationLibrary blendLibrary(modelDirStr + "/farry/farry.fbx", { modelDirStr + "/farry/joyfulJump.fbx" });
+    if (blendLibrary.GetClipCount() >= 2)
+        ok = testBlender(blendLibrary.GetClip(0), blendLibrary.GetClip(1)) && ok;
+    else
+    {
+        std::cout << "Blender: farry.fbx and joyfulJump.fbx give " << blendLibrary.GetClipCount() << " clips, two needed  FAILED" << std::endl;
+        ok = false;
+    }
+    std::cout << (ok ? "Self-test passed" : "Self-test FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
+
+/*palette of clipA and clipB blended with weight on B, built without the
+blender from the source keys : translations and scales mixed, rotations
+nlerped on the shortest arc, nodes either clip leaves out in their bind pose*/
+std::vector<glm::mat4> referenceBlend(Animation* clipA, float timeA, Animation* clipB, float timeB, float weight)
+{
+    const std::vector<SkeletonNode>& skeleton = clipA->GetSkeleton();
+    std::vector<glm::mat4> globals(skeleton.size());
+    std::vector<glm::mat4> palette(clipA->GetBoneCount(), glm::mat4(1.0f));
+
+    auto sample = [](Animation* clip, const SkeletonNode& node, float time, glm::vec3& position, glm::quat& rotation, glm::vec3& scale)
+    {
+        Bone* bone = clip->FindBone(node.name);
+        if (bone)
+        {
+            BoneCursor cursor;
+            CompressedClip::SampleSource(*bone, time, cursor, position, rotation, scale);
+            return;
+        }
+        const glm::mat4& m = node.localTransformation;
+        scale = glm::vec3(glm::length(glm::vec3(m[0])), glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2])));
+        rotation = glm::normalize(glm::quat_cast(glm::mat3(glm::vec3(m[0]) / scale.x, glm::vec3(m[1]) / scale.y, glm::vec3(m[2]) / scale.z)));
+        position = glm::vec3(m[3]);
+    };
+
+    for (size_t n = 0; n < skeleton.size(); n++)
+    {
+        const SkeletonNode& node = skeleton[n];
+        glm::vec3 positionA, scaleA, positionB, scaleB;
+        glm::quat rotationA, rotationB;
+        sample(clipA, node, timeA, positionA, rotationA, scaleA);
+        sample(clipB, node, timeB, positionB, rotationB, scaleB);
+        if (glm::dot(rotationA, rotationB) < 0.0f)
+            rotationB = -rotationB;
+        glm::quat rotation = glm::normalize(rotationA * (1.0f - weight) + rotationB * weight);
+        glm::mat4 local = glm::translate(glm::mat4(1.0f), glm::mix(positionA, positionB, weight)) * glm::toMat4(rotation) *
+            glm::scale(glm::mat4(1.0f), glm::mix(scaleA, scaleB, weight));
+
+        globals[n] = node.parentIndex >= 0 ? globals[node.parentIndex] * local : local;
+        if (node.boneID >= 0)
+            palette[node.boneID] = globals[n] * node.offset;
+    }
+    return palette;
+}
+
+/*AnimationBlender on two clips of one rig : a weight sweep, where every step
+has to match referenceBlend and the ends the Animator pose of either clip, a
+cross-fade, and the cost of one Update (one character for one frame).
+returns false when a check failed*/
+bool testBlender(Animation* clipA, Animation* clipB)
+{
+    float timeA = 0.25f * clipA->GetDuration();
+    float timeB = 0.25f * clipB->GetDuration();
+
+    Animator animator(clipA);
+    animator.SetCurrentTime(timeA);
+    animator.UpdateAnimation(0.0f);
+    std::vector<glm::mat4> poseA = animator.GetFinalBoneMatrices();
+    animator.PlayAnimation(clipB);
+    animator.SetCurrentTime(timeB);
+    animator.UpdateAnimation(0.0f);
+    std::vector<glm::mat4> poseB = animator.GetFinalBoneMatrices();
+
+    // the palettes hold translations in model units, the tolerance scales with them
+    float scale = 1.0f;
+    for (const glm::mat4& m : poseA)
+        scale = std::max(scale, glm::length(glm::vec3(m[3])));
+    float tolerance = 1.0e-3f * scale;
+
+    AnimationBlender blender(clipA);
+    int a = blender.AddClip(clipA);
+    int b = blender.AddClip(clipB);
+    float endError = 0.0f, blendError = 0.0f;
+    std::cout << "Blender weight sweep " << clipA->GetName() << " -> " << clipB->GetName() << ", distance to clip A / clip B / reference:";
+    for (int step = 0; step <= 4; step++)
+    {
+        float weight = step / 4.0f;
+        blender.SetWeight(a, 1.0f - weight);
+        blender.SetWeight(b, weight);
+        blender.SetClipTime(a, timeA);
+        blender.SetClipTime(b, timeB);
+        blender.Update(0.0f);
+        float toA = paletteDistance(blender.GetFinalBoneMatrices(), poseA);
+        float toB = paletteDistance(blender.GetFinalBoneMatrices(), poseB);
+        float toReference = paletteDistance(blender.GetFinalBoneMatrices(), referenceBlend(clipA, timeA, clipB, timeB, weight));
+        std::cout << "  " << weight << ": " << toA << " / " << toB << " / " << toReference;
+        if (step == 0)
+            endError = std::max(endError, toA);
+        if (step == 4)
+            endError = std::max(endError, toB);
+        blendError = std::max(blendError, toReference);
+    }
+    bool sweepOk = endError <= tolerance && blendError <= tolerance && paletteDistance(poseA, poseB) > tolerance;
+    std::cout << (sweepOk ? "  ok" : "  FAILED") << std::endl;
+
+    // B fades in over half a second at 60 frames per second : full after 30 frames, weights summing to 1 on the way
+    const float dt = 1.0f / 60.0f;
+    blender.SetWeight(a, 1.0f);
+    blender.SetWeight(b, 0.0f);
+    blender.CrossFade(b, 0.5f);
+    int fadeFrames = 0;
+    float sumError = 0.0f;
+    for (int frame = 1; frame <= 60; frame++)
+    {
+        blender.Update(dt);
+        sumError = std::max(sumError, std::fabs(blender.GetWeight(a) + blender.GetWeight(b) - 1.0f));
+        if (fadeFrames == 0 && blender.GetWeight(a) == 0.0f && blender.GetWeight(b) == 1.0f)
+            fadeFrames = frame;
+    }
+    bool fadeOk = fadeFrames >= 30 && fadeFrames <= 31 && sumError < 1.0e-4f;
+    std::cout << "Blender cross-fade over 0.5 s: done after " << fadeFrames << " frames at 60 Hz, weight sum off by "
+        << sumError << (fadeOk ? "  ok" : "  FAILED") << std::endl;
+
+    const int UPDATES = 2000;
+    double updateUs[2];
+    for (int active = 1; active <= 2; active++)
+    {
+        blender.SetWeight(a, 1.0f);
+        blender.SetWeight(b, active == 2 ? 0.5f : 0.0f);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < UPDATES; i++)
+            blender.Update(dt);
+        updateUs[active - 1] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / UPDATES;
+    }
+    animator.PlayAnimation(clipA);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < UPDATES; i++)
+        animator.UpdateAnimation(dt);
+    double animatorUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / UPDATES;
+    std::cout << "Blender update: " << updateUs[0] << " us with 1 clip, " << updateUs[1] << " us with 2 clips (Animator "
+        << animatorUs << " us), " << clipA->GetBoneCount() << " bones" << std::endl;
+    return sweepOk && fadeOk;
+}
+
+/*PoseSampler : every bone channel sampled through the SoA kernels
+and through Bone::Sample, the glm path the Animator took before, over one
+cycle of the clip. the largest difference between the two local transforms
+has to stay within the tolerance; both are timed per pose. run it before
+Compress, which changes the keys the sampler reads*/
+bool testPoseSampler(Animation* clip)
+{
+    const int SAMPLES = 500;
+    int numChannels = clip->GetBoneChannelCount();
+    std::vector<BoneCursor> soaCursors(numChannels), boneCursors(numChannels);
+    std::vector<glm::mat4> soaLocal(numChannels), boneLocal(numChannels);
+    PoseSampler sampler;
+    PoseSoA pose;
+
+    float error = 0.0f;
+    float scale = 1.0f;
+    for (int s = 0; s < SAMPLES; s++)
+    {
+        float time = clip->GetDuration() * s / SAMPLES;
+        sampler.Sample(*clip, time, soaCursors.data(), pose);
+        PoseCompose(pose, soaLocal.data());
+        for (int i = 0; i < numChannels; i++)
+        {
+            boneLocal[i] = clip->GetBone(i).Sample(time, boneCursors[i]);
+            scale = std::max(scale, glm::length(glm::vec3(boneLocal[i][3])));
+        }
+        error = std::max(error, paletteDistance(soaLocal, boneLocal));
+    }
+    float tolerance = 1.0e-3f * scale;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int s = 0; s < SAMPLES; s++)
+    {
+        sampler.Sample(*clip, clip->GetDuration() * s / SAMPLES, soaCursors.data(), pose);
+        PoseCompose(pose, soaLocal.data());
+    }
+    double soaUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / SAMPLES;
+    start = std::chrono::steady_clock::now();
+    for (int s = 0; s < SAMPLES; s++)
+    {
+        float time = clip->GetDuration() * s / SAMPLES;
+        for (int i = 0; i < numChannels; i++)
+            boneLocal[i] = clip->GetBone(i).Sample(time, boneCursors[i]);
+    }
+    double boneUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / SAMPLES;
+
+    std::cout << "Pose sampling, " << POSE_SIMD_WIDTH << " lanes vs Bone::Sample: max difference " << error
+        << " (tolerance " << tolerance << ")" << (error <= tolerance ? "  ok" : "  FAILED") << ", "
+        << soaUs << " us vs " << boneUs << " us per pose, " << numChannels << " channels" << std::endl;
+    return error <= tolerance;
+}
+
+/*Bone::FindKeyIndex on one position track of growing length :
+playback at half the key rate (the cursor moves 0 or 1 pair, wrapping at the
+end), random seeks (binary search) and the scan from key 0 the sampler did
+before. the first two have to stay flat as the track grows*/
+void benchmarkKeySearch()
+{
+    const int LOOKUPS = 200000;
+    const int sizes[] = { 100, 1000, 10000, 100000 };
+    volatile int sink = 0;
+    std::streamsize precision = std::cout.precision();
+
+    std::cout << "Key search, ns per lookup:" << std::setw(10) << "keys" << std::setw(12) << "sequential"
+        << std::setw(10) << "seek" << std::setw(18) << "scan from key 0" << std::endl;
+    for (int numKeys : sizes)
+    {
+        std::vector<KeyPosition> keys(numKeys);
+        for (int k = 0; k < numKeys; k++)
+            keys[k] = KeyPosition{ glm::vec3((float)k), (float)k };
+        float duration = (float)(numKeys - 1);
+
+        std::vector<float> seeks(LOOKUPS);
+        unsigned int random = 12345;
+        for (float& time : seeks)
+        {
+            random = random * 1664525u + 1013904223u;
+            time = (random >> 8) / 16777216.0f * duration;
+        }
+
+        int cursor = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < LOOKUPS; i++)
+            sink = sink + Bone::FindKeyIndex(keys, std::fmod(i * 0.5f, duration), cursor);
+        double sequentialNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / LOOKUPS;
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < LOOKUPS; i++)
+            sink = sink + Bone::FindKeyIndex(keys, seeks[i], cursor);
+        double seekNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / LOOKUPS;
+
+        // the scan costs O(keys), fewer lookups keep it short
+        int scans = std::max(100, LOOKUPS / numKeys * 100);
+        scans = std::min(scans, LOOKUPS);
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < scans; i++)
+        {
+            int index = 0;
+            while (index < numKeys - 2 && seeks[i] >= keys[index + 1].timeStamp)
+                index++;
+            sink = sink + index;
+        }
+        double scanNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / scans;
+
+        std::cout << std::fixed << std::setprecision(1) << std::setw(36) << numKeys << std::setw(12) << sequentialNs
+            << std::setw(10) << seekNs << std::setw(18) << scanNs << std::defaultfloat << std::setprecision(precision) << std::endl;
+    }
+}
+
+/*sampling cost of a compressed clip, per pose of every channel :
+Bone::Sample on the source keys (what Bone::Update did for each bone),
+CompressedClip::Sample, and PoseSampler, which the Animator plays the
+compressed clip through. the Animator's path has to be at least as fast as
+the source keys*/
+void benchmarkClipSampling(Animation* clip)
+{
+    const int SAMPLES = 2000;
+    const CompressedClip* compressed = clip->GetCompressedClip();
+    int numChannels = clip->GetBoneChannelCount();
+    std::vector<BoneCursor> cursors(numChannels);
+    std::vector<glm::mat4> local(numChannels);
+    PoseSampler sampler;
+    PoseSoA pose;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int s = 0; s < SAMPLES; s++)
+    {
+        float time = clip->GetDuration() * s / SAMPLES;
+        for (int i = 0; i < numChannels; i++)
+            local[i] = clip->GetBone(i).Sample(time, cursors[i]);
+    }
+    double sourceUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / SAMPLES;
+
+    start = std::chrono::steady_clock::now();
+    for (int s = 0; s < SAMPLES; s++)
+    {
+        float time = clip->GetDuration() * s / SAMPLES;
+        for (int i = 0; i < numChannels; i++)
+            local[i] = compressed->Sample(i, time, cursors[i]);
+    }
+    double compressedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / SAMPLES;
+
+    start = std::chrono::steady_clock::now();
+    for (int s = 0; s < SAMPLES; s++)
+    {
+        sampler.Sample(*clip, clip->GetDuration() * s / SAMPLES, cursors.data(), pose);
+        PoseCompose(pose, local.data());
+    }
+    double samplerUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / SAMPLES;
+
+    std::cout << "Compressed sampling of " << clip->GetName() << ", us per pose: " << sourceUs << " source keys (Bone::Sample), "
+        << compressedUs << " CompressedClip::Sample, " << samplerUs << " PoseSampler"
+        << (samplerUs <= sourceUs ? "  ok" : "  SLOWER than the source keys") << std::endl;
+}
+
+/*CPU skinning throughput on every mesh of the model at modelPath, playing
+its first clip : vertices per second per core, the figure the render loop
+prints in CPU skinning mode*/
+void benchmarkCpuSkinning(const string& modelPath)
+{
+    const int FRAMES = 200;
+    AnimationLibrary library(modelPath);
+    if (!library.IsLoaded() || library.GetClipCount() == 0)
+    {
+        std::cout << "CPU skinning: " << modelPath << " not loaded" << std::endl;
+        return;
+    }
+    Model& model = library.GetModel();
+    Animator animator(library.GetClip(0));
+    CpuSkinningEngine engine;
+    std::vector<std::unique_ptr<SkinnedMesh>> meshes;
+    int vertexCount = 0;
+    for (unsigned int i = 0; i < model.meshes.size(); i++)
+    {
+        if (!SkinnedMesh::CanSkin(model.meshes[i]))
+            continue;
+        meshes.push_back(std::unique_ptr<SkinnedMesh>(new SkinnedMesh(model.meshes[i], animator.GetBoneCount())));
+        vertexCount += meshes.back()->GetVertexCount();
+    }
+
+    double seconds = 0.0;
+    for (int f = 0; f < FRAMES; f++)
+    {
+        animator.UpdateAnimation(1.0f / 60.0f);
+        for (auto& mesh : meshes)
+        {
+            engine.Skin(*mesh, animator.GetFinalBoneMatrices().data());
+            seconds += engine.GetLastSkinSeconds();
+        }
+    }
+
+    string name = modelPath.substr(modelPath.find_last_of('/') + 1);
+    std::cout << "CPU skinning of " << name << ": " << vertexCount << " vertices in " << meshes.size() << " meshes, "
+        << engine.GetThreadCount() << " threads, "
+        << (seconds > 0.0 ? vertexCount * (double)FRAMES / seconds / engine.GetThreadCount() / 1.0e6 : 0.0)
+        << " M vertices/s per core" << std::endl;
+}
@@ -5,8 +5,12 @@ layout (location = 2) in vec4 aColor;
 layout (location = 3) in vec2 aTexCoord;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+};
 
 void main()
 {
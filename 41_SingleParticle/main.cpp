@@ -14,6 +14,7 @@
 #include <cmath>
 
 #include <shader.h>
+#include <learnopengl/frame_uniforms.h>
 #include <arcball.h>
 #include <mass.h>
 #include <plane.h>
@@ -35,6 +36,7 @@ string sourceDirStr = "/Users/iklee/Library/CloudStorage/Dropbox/Lecture/Graphic
 GLFWwindow *mainWindow = NULL;
 Shader *groundShader = NULL;
 Shader *particleShader = NULL;
+FrameUniforms *frameUniforms = NULL;    // projection and view, shared by every program
 unsigned int SCR_WIDTH = 600;
 unsigned int SCR_HEIGHT = 600;
 glm::mat4 projection, view, model;
@@ -76,14 +78,12 @@ int main()
     vs = sourceDirStr + "/particle.vs";
     fs = sourceDirStr + "/particle.fs";
     particleShader = new Shader(vs.c_str(), fs.c_str());
+    frameUniforms = new FrameUniforms();
     
     // projection matrix
     projection = glm::perspective(glm::radians(45.0f),
                                   (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-    groundShader->use();
-    groundShader->setMat4("projection", projection);
-    particleShader->use();
-    particleShader->setMat4("projection", projection);
+    frameUniforms->SetProjection(projection);
     
     // particle initialization
     particle = new Mass(massM);
@@ -143,9 +143,12 @@ void render() {
         updateAnimData();
     }
     
+    // camera of the frame, for both programs
+    frameUniforms->SetView(view, glm::vec3(glm::inverse(view)[3]));
+    frameUniforms->Upload();
+    
     // draw ground
     groundShader->use();
-    groundShader->setMat4("view", view);
     model = glm::translate(model, glm::vec3(0.0f, 0.0f, groundY));
     model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
     groundShader->setMat4("model", model);
@@ -153,7 +156,6 @@ void render() {
     
     // draw particle
     particleShader->use();
-    particleShader->setMat4("view", view);
     model = glm::mat4(1.0);
     particleShader->setMat4("model", model); 
     particle->draw(particleShader, 1.0f, 1.0f, 1.0f);
@@ -218,10 +220,7 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     SCR_HEIGHT = height;
     projection = glm::perspective(glm::radians(45.0f),
                                   (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-    groundShader->use();
-    groundShader->setMat4("projection", projection);
-    particleShader->use();
-    particleShader->setMat4("projection", projection);
+    frameUniforms->SetProjection(projection);
 }
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
@@ -4,8 +4,12 @@ layout (location = 1) in vec4 aColor;
 
 out vec4 toColor;
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+};
 
 void main()
 {
@@ -0,0 +1,408 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <learnopengl/shader_m.h>
+#include <learnopengl/camera.h>
+#include <learnopengl/frame_uniforms.h>
+#include <learnopengl/animator.h>
+#include <learnopengl/animator_pool.h>
+#include <learnopengl/bone_palette.h>
+#include <learnopengl/baked_animation.h>
+#include <learnopengl/animation_lod.h>
+#include <learnopengl/model_animation.h>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+// FUNCTION PROTOTYPES
+GLFWwindow *glAllInit();
+void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void processInput(GLFWwindow* window);
+void benchmarkAnimatorPool(Animation* animation);
+
+// GLOBAL VARIABLES
+
+// Source and Data directories
+string sourceDirStr = "/Users/iklee/Library/CloudStorage/Dropbox/Lecture/Graphics/Codes/Mac2024/42_AnimatedCrowd/42_AnimatedCrowd";
+string modelDirStr = "/Users/iklee/Library/CloudStorage/Dropbox/Lecture/Graphics/Codes/Mac2024/data";
+
+const unsigned int SCR_WIDTH = 800;
+const unsigned int SCR_HEIGHT = 600;
+GLFWwindow *mainWindow = NULL;
+Shader *crowdShader = NULL;     // baked palettes, one instanced draw per mesh
+Shader *animatorShader = NULL;  // one Animator and one draw per character
+
+// crowd : CROWD_SIZE x CROWD_SIZE characters
+const int CROWD_SIZE = 32;
+const float CROWD_SPACING = 1.0f;
+// 1: baked palettes, 2: one Animator per character, 3: Animators under animation lod, 4: Animators updated by an AnimatorPool
+int crowdMode = 1;
+const char* crowdModeNames[] = { "", "baked    ", "animator ", "lod      ", "pool     " };
+// P: draw the copy of the model uploaded in the packed vertex layout
+bool packedVertices = false;
+
+// camera
+Camera camera(glm::vec3(0.0f, 6.0f, 30.0f));
+float lastX = SCR_WIDTH / 2.0f;
+float lastY = SCR_HEIGHT / 2.0f;
+bool firstMouse = true;
+
+// timing
+float deltaTime = 0.0f;
+float lastFrame = 0.0f;
+
+int main()
+{
+    mainWindow = glAllInit();
+
+	// build and compile shaders
+	// -------------------------
+    string vs = sourceDirStr + "/crowd_anim.vs";
+    string fs = sourceDirStr + "/skel_anim.fs";
+	crowdShader = new Shader(vs.c_str(), fs.c_str());
+    vs = sourceDirStr + "/skel_anim.vs";
+	animatorShader = new Shader(vs.c_str(), fs.c_str());
+
+	// load models
+	// -----------
+    string modelPath = modelDirStr + "/boxing/dae/boxing.dae";
+    
+    ModelLoadOptions options;
+    options.optimizeMeshes = true;
+    Model fullModel(modelPath, options);
+    options.packVertices = true;
+    Model packedModel(modelPath, options);
+    Animation anim(modelPath, &fullModel);
+    benchmarkAnimatorPool(&anim);
+
+    size_t fullBytes = 0, packedBytes = 0;
+    for (unsigned int i = 0; i < fullModel.meshes.size(); i++)
+    {
+        fullBytes += fullModel.meshes[i].getVertexBufferBytes() + fullModel.meshes[i].getIndexBufferBytes();
+        packedBytes += packedModel.meshes[i].getVertexBufferBytes() + packedModel.meshes[i].getIndexBufferBytes();
+    }
+    std::cout << "Vertex and index buffers: " << fullBytes / 1024 << " KB full, " << packedBytes / 1024 << " KB packed" << std::endl;
+
+    // bake the clip once : from here on the baked path does no animation work on the CPU
+    BakedAnimationAtlas atlas(fullModel.GetBoneCount());
+    float bakeStart = glfwGetTime();
+    int clip = atlas.AddClip(&anim);
+    atlas.Upload();
+    atlas.SetupProgram(*crowdShader);
+    std::cout << "Baked " << atlas.GetFrameCount() << " frames x " << atlas.GetBoneCount() << " bones ("
+        << atlas.GetTextureBytes() << " bytes) in " << (glfwGetTime() - bakeStart) * 1000.0 << " ms" << std::endl;
+
+    // every character gets its own place and its own phase in the clip
+    std::vector<BakedInstance> instances;
+    std::vector<Animator> animators;
+    AnimatorPool pool;
+    for (int z = 0; z < CROWD_SIZE; z++)
+    {
+        for (int x = 0; x < CROWD_SIZE; x++)
+        {
+            float offset = (float)((x * 7 + z * 13) % 32) / 32.0f * atlas.GetClipLength(clip);
+
+            BakedInstance instance;
+            instance.model = glm::translate(glm::mat4(1.0f),
+                glm::vec3((x - CROWD_SIZE / 2) * CROWD_SPACING, -0.4f, -z * CROWD_SPACING));
+            instance.model = glm::scale(instance.model, glm::vec3(.5f, .5f, .5f));
+            instance.clip = glm::vec2((float)clip, offset);
+            instances.push_back(instance);
+
+            Animator animator(&anim);
+            animator.SetCurrentTime(offset * anim.GetTicksPerSecond());
+            animators.push_back(animator);
+            pool.AddInstance(&anim, offset * anim.GetTicksPerSecond());
+        }
+    }
+
+    BakedCrowd crowd;
+    crowd.SetInstances(instances);
+    for (unsigned int i = 0; i < fullModel.meshes.size(); i++)
+    {
+        crowd.Attach(fullModel.meshes[i].VAO);
+        crowd.Attach(packedModel.meshes[i].VAO);
+    }
+
+    // same animators again, driven by the lod : every instance gets a copy so the modes don't share time
+    std::vector<Animator> lodAnimators = animators;
+    AnimationLod lod;
+    for (size_t i = 0; i < lodAnimators.size(); i++)
+        lod.AddInstance(&lodAnimators[i], glm::vec3(instances[i].model[3]), 0.5f);
+
+    BonePalette bonePalette;
+    FrameUniforms frameUniforms;    // camera and time, shared by both programs
+    animatorShader->use();
+    animatorShader->setInt("finalBonesMatrices", BONE_PALETTE_TEXTURE_UNIT);
+
+    std::cout << "1: baked instanced crowd, 2: one Animator per character, 3: Animators with animation lod, 4: Animators on "
+        << pool.GetThreadCount() << " threads" << std::endl;
+    std::cout << "P: packed vertex layout, F: full vertex layout" << std::endl;
+
+    // benchmark : average frame time of the active path, printed every two seconds
+    int benchFrames = 0;
+    float benchTime = 0.0f;
+    long long benchBones = 0;
+    int benchMode = crowdMode;
+    bool benchPacked = packedVertices;
+
+	// render loop
+	// -----------
+	while (!glfwWindowShouldClose(mainWindow))
+	{
+		// per-frame time logic
+		// --------------------
+		float currentFrame = glfwGetTime();
+		deltaTime = currentFrame - lastFrame;
+		lastFrame = currentFrame;
+
+        if (benchMode != crowdMode || benchPacked != packedVertices)
+        {
+            benchFrames = 0;
+            benchTime = 0.0f;
+            benchBones = 0;
+            benchMode = crowdMode;
+            benchPacked = packedVertices;
+        }
+        else if (benchTime >= 2.0f)
+        {
+            std::cout << crowdModeNames[benchMode] << (benchPacked ? "packed: " : "full  : ") << CROWD_SIZE * CROWD_SIZE << " characters, "
+                << benchTime * 1000.0f / benchFrames << " ms/frame, "
+                << benchBones / benchFrames << " bones evaluated/frame" << std::endl;
+            benchFrames = 0;
+            benchTime = 0.0f;
+            benchBones = 0;
+        }
+        benchFrames++;
+        benchTime += deltaTime;
+
+		// input
+		// -----
+		processInput(mainWindow);
+        Model& ourModel = packedVertices ? packedModel : fullModel;
+		
+		// render
+		// ------
+		glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		// view/projection transformations
+		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+		glm::mat4 view = camera.GetViewMatrix();
+        frameUniforms.SetProjection(projection);
+        frameUniforms.SetView(view, camera.Position);
+        frameUniforms.SetTime(currentFrame, deltaTime);
+        frameUniforms.Upload();
+
+        if (crowdMode == 1)
+        {
+            crowdShader->use();
+            atlas.Bind();
+            ourModel.DrawInstanced(*crowdShader, crowd.GetCount());
+        }
+        else if (crowdMode == 2)
+        {
+            animatorShader->use();
+            animatorShader->setInt("skippedInfluences", 0);
+            bonePalette.Bind();
+            for (size_t i = 0; i < animators.size(); i++)
+            {
+                animators[i].UpdateAnimation(deltaTime);
+                benchBones += animators[i].GetBonesEvaluated();
+                bonePalette.Upload(animators[i].GetFinalBoneMatrices());
+                animatorShader->setMat4("model", instances[i].model);
+                ourModel.Draw(*animatorShader);
+            }
+        }
+        else if (crowdMode == 4)
+        {
+            // every palette is ready before the first draw, the draws below only upload them
+            pool.Update(deltaTime);
+            animatorShader->use();
+            animatorShader->setInt("skippedInfluences", 0);
+            bonePalette.Bind();
+            for (int i = 0; i < pool.GetInstanceCount(); i++)
+            {
+                benchBones += pool.GetInstance(i).GetBonesEvaluated();
+                bonePalette.Upload(pool.GetPalette(i), pool.GetInstance(i).GetBoneCount());
+                animatorShader->setMat4("model", instances[i].model);
+                ourModel.Draw(*animatorShader);
+            }
+        }
+        else
+        {
+            lod.Update(deltaTime, view, projection);
+            benchBones += lod.GetBonesEvaluated();
+
+            animatorShader->use();
+            bonePalette.Bind();
+            for (size_t i = 0; i < lodAnimators.size(); i++)
+            {
+                bonePalette.Upload(lodAnimators[i].GetFinalBoneMatrices());
+                animatorShader->setMat4("model", instances[i].model);
+                animatorShader->setInt("skippedInfluences", MAX_BONE_INFLUENCE - lod.GetInfluences(i));
+                ourModel.Draw(*animatorShader);
+            }
+        }
+
+
+		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+		// -------------------------------------------------------------------------------
+		glfwSwapBuffers(mainWindow);
+		glfwPollEvents();
+	}
+
+	// glfw: terminate, clearing all previously allocated GLFW resources.
+	// ------------------------------------------------------------------
+	glfwTerminate();
+	return 0;
+}
+
+GLFWwindow *glAllInit()
+{
+    // glfw: initialize and configure
+    // ------------------------------
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    
+    // glfw window creation
+    // --------------------
+    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Animated Crowd", NULL, NULL);
+    if (window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        exit(-1);
+    }
+    glfwMakeContextCurrent(window);
+    // no vsync, so the frame times below compare the two paths
+    glfwSwapInterval(0);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+    
+    // tell GLFW to capture our mouse
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    
+    // glad: load all OpenGL function pointers
+    // ---------------------------------------
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        exit(-1);
+    }
+    
+    // configure global opengl state
+    // -----------------------------
+    glEnable(GL_DEPTH_TEST);
+    
+    return window;
+}
+
+// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
+// ---------------------------------------------------------------------------------------------------------
+void processInput(GLFWwindow* window)
+{
+	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+		glfwSetWindowShouldClose(window, true);
+	if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS)
+		crowdMode = 1;
+	if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS)
+		crowdMode = 2;
+	if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS)
+		crowdMode = 3;
+	if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS)
+		crowdMode = 4;
+	if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS)
+		packedVertices = true;
+	if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS)
+		packedVertices = false;
+
+    /*
+	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+		camera.ProcessKeyboard(FORWARD, deltaTime);
+	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+		camera.ProcessKeyboard(BACKWARD, deltaTime);
+	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+		camera.ProcessKeyboard(LEFT, deltaTime);
+	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+		camera.ProcessKeyboard(RIGHT, deltaTime);
+     */
+}
+
+// glfw: whenever the window size changed (by OS or user resize) this callback function executes
+// ---------------------------------------------------------------------------------------------
+void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+{
+	// make sure the viewport matches the new window dimensions; note that width and 
+	// height will be significantly larger than specified on retina displays.
+	glViewport(0, 0, width, height);
+}
+
+// glfw: whenever the mouse scroll wheel scrolls, this callback is called
+// ----------------------------------------------------------------------
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+{
+	camera.ProcessMouseScroll(yoffset);
+}
+
+/*AnimatorPool scaling, printed at startup : the time of one Update for 1 to
+10000 animators of the clip on 1 thread up to every hardware thread, and the
+speedup over one thread. every row times at least 5 pool updates and 10000
+animator updates*/
+void benchmarkAnimatorPool(Animation* animation)
+{
+    const int instanceCounts[] = { 1, 100, 1000, 10000 };
+    unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned int> threadCounts;
+    for (unsigned int threads = 1; threads < hardwareThreads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(hardwareThreads);
+
+    std::streamsize precision = std::cout.precision();
+
+    std::cout << "AnimatorPool update, ms (speedup over 1 thread), " << animation->GetBoneCount() << " bones:" << std::endl
+        << std::setw(10) << "animators";
+    for (unsigned int threads : threadCounts)
+        std::cout << std::setw(13) << threads << " thr";
+    std::cout << std::endl;
+    for (int count : instanceCounts)
+    {
+        int updates = std::max(5, 10000 / count);
+        double singleMs = 0.0;
+        std::cout << std::setw(10) << count;
+        for (unsigned int threads : threadCounts)
+        {
+            AnimatorPool pool(threads);
+            for (int i = 0; i < count; i++)
+                pool.AddInstance(animation, (float)(i % 32) / 32.0f * animation->GetDuration());
+            // the first update sizes the samplers' scratch
+            pool.Update(1.0f / 60.0f);
+            auto start = std::chrono::steady_clock::now();
+            for (int u = 0; u < updates; u++)
+                pool.Update(1.0f / 60.0f);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / updates;
+            if (threads == 1)
+                singleMs = ms;
+            std::cout << std::fixed << std::setprecision(3) << std::setw(9) << ms << " ("
+                << std::setprecision(1) << std::setw(4) << singleMs / ms << "x)";
+        }
+        std::cout << std::defaultfloat << std::setprecision(precision) << std::endl;
+    }
+}
@@ -0,0 +1,81 @@
+#version 330 core
+
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec3 norm;
+layout(location = 2) in vec2 tex;
+layout(location = 3) in vec3 tangent;
+layout(location = 4) in vec3 bitangent;
+layout(location = 5) in ivec4 boneIds; 
+layout(location = 6) in vec4 weights;
+// per instance
+layout(location = 7) in mat4 instanceModel;
+layout(location = 11) in vec2 instanceClip;    // x: clip id, y: time offset in seconds
+
+layout (std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+};
+#include "packed_vertex.glsl"
+layout (std140) uniform Frame
+{
+    float time;
+    float deltaTime;
+    int frame;
+};
+
+const int MAX_BONE_INFLUENCE = 4;
+const int MAX_BAKED_CLIPS = 16;
+// baked palettes : one row per frame, 3 RGBA32F texels (top rows of the matrix) per bone
+uniform sampler2D bakedPalettes;
+// x: first row, y: frame count, z: frames per second, w: length in seconds
+uniform vec4 bakedClips[MAX_BAKED_CLIPS];
+
+mat4 getBoneMatrix(int row, int boneId)
+{
+    int base = boneId * 3;
+    vec4 r0 = texelFetch(bakedPalettes, ivec2(base, row), 0);
+    vec4 r1 = texelFetch(bakedPalettes, ivec2(base + 1, row), 0);
+    vec4 r2 = texelFetch(bakedPalettes, ivec2(base + 2, row), 0);
+    return transpose(mat4(r0, r1, r2, vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
+out vec2 TexCoords;
+
+void main()
+{
+    vec3 position = unpackPosition(pos);
+    vec4 clip = bakedClips[int(instanceClip.x)];
+    float clipFrame = mod(time + instanceClip.y, clip.w) * clip.z;
+    int frame0 = int(clipFrame);
+    int frame1 = frame0 + 1 < int(clip.y) ? frame0 + 1 : 0;
+    float blend = fract(clipFrame);
+    int row0 = int(clip.x) + min(frame0, int(clip.y) - 1);
+    int row1 = int(clip.x) + frame1;
+
+    int numBones = textureSize(bakedPalettes, 0).x / 3;
+    vec4 totalPosition = vec4(0.0f);
+    float totalWeight = 0.0f;
+    for(int i = 0 ; i < MAX_BONE_INFLUENCE ; i++)
+    {
+        if(boneIds[i] == -1) 
+            continue;
+        if(boneIds[i] >= numBones) 
+        {
+            totalPosition = vec4(position,1.0f);
+            totalWeight = 1.0f;
+            break;
+        }
+        // neighbouring baked frames are close enough for a plain matrix blend
+        mat4 boneMatrix = getBoneMatrix(row0, boneIds[i]) * (1.0 - blend) + getBoneMatrix(row1, boneIds[i]) * blend;
+        totalPosition += boneMatrix * vec4(position,1.0f) * weights[i];
+        totalWeight += weights[i];
+    }
+    // a vertex without influences isn't skinned : it stays in the bind pose, like on the CPU path
+    if(totalWeight == 0.0f)
+        totalPosition = vec4(position, 1.0f);
+	
+    gl_Position =  projection * view * instanceModel * totalPosition;
+	TexCoords = tex;
+}
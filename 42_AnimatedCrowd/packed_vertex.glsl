@@ -0,0 +1,24 @@
+// vertex attributes in the layout of PackedVertex (learnopengl/packed_vertex.h) or of Vertex.
+// Mesh sets these on every draw, identity and packedVertex = false for the full layout, so one shader draws both
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+uniform bool packedVertex;
+
+// packed meshes store the position relative to their bounds
+vec3 unpackPosition(vec3 position)
+{
+    return positionOffset + positionScale * position;
+}
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * sign(n.xy);
+    return normalize(n);
+}
+
+// normal and tangent attributes declared vec3 : packed meshes store them octahedral in x and y
+vec3 unpackNormal(vec3 normal)
+{
+    return packedVertex ? octDecode(normal.xy) : normal;
+}
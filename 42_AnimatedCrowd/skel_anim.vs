@@ -0,0 +1,69 @@
+#version 330 core
+
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec3 norm;
+layout(location = 2) in vec2 tex;
+layout(location = 3) in vec3 tangent;
+layout(location = 4) in vec3 bitangent;
+layout(location = 5) in ivec4 boneIds; 
+layout(location = 6) in vec4 weights;
+
+layout (std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+};
+#include "packed_vertex.glsl"
+uniform mat4 model;
+
+const int MAX_BONE_INFLUENCE = 4;
+// animation lod : influences are sorted by weight, far characters drop the last ones
+uniform int skippedInfluences;
+// bone palette : 4 RGBA32F texels per matrix, one matrix per bone
+uniform samplerBuffer finalBonesMatrices;
+
+mat4 getBoneMatrix(int boneId)
+{
+    int base = boneId * 4;
+    return mat4(texelFetch(finalBonesMatrices, base),
+                texelFetch(finalBonesMatrices, base + 1),
+                texelFetch(finalBonesMatrices, base + 2),
+                texelFetch(finalBonesMatrices, base + 3));
+}
+
+out vec2 TexCoords;
+
+void main()
+{
+    vec3 position = unpackPosition(pos);
+    int numBones = textureSize(finalBonesMatrices) / 4;
+    vec4 totalPosition = vec4(0.0f);
+    float totalWeight = 0.0f;
+    for(int i = 0 ; i < MAX_BONE_INFLUENCE - skippedInfluences ; i++)
+    {
+        if(boneIds[i] == -1) 
+            continue;
+        if(boneIds[i] >= numBones) 
+        {
+            totalPosition = vec4(position,1.0f);
+            totalWeight = 1.0f;
+            break;
+        }
+        mat4 boneMatrix = getBoneMatrix(boneIds[i]);
+        vec4 localPosition = boneMatrix * vec4(position,1.0f);
+        totalPosition += localPosition * weights[i];
+        totalWeight += weights[i];
+        vec3 localNormal = mat3(boneMatrix) * unpackNormal(norm);
+   }
+    // a vertex without influences isn't skinned : it stays in the bind pose, like on the CPU path
+    if(totalWeight == 0.0f)
+        totalPosition = vec4(position, 1.0f);
+    // the kept weights no longer sum to 1
+    if(skippedInfluences > 0 && totalWeight > 0.0f)
+        totalPosition /= totalWeight;
+	
+    mat4 viewModel = view * model;
+    gl_Position =  projection * viewModel * totalPosition;
+	TexCoords = tex;
+}
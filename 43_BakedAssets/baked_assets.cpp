@@ -0,0 +1,432 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <learnopengl/shader_m.h>
+#include <learnopengl/animation_library.h>
+#include <learnopengl/baked_asset.h>
+#include <learnopengl/texture_cache.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <vector>
+#ifdef __APPLE__
+#include <mach/mach.h>
+#else
+#include <unistd.h>
+#endif
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+// FUNCTION PROTOTYPES
+GLFWwindow *glAllInit();
+
+// GLOBAL VARIABLES
+
+// Source and Data directories
+string sourceDirStr = "/Users/iklee/Library/CloudStorage/Dropbox/Lecture/Graphics/Codes/Mac2024/43_BakedAssets/43_BakedAssets";
+string modelDirStr = "/Users/iklee/Library/CloudStorage/Dropbox/Lecture/Graphics/Codes/Mac2024/data";
+
+const unsigned int SCR_WIDTH = 800;
+const unsigned int SCR_HEIGHT = 600;
+
+// model files and their extra clip files
+struct AssetEntry
+{
+    string model;
+    vector<string> clips;
+};
+
+const AssetEntry assets[] = {
+    { "/benz/dae/benz.dae", {} },
+    { "/boxing/dae/boxing.dae", {} },
+    { "/chapa/dae/Chapa-Giratoria.dae", {} },
+    { "/cyborg/cyborg.obj", {} },
+    { "/farry/farry.fbx", { "/farry/joyfulJump.fbx" } },
+    { "/farry/obj/farry.obj", {} },
+    { "/gyroscope/dae/gyroscope.dae", {} },
+    { "/lowpolyMan/dae/hiphopDance.dae", {} },
+    { "/lowpolyMan/hiphopDance.fbx", {} },
+    { "/nanosuit/nanosuit.obj", {} },
+    { "/planet/planet.obj", {} },
+    { "/rock/rock.obj", {} },
+    { "/vampire/dae/dancing_vampire.dae", {} },
+};
+
+// number of timed loads per path, the fastest one is reported
+const int RUNS = 3;
+
+double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// every texture the nanosuit uses, decoded one after the other and then as one TextureCache batch
+void benchmarkTextures()
+{
+    string modelPath = modelDirStr + "/nanosuit/nanosuit.obj";
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(modelPath, 0);
+    if (!scene)
+        return;
+
+    string directory = modelPath.substr(0, modelPath.find_last_of('/'));
+    vector<TextureRequest> requests;
+    const aiTextureType types[] = { aiTextureType_DIFFUSE, aiTextureType_SPECULAR, aiTextureType_HEIGHT, aiTextureType_AMBIENT };
+    for (unsigned int m = 0; m < scene->mNumMaterials; m++)
+    {
+        for (aiTextureType type : types)
+        {
+            for (unsigned int i = 0; i < scene->mMaterials[m]->GetTextureCount(type); i++)
+            {
+                aiString str;
+                scene->mMaterials[m]->GetTexture(type, i, &str);
+                requests.push_back(TextureRequest{ directory + '/' + str.C_Str(), true });
+            }
+        }
+    }
+
+    TextureCache& cache = TextureCache::Get();
+    cache.Clear();
+    auto start = std::chrono::steady_clock::now();
+    vector<unsigned int> serial;
+    for (const TextureRequest& request : requests)
+        serial.push_back(TextureCache::Upload(TextureCache::Decode(request.path, request.flip)));
+    double serialMs = elapsedMs(start);
+    glDeleteTextures((GLsizei)serial.size(), serial.data());
+
+    start = std::chrono::steady_clock::now();
+    cache.Load(requests);
+    double batchMs = elapsedMs(start);
+    start = std::chrono::steady_clock::now();
+    cache.Load(requests);
+    double cachedMs = elapsedMs(start);
+
+    printf("nanosuit textures: %d references, %d files, serial %.2f ms, batch %.2f ms on %d threads, cached %.3f ms\n\n",
+        (int)requests.size(), (int)cache.GetSize(), serialMs, batchMs, cache.GetThreadCount(), cachedMs);
+}
+
+// video memory and load time of a model's textures, uncompressed and block compressed
+void benchmarkCompression(const string& modelFile)
+{
+    TextureCache& cache = TextureCache::Get();
+    double ms[3];
+    size_t bytes[3] = { 0, 0, 0 };
+    // 0: uncompressed, 1: compressed on first load (transcodes and writes the KTX files), 2: compressed from the KTX files
+    for (int run = 0; run < 3; run++)
+    {
+        cache.Clear();
+        // KTX files go to an ignored cache directory, never next to the images
+        if (cache.SetCompression(run > 0, sourceDirStr + "/texture_cache") != (run > 0))
+        {
+            printf("%s: block compression is not supported\n", modelFile.c_str());
+            return;
+        }
+        if (run == 1)
+        {
+            // starts from a cold KTX cache
+            Model probe(modelDirStr + modelFile);
+            for (const Texture& texture : probe.textures_loaded)
+                std::remove(cache.CachePath(TextureRequest{ probe.directory + '/' + texture.path, probe.options.flipTextures }).c_str());
+            cache.Clear();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        Model model(modelDirStr + modelFile);
+        glFinish();
+        ms[run] = elapsedMs(start);
+        for (const Texture& texture : model.textures_loaded)
+            bytes[run] += cache.GetTextureBytes(texture.id);
+    }
+    cache.SetCompression(false);
+    cache.Clear();
+
+    printf("%-24s textures %8ld KB -> %8ld KB (%.1fx), load %8.2f ms -> %8.2f ms (first load %.2f ms)\n", modelFile.c_str(),
+        (long)bytes[0] / 1024, (long)bytes[2] / 1024, (double)bytes[0] / std::max(bytes[2], (size_t)1), ms[0], ms[2], ms[1]);
+}
+
+/*whether the texture pre-pass of BakedAsset::Read finds, in the cooked
+file, the textures of every mesh of the model it was cooked from, in mesh
+order. it skips each mesh's vertex, index and lod arrays to get to the next
+mesh's textures, so a model of several meshes catches a record it misreads*/
+bool checkBakedTextures(const Model& model, const string& bakedPath)
+{
+    vector<TextureRequest> requests;
+    if (!BakedAsset::ListTextures(bakedPath, model, requests))
+        return false;
+    size_t next = 0;
+    for (const Mesh& mesh : model.meshes)
+    {
+        for (const Texture& texture : mesh.textures)
+        {
+            if (next == requests.size() || requests[next].path != model.directory + '/' + texture.path)
+                return false;
+            next++;
+        }
+    }
+    return next == requests.size();
+}
+
+// resident set size of the process now, unlike the peak it goes down again when memory is freed
+long residentKB()
+{
+#ifdef __APPLE__
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS)
+        return 0;
+    return (long)(info.resident_size / 1024);
+#else
+    long pages = 0, resident = 0;
+    std::ifstream statm("/proc/self/statm");
+    statm >> pages >> resident;
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+#endif
+}
+
+// bytes of a node hierarchy and bone map, as every clip held them before AnimationLibrary shared them
+size_t skeletonBytes(const AssimpNodeData& node)
+{
+    size_t bytes = sizeof(AssimpNodeData) + node.name.capacity();
+    for (const AssimpNodeData& child : node.children)
+        bytes += skeletonBytes(child);
+    return bytes;
+}
+
+size_t skeletonBytes(const Skeleton& skeleton)
+{
+    size_t bytes = skeletonBytes(skeleton.rootNode);
+    for (const auto& bone : skeleton.boneInfoMap)
+        bytes += sizeof(bone) + bone.first.capacity() + 4 * sizeof(void*);
+    return bytes;
+}
+
+// skeletons of clips, each distinct one counted once
+size_t clipSkeletonBytes(const vector<Animation*>& clips, int& skeletons)
+{
+    std::set<const Skeleton*> seen;
+    size_t bytes = 0;
+    for (Animation* clip : clips)
+    {
+        if (seen.insert(clip->GetSharedSkeleton().get()).second)
+            bytes += skeletonBytes(*clip->GetSharedSkeleton());
+    }
+    skeletons = (int)seen.size();
+    return bytes;
+}
+
+/*the model and its clip files loaded the way Animation(path, model) did it,
+one import of the model and one more per clip file, each clip with its own
+hierarchy and bone map, against one AnimationLibrary import shared by every
+clip. fastest of RUNS loads, the resident memory the loaded assets add and
+the bytes their skeletons take. the allocator can hand memory freed by the
+first path to the second, so the skeleton bytes are the exact comparison*/
+void benchmarkClipLibrary(const string& modelFile, const vector<string>& clipFiles)
+{
+    string modelPath = modelDirStr + modelFile;
+    if (!std::ifstream(modelPath))
+    {
+        printf("%s missing\n", modelFile.c_str());
+        return;
+    }
+
+    // the files Animation(path, model) can play : the ones that have a clip
+    vector<string> clipPaths, animatedPaths;
+    for (const string& clip : clipFiles)
+        clipPaths.push_back(modelDirStr + clip);
+    vector<string> candidates(1, modelPath);
+    candidates.insert(candidates.end(), clipPaths.begin(), clipPaths.end());
+    for (const string& path : candidates)
+    {
+        Assimp::Importer probe;
+        const aiScene* scene = probe.ReadFile(path, 0);
+        if (scene && scene->mNumAnimations > 0)
+            animatedPaths.push_back(path);
+    }
+
+    double perClipMs = 1e30, libraryMs = 1e30;
+    long perClipKB = 0, libraryKB = 0;
+    size_t perClipBytes = 0, libraryBytes = 0;
+    int perClipSkeletons = 0, librarySkeletons = 0, numClips = 0;
+    for (int run = 0; run < RUNS; run++)
+    {
+        TextureCache::Get().Clear();
+        long residentBefore = residentKB();
+        auto start = std::chrono::steady_clock::now();
+        Model model(modelPath);
+        vector<std::unique_ptr<Animation>> clips;
+        for (const string& path : animatedPaths)
+            clips.push_back(std::unique_ptr<Animation>(new Animation(path, &model)));
+        perClipMs = std::min(perClipMs, elapsedMs(start));
+        perClipKB = std::max(perClipKB, residentKB() - residentBefore);
+
+        vector<Animation*> pointers;
+        for (auto& clip : clips)
+            pointers.push_back(clip.get());
+        perClipBytes = clipSkeletonBytes(pointers, perClipSkeletons);
+    }
+    for (int run = 0; run < RUNS; run++)
+    {
+        TextureCache::Get().Clear();
+        long residentBefore = residentKB();
+        auto start = std::chrono::steady_clock::now();
+        AnimationLibrary library(modelPath, clipPaths);
+        libraryMs = std::min(libraryMs, elapsedMs(start));
+        libraryKB = std::max(libraryKB, residentKB() - residentBefore);
+
+        vector<Animation*> pointers;
+        for (int i = 0; i < library.GetClipCount(); i++)
+            pointers.push_back(library.GetClip(i));
+        libraryBytes = clipSkeletonBytes(pointers, librarySkeletons);
+        numClips = library.GetClipCount();
+    }
+
+    printf("%s with %d clip files, %d clips:\n", modelFile.c_str(), (int)clipFiles.size(), numClips);
+    printf("%-28s %10s %14s %10s %14s\n", "", "load ms", "resident KB", "skeletons", "skeleton KB");
+    printf("%-28s %10.2f %14ld %10d %14.1f\n", "Animation(path, model)", perClipMs, perClipKB, perClipSkeletons, perClipBytes / 1024.0);
+    printf("%-28s %10.2f %14ld %10d %14.1f\n\n", "AnimationLibrary", libraryMs, libraryKB, librarySkeletons, libraryBytes / 1024.0);
+}
+
+// compresses every clip of library with the default settings and adds a line per clip to lines
+void reportClipCompression(AnimationLibrary& library, const string& asset, vector<string>& lines)
+{
+    for (int i = 0; i < library.GetClipCount(); i++)
+    {
+        Animation* clip = library.GetClip(i);
+        clip->Compress();
+        const ClipCompressionStats& stats = clip->GetCompressionStats();
+        char line[256];
+        snprintf(line, sizeof(line), "%-36s %-24s %10.1f %14.1f %7.1fx %16g %s", asset.c_str(), clip->GetName().substr(0, 24).c_str(),
+            stats.sourceBytes / 1024.0, stats.compressedBytes / 1024.0,
+            stats.compressedBytes > 0 ? (double)stats.sourceBytes / stats.compressedBytes : 0.0, stats.maxJointError,
+            stats.withinTolerance ? "ok" : "FAILED");
+        lines.push_back(line);
+    }
+}
+
+/*cooks every asset of data/ next to its model file, then compares loading it
+through Assimp with reading the baked file. the texture cache is emptied
+before every load, so both paths decode their textures and the difference is
+the parsing and post-processing saved.*/
+int main()
+{
+    GLFWwindow *window = glAllInit();
+
+    benchmarkTextures();
+    benchmarkCompression("/nanosuit/nanosuit.obj");
+    benchmarkCompression("/cyborg/cyborg.obj");
+    printf("\n");
+    benchmarkClipLibrary("/farry/farry.fbx", { "/farry/joyfulJump.fbx" });
+
+    // one line per clip of every asset, printed after the load table
+    vector<string> clipLines;
+    printf("%-36s %12s %12s %8s %12s %8s %10s\n", "asset", "assimp ms", "baked ms", "speedup", "baked KB", "meshes", "textures");
+    for (const AssetEntry& asset : assets)
+    {
+        string modelPath = modelDirStr + asset.model;
+        vector<string> clipPaths;
+        for (const string& clip : asset.clips)
+            clipPaths.push_back(modelDirStr + clip);
+        if (!std::ifstream(modelPath))
+        {
+            printf("%-36s missing\n", asset.model.c_str());
+            continue;
+        }
+
+        double assimpMs = 1e30;
+        std::unique_ptr<AnimationLibrary> library;
+        ModelLoadOptions options;
+        options.optimizeMeshes = true;
+        for (int run = 0; run < RUNS; run++)
+        {
+            TextureCache::Get().Clear();
+            auto start = std::chrono::steady_clock::now();
+            library.reset(new AnimationLibrary(modelPath, clipPaths, options));
+            assimpMs = std::min(assimpMs, elapsedMs(start));
+        }
+        if (!library->IsLoaded())
+        {
+            printf("%-36s import failed\n", asset.model.c_str());
+            continue;
+        }
+
+        string bakedPath = modelPath + ".baked";
+        uint64_t sourceHash = BakedAsset::HashSources(modelPath, clipPaths);
+        if (!BakedAsset::Cook(*library, bakedPath, sourceHash))
+        {
+            printf("%-36s cook failed\n", asset.model.c_str());
+            continue;
+        }
+        int meshCount = (int)library->GetModel().meshes.size();
+        bool texturesOk = checkBakedTextures(library->GetModel(), bakedPath);
+        reportClipCompression(*library, asset.model, clipLines);
+        library.reset();
+
+        // hashing the sources is part of every cached load, so it is timed too
+        double bakedMs = 1e30;
+        string directory = modelPath.substr(0, modelPath.find_last_of('/'));
+        for (int run = 0; run < RUNS; run++)
+        {
+            TextureCache::Get().Clear();
+            auto start = std::chrono::steady_clock::now();
+            library = BakedAsset::Read(bakedPath, BakedAsset::HashSources(modelPath, clipPaths), directory);
+            bakedMs = std::min(bakedMs, elapsedMs(start));
+        }
+        if (!library)
+        {
+            printf("%-36s read failed\n", asset.model.c_str());
+            continue;
+        }
+
+        std::ifstream baked(bakedPath, std::ios::binary | std::ios::ate);
+        printf("%-36s %12.2f %12.2f %7.1fx %12ld %8d %10s\n", asset.model.c_str(), assimpMs, bakedMs,
+            assimpMs / bakedMs, (long)baked.tellg() / 1024, meshCount, texturesOk ? "ok" : "MISMATCH");
+    }
+
+    printf("\n%-36s %-24s %10s %14s %8s %16s %s\n", "asset", "clip", "keys KB", "compressed KB", "ratio", "max joint error", "tolerance");
+    for (const string& line : clipLines)
+        printf("%s\n", line.c_str());
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
+
+GLFWwindow *glAllInit()
+{
+    // glfw: initialize and configure
+    // ------------------------------
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // the loaders only need a context for their buffers and textures
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    // glfw window creation
+    // --------------------
+    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Baked Assets", NULL, NULL);
+    if (window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        exit(-1);
+    }
+    glfwMakeContextCurrent(window);
+
+    // glad: load all OpenGL function pointers
+    // ---------------------------------------
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        exit(-1);
+    }
+
+    return window;
+}
@@ -0,0 +1,240 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <learnopengl/shader_m.h>
+#include <learnopengl/camera.h>
+#include <learnopengl/model_animation.h>
+#include <learnopengl/async_model.h>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+// FUNCTION PROTOTYPES
+GLFWwindow *glAllInit();
+void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void processInput(GLFWwindow* window);
+
+// GLOBAL VARIABLES
+
+// Source and Data directories
+string sourceDirStr = "/Users/iklee/Library/CloudStorage/Dropbox/Lecture/Graphics/Codes/Mac2024/44_AsyncLoading/44_AsyncLoading";
+string modelDirStr = "/Users/iklee/Library/CloudStorage/Dropbox/Lecture/Graphics/Codes/Mac2024/data";
+
+const unsigned int SCR_WIDTH = 800;
+const unsigned int SCR_HEIGHT = 600;
+GLFWwindow *mainWindow = NULL;
+Shader *ourShader = NULL;
+
+// models loaded side by side
+const char* modelFiles[] = {
+    "/nanosuit/nanosuit.obj",
+    "/cyborg/cyborg.obj",
+    "/planet/planet.obj",
+    "/rock/rock.obj",
+    "/farry/obj/farry.obj",
+    "/benz/dae/benz.dae",
+};
+const int NUM_MODELS = sizeof(modelFiles) / sizeof(modelFiles[0]);
+
+// time the loader may spend uploading each frame
+const double UPLOAD_BUDGET_MS = 2.0;
+
+// B: reload every model with the blocking Model constructor, A: reload them with the async loader
+bool reloadBlocking = false;
+bool reloadAsync = false;
+
+// camera
+Camera camera(glm::vec3(0.0f, 2.0f, 14.0f));
+
+// timing
+float deltaTime = 0.0f;
+float lastFrame = 0.0f;
+
+int main()
+{
+    mainWindow = glAllInit();
+
+	// build and compile shaders
+	// -------------------------
+    string vs = sourceDirStr + "/model.vs";
+    string fs = sourceDirStr + "/model.fs";
+	ourShader = new Shader(vs.c_str(), fs.c_str());
+
+	// load models : only the first frames of each load are spent here, the rest runs on the loader's threads
+	// ------------------------------------------------------------------------------------------------------
+    AsyncModelLoader loader;
+    std::vector<std::shared_ptr<AsyncModel>> asyncModels;
+    std::vector<std::unique_ptr<Model>> blockingModels;
+    reloadAsync = true;
+
+    // benchmark : longest frame while loading, printed once the loader is idle
+    bool loading = false;
+    double worstFrameMs = 0.0;
+    auto loadStart = std::chrono::steady_clock::now();
+
+	// render loop
+	// -----------
+	while (!glfwWindowShouldClose(mainWindow))
+	{
+		// per-frame time logic
+		// --------------------
+		float currentFrame = glfwGetTime();
+		deltaTime = currentFrame - lastFrame;
+		lastFrame = currentFrame;
+
+		// input
+		// -----
+		processInput(mainWindow);
+
+        if (reloadAsync && !loader.IsBusy())
+        {
+            blockingModels.clear();
+            asyncModels.clear();
+            for (int i = 0; i < NUM_MODELS; i++)
+                asyncModels.push_back(loader.Load(modelDirStr + modelFiles[i]));
+            loading = true;
+            worstFrameMs = 0.0;
+            loadStart = std::chrono::steady_clock::now();
+        }
+        if (reloadBlocking && !loader.IsBusy())
+        {
+            asyncModels.clear();
+            blockingModels.clear();
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < NUM_MODELS; i++)
+                blockingModels.push_back(std::unique_ptr<Model>(new Model(modelDirStr + modelFiles[i])));
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "blocking load: " << ms << " ms, all in one frame" << std::endl;
+        }
+        reloadAsync = reloadBlocking = false;
+
+        loader.Update(UPLOAD_BUDGET_MS);
+        if (loading)
+        {
+            worstFrameMs = std::max(worstFrameMs, (double)deltaTime * 1000.0);
+            if (!loader.IsBusy())
+            {
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+                std::cout << "async load: " << ms << " ms on " << loader.GetThreadCount()
+                    << " threads, longest frame " << worstFrameMs << " ms" << std::endl;
+                loading = false;
+            }
+        }
+
+		// render
+		// ------
+		glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		// view/projection transformations
+		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+		glm::mat4 view = camera.GetViewMatrix();
+
+        ourShader->use();
+        ourShader->setMat4("projection", projection);
+        ourShader->setMat4("view", view);
+
+        // models are drawn mesh by mesh as their uploads complete
+        for (int i = 0; i < NUM_MODELS; i++)
+        {
+            glm::mat4 model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3((i - (NUM_MODELS - 1) * 0.5f) * 4.0f, 0.0f, 0.0f));
+            model = glm::rotate(model, currentFrame * 0.5f, glm::vec3(0.0f, 1.0f, 0.0f));
+            ourShader->setMat4("model", model);
+            if (i < (int)asyncModels.size())
+                asyncModels[i]->Draw(*ourShader);
+            else if (i < (int)blockingModels.size())
+                blockingModels[i]->Draw(*ourShader);
+        }
+
+		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+		// -------------------------------------------------------------------------------
+		glfwSwapBuffers(mainWindow);
+		glfwPollEvents();
+	}
+
+	// glfw: terminate, clearing all previously allocated GLFW resources.
+	// ------------------------------------------------------------------
+	glfwTerminate();
+	return 0;
+}
+
+GLFWwindow *glAllInit()
+{
+    // glfw: initialize and configure
+    // ------------------------------
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    // glfw window creation
+    // --------------------
+    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Async Loading", NULL, NULL);
+    if (window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        exit(-1);
+    }
+    glfwMakeContextCurrent(window);
+    // no vsync, so the frame times show the load hitches
+    glfwSwapInterval(0);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+
+    // glad: load all OpenGL function pointers
+    // ---------------------------------------
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        exit(-1);
+    }
+
+    // configure global opengl state
+    // -----------------------------
+    glEnable(GL_DEPTH_TEST);
+
+    return window;
+}
+
+// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
+// ---------------------------------------------------------------------------------------------------------
+void processInput(GLFWwindow* window)
+{
+	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+		glfwSetWindowShouldClose(window, true);
+	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+		reloadAsync = true;
+	if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS)
+		reloadBlocking = true;
+}
+
+// glfw: whenever the window size changed (by OS or user resize) this callback function executes
+// ---------------------------------------------------------------------------------------------
+void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+{
+	// make sure the viewport matches the new window dimensions; note that width and
+	// height will be significantly larger than specified on retina displays.
+	glViewport(0, 0, width, height);
+}
+
+// glfw: whenever the mouse scroll wheel scrolls, this callback is called
+// ----------------------------------------------------------------------
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+{
+	camera.ProcessMouseScroll(yoffset);
+}
@@ -0,0 +1,195 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <learnopengl/shader_m.h>
+#include <learnopengl/model_animation.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+// FUNCTION PROTOTYPES
+GLFWwindow *glAllInit();
+
+// GLOBAL VARIABLES
+
+// Data directory
+string modelDirStr = "/Users/iklee/Library/CloudStorage/Dropbox/Lecture/Graphics/Codes/Mac2024/data";
+
+const unsigned int SCR_WIDTH = 800;
+const unsigned int SCR_HEIGHT = 600;
+
+// every model of data/
+const char* modelFiles[] = {
+    "/benz/dae/benz.dae",
+    "/boxing/dae/boxing.dae",
+    "/chapa/dae/Chapa-Giratoria.dae",
+    "/cyborg/cyborg.obj",
+    "/farry/farry.fbx",
+    "/farry/obj/farry.obj",
+    "/gyroscope/dae/gyroscope.dae",
+    "/lowpolyMan/dae/hiphopDance.dae",
+    "/lowpolyMan/hiphopDance.fbx",
+    "/nanosuit/nanosuit.obj",
+    "/planet/planet.obj",
+    "/rock/rock.obj",
+    "/vampire/dae/dancing_vampire.dae",
+};
+
+// sum of the per-mesh stats of a model, weighted by triangles (ACMR) and vertices (ATVR)
+struct ModelStats
+{
+    size_t verticesBefore = 0, verticesAfter = 0, triangles = 0;
+    double misses[5] = { 0, 0, 0, 0, 0 };
+    double overfetch[5] = { 0, 0, 0, 0, 0 };
+    double ms = 0.0;
+
+    void Add(const MeshOptimizationStats& stats)
+    {
+        const VertexCacheStats* steps[5] = { &stats.original, &stats.welded, &stats.cacheOrdered, &stats.overdrawOrdered, &stats.fetchOrdered };
+        for (int i = 0; i < 5; i++)
+        {
+            misses[i] += steps[i]->acmr * stats.triangles;
+            overfetch[i] += steps[i]->overfetch * stats.triangles;
+        }
+        verticesBefore += stats.verticesBefore;
+        verticesAfter += stats.verticesAfter;
+        triangles += stats.triangles;
+    }
+};
+
+// vertex and index buffer bytes of a model
+size_t bufferBytes(const Model& model, size_t& vertexBytes)
+{
+    size_t bytes = 0;
+    vertexBytes = 0;
+    for (const Mesh& mesh : model.meshes)
+    {
+        vertexBytes += mesh.getVertexBufferBytes();
+        bytes += mesh.getVertexBufferBytes() + mesh.getIndexBufferBytes();
+    }
+    return bytes;
+}
+
+// video memory of every model in the full Vertex layout and in the PackedVertex one
+void reportPacking()
+{
+    printf("\n%-34s %12s %12s %8s %12s %12s %8s\n", "model", "vertex KB", "packed KB", "ratio", "total KB", "packed KB", "ratio");
+    for (const char* modelFile : modelFiles)
+    {
+        string modelPath = modelDirStr + modelFile;
+        if (!std::ifstream(modelPath))
+            continue;
+        ModelLoadOptions options;
+        options.optimizeMeshes = true;
+        Model full(modelPath, options);
+        options.packVertices = true;
+        Model packed(modelPath, options);
+        size_t fullVertexBytes, packedVertexBytes;
+        size_t fullBytes = bufferBytes(full, fullVertexBytes);
+        size_t packedBytes = bufferBytes(packed, packedVertexBytes);
+        if (packedBytes == 0)
+            continue;
+
+        int unpacked = 0;
+        for (const Mesh& mesh : packed.meshes)
+            unpacked += mesh.isPacked() ? 0 : 1;
+        printf("%-34s %12ld %12ld %7.2fx %12ld %12ld %7.2fx", modelFile,
+            (long)fullVertexBytes / 1024, (long)packedVertexBytes / 1024, (double)fullVertexBytes / packedVertexBytes,
+            (long)fullBytes / 1024, (long)packedBytes / 1024, (double)fullBytes / packedBytes);
+        if (unpacked > 0)
+            printf("  (%d meshes over 127 bones left full)", unpacked);
+        printf("\n");
+    }
+}
+
+/*loads every model without the optimization, then runs MeshOptimizer step
+by step on copies of its meshes and prints the vertex cache efficiency
+after each step. ACMR is the number of vertex shader runs per triangle, so
+its ratio before and after is the vertex work saved on every draw. last,
+the size of every model's buffers in the full and in the packed layout.*/
+int main()
+{
+    GLFWwindow *window = glAllInit();
+
+    printf("%-34s %16s %8s | %-41s | %11s | %11s | %8s\n", "model", "vertices", "tris",
+        "ACMR  source  welded   cache overdraw  fetch", "ATVR", "overfetch", "ms");
+    for (const char* modelFile : modelFiles)
+    {
+        string modelPath = modelDirStr + modelFile;
+        if (!std::ifstream(modelPath))
+        {
+            printf("%-34s missing\n", modelFile);
+            continue;
+        }
+        Model model(modelPath);
+
+        ModelStats total;
+        for (const Mesh& mesh : model.meshes)
+        {
+            vector<Vertex> vertices = mesh.vertices;
+            vector<unsigned int> indices = mesh.indices;
+            auto start = std::chrono::steady_clock::now();
+            MeshOptimizationStats stats = MeshOptimizer::Optimize(vertices, indices);
+            total.ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            total.Add(stats);
+        }
+        if (total.triangles == 0)
+            continue;
+
+        double tris = (double)total.triangles;
+        printf("%-34s %7ld -> %6ld %8ld |      %7.3f %7.3f %7.3f %7.3f %7.3f | %4.2f -> %4.2f | %4.2f -> %4.2f | %8.2f\n", modelFile,
+            (long)total.verticesBefore, (long)total.verticesAfter, (long)total.triangles,
+            total.misses[0] / tris, total.misses[1] / tris, total.misses[2] / tris, total.misses[3] / tris, total.misses[4] / tris,
+            total.misses[0] / total.verticesBefore, total.misses[4] / total.verticesAfter,
+            total.overfetch[0] / tris, total.overfetch[4] / tris, total.ms);
+    }
+
+    reportPacking();
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
+
+GLFWwindow *glAllInit()
+{
+    // glfw: initialize and configure
+    // ------------------------------
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // the models only need a context for their buffers and textures
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    // glfw window creation
+    // --------------------
+    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Mesh Optimization", NULL, NULL);
+    if (window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        exit(-1);
+    }
+    glfwMakeContextCurrent(window);
+
+    // glad: load all OpenGL function pointers
+    // ---------------------------------------
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        exit(-1);
+    }
+
+    return window;
+}
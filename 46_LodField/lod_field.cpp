@@ -0,0 +1,289 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <learnopengl/shader_m.h>
+#include <learnopengl/camera.h>
+#include <learnopengl/model_animation.h>
+#include <learnopengl/entity.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+// FUNCTION PROTOTYPES
+GLFWwindow *glAllInit();
+void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void processInput(GLFWwindow* window);
+
+// GLOBAL VARIABLES
+
+// Source and Data directories
+string sourceDirStr = "/Users/iklee/Library/CloudStorage/Dropbox/Lecture/Graphics/Codes/Mac2024/46_LodField/46_LodField";
+string modelDirStr = "/Users/iklee/Library/CloudStorage/Dropbox/Lecture/Graphics/Codes/Mac2024/data";
+
+unsigned int scrWidth = 800;
+unsigned int scrHeight = 600;
+GLFWwindow *mainWindow = NULL;
+Shader *ourShader = NULL;
+
+// rocks in the belt around the planet
+const int NUM_ROCKS = 5000;
+const float BELT_RADIUS = 40.0f;
+const float BELT_WIDTH = 30.0f;
+
+// largest simplification error allowed on screen
+const float MAX_ERROR_PIXELS = 1.0f;
+
+// seconds between two printed benchmark lines
+const double REPORT_SECONDS = 2.0;
+
+// L: levels of detail, H: every mesh at full detail
+bool useLods = true;
+
+// camera
+Camera camera(glm::vec3(0.0f, 3.0f, BELT_RADIUS + BELT_WIDTH));
+
+// timing
+float deltaTime = 0.0f;
+float lastFrame = 0.0f;
+
+// triangles and error of every level of the model's meshes
+void reportLods(const string& modelFile)
+{
+    string modelPath = modelDirStr + modelFile;
+    if (!std::ifstream(modelPath))
+    {
+        printf("%-24s missing\n", modelFile.c_str());
+        return;
+    }
+    ModelLoadOptions options;
+    options.optimizeMeshes = true;
+    options.generateLods = true;
+    auto start = std::chrono::steady_clock::now();
+    Model model(modelPath, options);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    size_t levels = 0;
+    for (const Mesh& mesh : model.meshes)
+        levels = std::max(levels, mesh.lods.size());
+    printf("%-24s load %8.2f ms, triangles (error):", modelFile.c_str(), ms);
+    for (size_t l = 0; l < levels; l++)
+    {
+        size_t triangles = 0;
+        float error = 0.0f;
+        for (const Mesh& mesh : model.meshes)
+        {
+            const MeshLod& lod = mesh.lods[std::min(l, mesh.lods.size() - 1)];
+            triangles += lod.indexCount / 3;
+            error = std::max(error, lod.error);
+        }
+        printf(" %ld (%.4f)", (long)triangles, error);
+    }
+    printf("\n");
+}
+
+/*a belt of thousands of rocks around a planet, culled and drawn through
+the Entity graph. with levels of detail each mesh is drawn at the coarsest
+level whose error stays under a pixel on screen. every couple of seconds the
+average frame time and the triangles drawn per frame are printed, so L and H
+compare both.*/
+int main()
+{
+    mainWindow = glAllInit();
+
+	// build and compile shaders
+	// -------------------------
+    string vs = sourceDirStr + "/model.vs";
+    string fs = sourceDirStr + "/model.fs";
+	ourShader = new Shader(vs.c_str(), fs.c_str());
+
+    reportLods("/rock/rock.obj");
+    reportLods("/planet/planet.obj");
+    reportLods("/cyborg/cyborg.obj");
+
+	// load models
+	// -----------
+    ModelLoadOptions lodOptions;
+    lodOptions.optimizeMeshes = true;
+    lodOptions.generateLods = true;
+    Model planet(modelDirStr + "/planet/planet.obj", lodOptions);
+    Model rock(modelDirStr + "/rock/rock.obj", lodOptions);
+
+    // the planet is the root, the rocks its children
+    Entity belt(planet);
+    belt.transform.setLocalScale(glm::vec3(4.0f));
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int i = 0; i < NUM_ROCKS; i++)
+    {
+        float angle = glm::radians(unit(random) * 360.0f);
+        float radius = (BELT_RADIUS + (unit(random) - 0.5f) * BELT_WIDTH) / 4.0f;
+        belt.addChild(rock);
+        Entity& child = *belt.children.back();
+        child.transform.setLocalPosition(glm::vec3(cos(angle) * radius, (unit(random) - 0.5f) * 1.0f, sin(angle) * radius));
+        child.transform.setLocalRotation(glm::vec3(unit(random) * 360.0f, unit(random) * 360.0f, 0.0f));
+        child.transform.setLocalScale(glm::vec3(0.01f + unit(random) * 0.04f));
+    }
+    belt.updateSelfAndChild();
+
+    // benchmark : averages over REPORT_SECONDS
+    int frames = 0;
+    double frameMs = 0.0;
+    size_t triangles = 0;
+    auto reportStart = std::chrono::steady_clock::now();
+
+	// render loop
+	// -----------
+	while (!glfwWindowShouldClose(mainWindow))
+	{
+		// per-frame time logic
+		// --------------------
+		float currentFrame = glfwGetTime();
+		deltaTime = currentFrame - lastFrame;
+		lastFrame = currentFrame;
+
+		// input
+		// -----
+		processInput(mainWindow);
+
+		// render
+		// ------
+		glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		// view/projection transformations
+        float aspect = (float)scrWidth / (float)scrHeight;
+        float fovY = glm::radians(camera.Zoom);
+		glm::mat4 projection = glm::perspective(fovY, aspect, 0.1f, 300.0f);
+		glm::mat4 view = camera.GetViewMatrix();
+
+        ourShader->use();
+        ourShader->setMat4("projection", projection);
+        ourShader->setMat4("view", view);
+
+        // the belt turns slowly, so the levels change as rocks come closer
+        belt.transform.setLocalRotation(glm::vec3(0.0f, currentFrame * 5.0f, 0.0f));
+        belt.updateSelfAndChild();
+
+        const Frustum frustum = createFrustumFromCamera(camera, aspect, fovY, 0.1f, 300.0f);
+        // a negative error bound keeps every mesh at lods[0]
+        const LodView lodView = createLodViewFromCamera(camera, (float)scrHeight, fovY, useLods ? MAX_ERROR_PIXELS : -1.0f);
+        unsigned int display = 0, total = 0;
+        size_t frameTriangles = 0;
+        belt.drawSelfAndChild(frustum, lodView, *ourShader, display, total, frameTriangles);
+
+        frames++;
+        frameMs += deltaTime * 1000.0;
+        triangles += frameTriangles;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - reportStart).count();
+        if (seconds >= REPORT_SECONDS)
+        {
+            printf("%s: %7.3f ms/frame, %9ld triangles/frame, %u of %u entities drawn\n", useLods ? "lod " : "full",
+                frameMs / frames, (long)(triangles / frames), display, total);
+            frames = 0;
+            frameMs = 0.0;
+            triangles = 0;
+            reportStart = std::chrono::steady_clock::now();
+        }
+
+		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+		// -------------------------------------------------------------------------------
+		glfwSwapBuffers(mainWindow);
+		glfwPollEvents();
+	}
+
+	// glfw: terminate, clearing all previously allocated GLFW resources.
+	// ------------------------------------------------------------------
+	glfwTerminate();
+	return 0;
+}
+
+GLFWwindow *glAllInit()
+{
+    // glfw: initialize and configure
+    // ------------------------------
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    // glfw window creation
+    // --------------------
+    GLFWwindow* window = glfwCreateWindow(scrWidth, scrHeight, "LOD Field", NULL, NULL);
+    if (window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        exit(-1);
+    }
+    glfwMakeContextCurrent(window);
+    // no vsync, so the frame times are the rendering cost
+    glfwSwapInterval(0);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+
+    // glad: load all OpenGL function pointers
+    // ---------------------------------------
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        exit(-1);
+    }
+
+    // configure global opengl state
+    // -----------------------------
+    glEnable(GL_DEPTH_TEST);
+
+    return window;
+}
+
+// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
+// ---------------------------------------------------------------------------------------------------------
+void processInput(GLFWwindow* window)
+{
+	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+		glfwSetWindowShouldClose(window, true);
+	if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS)
+		useLods = true;
+	if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS)
+		useLods = false;
+	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+		camera.ProcessKeyboard(FORWARD, deltaTime);
+	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+		camera.ProcessKeyboard(BACKWARD, deltaTime);
+	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+		camera.ProcessKeyboard(LEFT, deltaTime);
+	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+		camera.ProcessKeyboard(RIGHT, deltaTime);
+}
+
+// glfw: whenever the window size changed (by OS or user resize) this callback function executes
+// ---------------------------------------------------------------------------------------------
+void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+{
+	// make sure the viewport matches the new window dimensions; note that width and
+	// height will be significantly larger than specified on retina displays.
+	glViewport(0, 0, width, height);
+	scrWidth = width;
+	scrHeight = height;
+}
+
+// glfw: whenever the mouse scroll wheel scrolls, this callback is called
+// ----------------------------------------------------------------------
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+{
+	camera.ProcessMouseScroll(yoffset);
+}
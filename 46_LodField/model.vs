@@ -0,0 +1,18 @@
+#version 330 core
+layout(location = 0) in vec3 pos;
+layout(location = 2) in vec2 tex;
+
+out vec2 TexCoords;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+// packed meshes store the position relative to their bounds, Mesh sets identity for the full layout
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+void main()
+{
+    TexCoords = tex;
+    gl_Position = projection * view * model * vec4(positionOffset + positionScale * pos, 1.0);
+}
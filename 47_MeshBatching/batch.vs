@@ -0,0 +1,21 @@
+#version 330 core
+layout(location = 0) in vec3 pos;
+layout(location = 2) in vec2 tex;
+// per draw : which instance of MeshBatch the mesh belongs to
+layout(location = 7) in uint instance;
+
+out vec2 TexCoords;
+
+uniform mat4 view;
+uniform mat4 projection;
+// instance transforms, one column per texel
+uniform samplerBuffer instanceTransforms;
+
+void main()
+{
+    int column = int(instance) * 4;
+    mat4 model = mat4(texelFetch(instanceTransforms, column), texelFetch(instanceTransforms, column + 1),
+                      texelFetch(instanceTransforms, column + 2), texelFetch(instanceTransforms, column + 3));
+    TexCoords = tex;
+    gl_Position = projection * view * model * vec4(pos, 1.0);
+}
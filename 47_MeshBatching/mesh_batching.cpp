@@ -0,0 +1,303 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <learnopengl/shader_m.h>
+#include <learnopengl/camera.h>
+#include <learnopengl/model_animation.h>
+#include <learnopengl/mesh_batch.h>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+// FUNCTION PROTOTYPES
+GLFWwindow *glAllInit();
+void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void processInput(GLFWwindow* window);
+
+// GLOBAL VARIABLES
+
+// Source and Data directories
+string sourceDirStr = "/Users/iklee/Library/CloudStorage/Dropbox/Lecture/Graphics/Codes/Mac2024/47_MeshBatching/47_MeshBatching";
+string modelDirStr = "/Users/iklee/Library/CloudStorage/Dropbox/Lecture/Graphics/Codes/Mac2024/data";
+
+const unsigned int SCR_WIDTH = 800;
+const unsigned int SCR_HEIGHT = 600;
+GLFWwindow *mainWindow = NULL;
+
+// models repeated over the grid
+const char* modelFiles[] = {
+    "/nanosuit/nanosuit.obj",
+    "/cyborg/cyborg.obj",
+    "/planet/planet.obj",
+    "/rock/rock.obj",
+    "/farry/obj/farry.obj",
+    "/benz/dae/benz.dae",
+};
+const int NUM_MODELS = sizeof(modelFiles) / sizeof(modelFiles[0]);
+const int GRID_X = 20;
+const int GRID_Z = 15;
+
+// seconds between two printed benchmark lines
+const double REPORT_SECONDS = 2.0;
+
+// 1: Model::Draw per instance, 2: MeshBatch with a draw call per mesh, 3: MeshBatch with multi-draw indirect
+int drawMode = 3;
+
+// camera
+Camera camera(glm::vec3(0.0f, 12.0f, 45.0f));
+
+// timing
+float deltaTime = 0.0f;
+float lastFrame = 0.0f;
+
+// nanosuit draws per timed run of benchmarkBindings
+const int BINDING_RUNS = 1000;
+
+/*CPU time to submit one mesh, with the material bindings looked up on every
+draw as Mesh::Draw used to (names built, glGetUniformLocation per texture)
+and with the bindings resolved once for the shader*/
+void benchmarkBindings(Model& model, Shader& shader)
+{
+    shader.use();
+    shader.setMat4("model", glm::mat4(1.0f));
+    size_t textures = 0;
+    for (const Mesh& mesh : model.meshes)
+        textures += mesh.textures.size();
+
+    double ms[2];
+    for (int resolved = 0; resolved < 2; resolved++)
+    {
+        glFinish();
+        auto start = std::chrono::steady_clock::now();
+        for (int run = 0; run < BINDING_RUNS; run++)
+        {
+            for (Mesh& mesh : model.meshes)
+            {
+                if (!resolved)
+                    mesh.invalidateBindings();
+                mesh.Draw(shader);
+            }
+        }
+        ms[resolved] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        glFinish();
+    }
+    double draws = (double)BINDING_RUNS * model.meshes.size();
+    printf("nanosuit, %d meshes, %d textures, %d times: %.3f us per mesh looked up, %.3f us precompiled\n",
+        (int)model.meshes.size(), (int)textures, BINDING_RUNS, ms[0] * 1000.0 / draws, ms[1] * 1000.0 / draws);
+}
+
+/*the same grid of models drawn three ways : mesh by mesh through Model::Draw,
+through a MeshBatch restricted to GL 3.3, and through a MeshBatch with
+glMultiDrawElementsIndirect (GL 4.3 contexts only, so not on macOS). every
+couple of seconds the draw calls and the CPU time spent submitting them are
+printed, which is what batching saves; the GPU work is the same.*/
+int main()
+{
+    mainWindow = glAllInit();
+
+	// build and compile shaders
+	// -------------------------
+    string vs = sourceDirStr + "/model.vs";
+    string batchVs = sourceDirStr + "/batch.vs";
+    string fs = sourceDirStr + "/model.fs";
+	Shader modelShader(vs.c_str(), fs.c_str());
+	Shader batchShader(batchVs.c_str(), fs.c_str());
+
+	// load models
+	// -----------
+    std::vector<std::unique_ptr<Model>> models;
+    for (int i = 0; i < NUM_MODELS; i++)
+        models.push_back(std::unique_ptr<Model>(new Model(modelDirStr + modelFiles[i])));
+
+    benchmarkBindings(*models[0], modelShader);
+
+    // every cell of the grid gets one of the models
+    MeshBatch batch(false);
+    MeshBatch indirectBatch(true);
+    std::vector<glm::mat4> transforms;
+    std::vector<int> cellModels;
+    for (int z = 0; z < GRID_Z; z++)
+    {
+        for (int x = 0; x < GRID_X; x++)
+        {
+            int m = (x + z * GRID_X) % NUM_MODELS;
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3((x - (GRID_X - 1) * 0.5f) * 4.0f, 0.0f, -z * 4.0f));
+            transforms.push_back(model);
+            cellModels.push_back(m);
+            batch.AddInstance(batch.AddModel(*models[m]), model);
+            indirectBatch.AddInstance(indirectBatch.AddModel(*models[m]), model);
+        }
+    }
+    batch.Build();
+    indirectBatch.Build();
+    printf("%d instances, %ld draws, %ld materials, %ld batched vertices, multi-draw indirect %s\n",
+        (int)transforms.size(), (long)batch.GetDrawCount(), (long)batch.GetGroupCount(), (long)batch.GetVertexCount(),
+        indirectBatch.IsIndirect() ? "available" : "not available");
+
+    // benchmark : averages over REPORT_SECONDS
+    int frames = 0;
+    long drawCalls = 0;
+    double submitMs = 0.0, frameMs = 0.0;
+    auto reportStart = std::chrono::steady_clock::now();
+
+	// render loop
+	// -----------
+	while (!glfwWindowShouldClose(mainWindow))
+	{
+		// per-frame time logic
+		// --------------------
+		float currentFrame = glfwGetTime();
+		deltaTime = currentFrame - lastFrame;
+		lastFrame = currentFrame;
+
+		// input
+		// -----
+		processInput(mainWindow);
+        if (drawMode == 3 && !indirectBatch.IsIndirect())
+            drawMode = 2;
+
+		// render
+		// ------
+		glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		// view/projection transformations
+		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 200.0f);
+		glm::mat4 view = camera.GetViewMatrix();
+
+        auto submitStart = std::chrono::steady_clock::now();
+        if (drawMode == 1)
+        {
+            modelShader.use();
+            modelShader.setMat4("projection", projection);
+            modelShader.setMat4("view", view);
+            for (size_t i = 0; i < transforms.size(); i++)
+            {
+                modelShader.setMat4("model", transforms[i]);
+                models[cellModels[i]]->Draw(modelShader);
+                drawCalls += (long)models[cellModels[i]]->meshes.size();
+            }
+        }
+        else
+        {
+            batchShader.use();
+            batchShader.setMat4("projection", projection);
+            batchShader.setMat4("view", view);
+            drawCalls += (drawMode == 3 ? indirectBatch : batch).Draw(batchShader);
+        }
+        submitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - submitStart).count();
+
+        frames++;
+        frameMs += deltaTime * 1000.0;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - reportStart).count();
+        if (seconds >= REPORT_SECONDS)
+        {
+            const char* modeNames[] = { "", "per mesh", "batched", "indirect" };
+            printf("%-8s: %6ld draw calls/frame, submit %7.3f ms/frame, frame %7.3f ms\n", modeNames[drawMode],
+                drawCalls / frames, submitMs / frames, frameMs / frames);
+            frames = 0;
+            drawCalls = 0;
+            submitMs = frameMs = 0.0;
+            reportStart = std::chrono::steady_clock::now();
+        }
+
+		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+		// -------------------------------------------------------------------------------
+		glfwSwapBuffers(mainWindow);
+		glfwPollEvents();
+	}
+
+	// glfw: terminate, clearing all previously allocated GLFW resources.
+	// ------------------------------------------------------------------
+	glfwTerminate();
+	return 0;
+}
+
+GLFWwindow *glAllInit()
+{
+    // glfw: initialize and configure
+    // ------------------------------
+    glfwInit();
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    // glfw window creation : GL 4.3 for multi-draw indirect, 3.3 where it is not available
+    // -------------------------------------------------------------------------------------
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Mesh Batching", NULL, NULL);
+    if (window == NULL)
+    {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Mesh Batching", NULL, NULL);
+    }
+    if (window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        exit(-1);
+    }
+    glfwMakeContextCurrent(window);
+    // no vsync, so the frame times show the submission cost
+    glfwSwapInterval(0);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+
+    // glad: load all OpenGL function pointers
+    // ---------------------------------------
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        exit(-1);
+    }
+
+    // configure global opengl state
+    // -----------------------------
+    glEnable(GL_DEPTH_TEST);
+
+    return window;
+}
+
+// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
+// ---------------------------------------------------------------------------------------------------------
+void processInput(GLFWwindow* window)
+{
+	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+		glfwSetWindowShouldClose(window, true);
+	if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS)
+		drawMode = 1;
+	if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS)
+		drawMode = 2;
+	if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS)
+		drawMode = 3;
+}
+
+// glfw: whenever the window size changed (by OS or user resize) this callback function executes
+// ---------------------------------------------------------------------------------------------
+void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+{
+	// make sure the viewport matches the new window dimensions; note that width and
+	// height will be significantly larger than specified on retina displays.
+	glViewport(0, 0, width, height);
+}
+
+// glfw: whenever the mouse scroll wheel scrolls, this callback is called
+// ----------------------------------------------------------------------
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+{
+	camera.ProcessMouseScroll(yoffset);
+}
@@ -2,9 +2,15 @@
 
 #include <vector>
 #include <map>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iostream>
 #include <glm/glm.hpp>
 #include <assimp/scene.h>
 #include <learnopengl/bone.h>
+#include <learnopengl/compressed_animation.h>
+#include <memory>
 #include <functional>
 #include <learnopengl/animdata.h>
 #include <learnopengl/model_animation.h>
@@ -17,23 +23,86 @@ struct AssimpNodeData
 	std::vector<AssimpNodeData> children;
 };
 
+/*one node of the flattened hierarchy. nodes are stored parents-first, so a
+pose can be evaluated in a single pass over the array*/
+struct SkeletonNode
+{
+	std::string name;
+
+	/*index of the parent node in the flattened array, -1 for the root*/
+	int parentIndex;
+
+	/*index into Animation's bone channels, -1 when the node is not animated*/
+	int channelIndex;
+
+	/*index in finalBoneMatrices, -1 when no vertex is skinned to this node*/
+	int boneID;
+
+	/*levels below the node down to its deepest descendant : 0 for end
+	sites, small for finger and face chains*/
+	int height;
+
+	/*finger, toe tip, face and end site nodes, the only ones level of detail
+	drops (by height, see Animator::SetSkippedBoneHeight). set from the node
+	name, or from the list given to Animation::SetDetailBones*/
+	bool isDetail;
+
+	/*true when neither this node nor any ancestor is animated.
+	transformation then already holds the node's global transform*/
+	bool isStatic;
+
+	glm::mat4 transformation;
+	glm::mat4 offset;
+
+	/*the node's own transform relative to its parent, never folded*/
+	glm::mat4 localTransformation;
+};
+
+/*hierarchy and bone offsets of one rig. built once, then shared read-only
+by the clips of the rig (and through them by every instance playing them)*/
+struct Skeleton
+{
+	AssimpNodeData rootNode;
+	std::map<std::string, BoneInfo> boneInfoMap;
+};
+
 class Animation
 {
 public:
 	Animation() = default;
 
+	// imports the file again and plays its first clip. AnimationLibrary loads every clip from one import
 	Animation(const std::string& animationPath, Model* model)
 	{
 		Assimp::Importer importer;
 		const aiScene* scene = importer.ReadFile(animationPath, aiProcess_Triangulate);
 		assert(scene && scene->mRootNode);
 		auto animation = scene->mAnimations[0];
-		m_Duration = animation->mDuration;
-		m_TicksPerSecond = animation->mTicksPerSecond;
-		aiMatrix4x4 globalTransformation = scene->mRootNode->mTransformation;
-		globalTransformation = globalTransformation.Inverse();
-		ReadHierarchyData(m_RootNode, scene->mRootNode);
-		ReadMissingBones(animation, *model);
+
+		std::shared_ptr<Skeleton> skeleton = std::make_shared<Skeleton>();
+		ReadHierarchyData(skeleton->rootNode, scene->mRootNode);
+		AddMissingBones(animation, *model);
+		skeleton->boneInfoMap = model->GetBoneInfoMap();
+		ReadAnimation(animation, skeleton);
+	}
+
+	// one clip on a shared skeleton, which must already hold a bone for every channel of animation
+	Animation(const aiAnimation* animation, std::shared_ptr<const Skeleton> skeleton)
+	{
+		ReadAnimation(animation, skeleton);
+	}
+
+	// a clip whose channels are already read, e.g. from a baked asset
+	Animation(const std::string& name, float duration, int ticksPerSecond, std::vector<Bone> bones,
+		std::shared_ptr<const Skeleton> skeleton)
+		:
+		m_Duration(duration),
+		m_TicksPerSecond(ticksPerSecond),
+		m_Bones(std::move(bones)),
+		m_Name(name),
+		m_SharedSkeleton(skeleton)
+	{
+		CompileSkeleton();
 	}
 
 	~Animation()
@@ -55,39 +124,132 @@ public:
 	
 	inline float GetTicksPerSecond() { return m_TicksPerSecond; }
 	inline float GetDuration() { return m_Duration;}
-	inline const AssimpNodeData& GetRootNode() { return m_RootNode; }
+	inline const std::string& GetName() const { return m_Name; }
+	inline const AssimpNodeData& GetRootNode() { return m_SharedSkeleton->rootNode; }
 	inline const std::map<std::string,BoneInfo>& GetBoneIDMap() 
 	{ 
-		return m_BoneInfoMap;
+		return m_SharedSkeleton->boneInfoMap;
 	}
+	inline int GetBoneCount() { return (int)m_SharedSkeleton->boneInfoMap.size(); }
+	inline const std::shared_ptr<const Skeleton>& GetSharedSkeleton() const { return m_SharedSkeleton; }
+	inline const std::vector<SkeletonNode>& GetSkeleton() { return m_Skeleton; }
+	inline const Bone& GetBone(int channelIndex) const { return m_Bones[channelIndex]; }
+	inline const CompressedClip* GetCompressedClip() const { return m_Compressed.get(); }
+	inline const ClipCompressionStats& GetCompressionStats() const { return m_CompressionStats; }
+	inline int GetBoneChannelCount() const { return (int)m_Bones.size(); }
 
-private:
-	void ReadMissingBones(const aiAnimation* animation, Model& model)
+	/*builds the compressed copy of the bone channels that PoseSampler plays from
+	from now on, and measures its size and error against the source keys. the
+	joint error is kept within settings.positionTolerance : the tolerance is
+	split along every animated chain. while the measured error is above it, the
+	tolerances are halved and the grid rate doubled (source keys off the grid
+	are cut by it)*/
+	void Compress(const ClipCompressionSettings& settings = ClipCompressionSettings())
 	{
-		int size = animation->mNumChannels;
+		float ticksPerSecond = m_TicksPerSecond > 0 ? (float)m_TicksPerSecond : 25.0f;
+		std::vector<ChannelTolerance> tolerances = GetChannelTolerances(settings);
+		float sampleRate = settings.sampleRate;
+
+		m_CompressionStats = ClipCompressionStats();
+		for (const Bone& bone : m_Bones)
+		{
+			m_CompressionStats.sourceBytes += bone.GetPositionKeys().size() * sizeof(KeyPosition) +
+				bone.GetRotationKeys().size() * sizeof(KeyRotation) + bone.GetScaleKeys().size() * sizeof(KeyScale);
+		}
+
+		while (true)
+		{
+			std::shared_ptr<const CompressedClip> compressed =
+				std::make_shared<CompressedClip>(m_Bones, m_Duration, ticksPerSecond, sampleRate, tolerances);
+			std::swap(m_Compressed, compressed);
+			float error = MeasureJointError(sampleRate / ticksPerSecond);
 
+			//quantization sets a floor : a refinement that does not bring the error down is undone
+			if (compressed && error > 0.9f * m_CompressionStats.maxJointError)
+			{
+				std::swap(m_Compressed, compressed);
+				m_CompressionStats.refinements--;
+				break;
+			}
+			m_CompressionStats.compressedBytes = m_Compressed->GetBytes();
+			m_CompressionStats.maxJointError = error;
+			m_CompressionStats.withinTolerance = error <= settings.positionTolerance;
+			if (m_CompressionStats.withinTolerance || m_CompressionStats.refinements >= settings.maxRefinements)
+				break;
+
+			for (ChannelTolerance& tolerance : tolerances)
+			{
+				tolerance.position *= 0.5f;
+				tolerance.rotation *= 0.5f;
+				tolerance.scale *= 0.5f;
+			}
+			sampleRate *= 2.0f;
+			m_CompressionStats.refinements++;
+		}
+		if (!m_CompressionStats.withinTolerance)
+		{
+			std::cout << "WARNING::ANIMATION::COMPRESSION:: " << m_Name << ": max joint error " << m_CompressionStats.maxJointError
+				<< " above the tolerance of " << settings.positionTolerance << std::endl;
+		}
+
+		if (settings.discardSourceKeys)
+		{
+			for (Bone& bone : m_Bones)
+				bone.DiscardKeys();
+		}
+	}
+
+	/*marks exactly the named nodes as detail, for skeletons whose names
+	IsDetailBoneName does not recognize. animators playing the clip pick it
+	up on their next SetSkippedBoneHeight*/
+	void SetDetailBones(const std::vector<std::string>& names)
+	{
+		for (SkeletonNode& node : m_Skeleton)
+			node.isDetail = std::find(names.begin(), names.end(), node.name) != names.end();
+	}
+
+	/*fingers, toe tips, eyes, jaw and the end sites exporters add past the
+	last joint of a chain ("HeadTop_End", "Bip01 L Toe0Nub"). heads, hands,
+	feet and toe bases are not detail : frozen, they show*/
+	static bool IsDetailBoneName(const std::string& name)
+	{
+		std::string lower(name);
+		std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+		auto endsWith = [&lower](const char* suffix)
+		{
+			size_t length = std::strlen(suffix);
+			return lower.size() >= length && lower.compare(lower.size() - length, length, suffix) == 0;
+		};
+		if (endsWith("end") || endsWith("nub") || lower.find("end_site") != std::string::npos)
+			return true;
+
+		const char* details[] = { "finger", "thumb", "index", "middle", "ring", "pinky", "little", "eye", "jaw", "tongue" };
+		for (const char* detail : details)
+		{
+			if (lower.find(detail) != std::string::npos)
+				return true;
+		}
+		return false;
+	}
+
+	// gives every channel of animation that skins no vertex a bone id of its own in model
+	static void AddMissingBones(const aiAnimation* animation, Model& model)
+	{
 		auto& boneInfoMap = model.GetBoneInfoMap();//getting m_BoneInfoMap from Model class
 		int& boneCount = model.GetBoneCount(); //getting the m_BoneCounter from Model class
 
-		//reading channels(bones engaged in an animation and their keyframes)
-		for (int i = 0; i < size; i++)
+		for (unsigned int i = 0; i < animation->mNumChannels; i++)
 		{
-			auto channel = animation->mChannels[i];
-			std::string boneName = channel->mNodeName.data;
-
+			std::string boneName = animation->mChannels[i]->mNodeName.data;
 			if (boneInfoMap.find(boneName) == boneInfoMap.end())
 			{
 				boneInfoMap[boneName].id = boneCount;
 				boneCount++;
 			}
-			m_Bones.push_back(Bone(channel->mNodeName.data,
-				boneInfoMap[channel->mNodeName.data].id, channel));
 		}
-
-		m_BoneInfoMap = boneInfoMap;
 	}
 
-	void ReadHierarchyData(AssimpNodeData& dest, const aiNode* src)
+	static void ReadHierarchyData(AssimpNodeData& dest, const aiNode* src)
 	{
 		assert(src);
 
@@ -102,10 +264,212 @@ private:
 			dest.children.push_back(newData);
 		}
 	}
+private:
+	/*per channel share of the joint tolerance. a joint's position error is the
+	sum of what every animated ancestor adds : its translation error, plus its
+	rotation and scale error times the distance down to the joint. a channel on
+	an animated chain of k channels gets 1/k of the tolerance, a third each for
+	translation, rotation and scale, measured in model units on the bind pose*/
+	std::vector<ChannelTolerance> GetChannelTolerances(const ClipCompressionSettings& settings) const
+	{
+		auto maxScale = [](const glm::mat4& m)
+		{
+			return std::max(glm::length(glm::vec3(m[0])), std::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+		};
+
+		size_t numNodes = m_Skeleton.size();
+		std::vector<glm::mat4> bindGlobals(numNodes);
+		std::vector<int> depth(numNodes, 0), below(numNodes, 0);
+		for (size_t n = 0; n < numNodes; n++)
+		{
+			int parent = m_Skeleton[n].parentIndex;
+			int animated = m_Skeleton[n].channelIndex >= 0 ? 1 : 0;
+			bindGlobals[n] = parent >= 0 ? bindGlobals[parent] * m_Skeleton[n].localTransformation : m_Skeleton[n].localTransformation;
+			depth[n] = (parent >= 0 ? depth[parent] : 0) + animated;
+		}
+
+		//reach : distance from a node to its farthest descendant along the bones, in model units.
+		//animated bones are as long as their longest translation key
+		std::vector<float> reach(numNodes, 0.0f);
+		for (int n = (int)numNodes - 1; n > 0; n--)
+		{
+			int parent = m_Skeleton[n].parentIndex;
+			float length = glm::length(glm::vec3(m_Skeleton[n].localTransformation[3]));
+			if (m_Skeleton[n].channelIndex >= 0)
+			{
+				for (const KeyPosition& key : m_Bones[m_Skeleton[n].channelIndex].GetPositionKeys())
+					length = std::max(length, glm::length(key.position));
+			}
+			length *= maxScale(bindGlobals[parent]);
+			reach[parent] = std::max(reach[parent], reach[n] + length);
+			below[parent] = std::max(below[parent], below[n] + (m_Skeleton[n].channelIndex >= 0 ? 1 : 0));
+		}
+
+		std::vector<ChannelTolerance> tolerances(m_Bones.size(),
+			ChannelTolerance{ settings.positionTolerance / 3.0f, settings.rotationTolerance, settings.scaleTolerance });
+		for (size_t n = 0; n < numNodes; n++)
+		{
+			int channel = m_Skeleton[n].channelIndex;
+			if (channel < 0)
+				continue;
+
+			int parent = m_Skeleton[n].parentIndex;
+			float parentScale = parent >= 0 ? maxScale(bindGlobals[parent]) : 1.0f;
+			float ownScale = maxScale(m_Skeleton[n].localTransformation);
+			float share = settings.positionTolerance / (3.0f * (depth[n] + below[n]));
+
+			ChannelTolerance& tolerance = tolerances[channel];
+			tolerance.position = parentScale > 0.0f ? share / parentScale : share;
+			if (reach[n] > 0.0f)
+			{
+				tolerance.rotation = std::min(settings.rotationTolerance, share / reach[n]);
+				tolerance.scale = std::min(settings.scaleTolerance, share * ownScale / reach[n]);
+			}
+		}
+		return tolerances;
+	}
+
+	/*largest joint distance between the source and the compressed clip : on the
+	compression grid, halfway between its frames and at every source key time*/
+	float MeasureJointError(float framesPerTick)
+	{
+		std::vector<BoneCursor> sourceCursors(m_Bones.size()), compressedCursors(m_Bones.size());
+		std::vector<glm::mat4> sourceGlobals(m_Skeleton.size()), compressedGlobals(m_Skeleton.size());
+		float maxError = 0.0f;
+
+		std::vector<float> times;
+		int numFrames = (int)std::ceil(m_Duration * framesPerTick) + 1;
+		for (int f = 0; f < 2 * numFrames - 1; f++)
+			times.push_back(std::min(0.5f * f / framesPerTick, m_Duration));
+		for (const Bone& bone : m_Bones)
+		{
+			for (const KeyPosition& key : bone.GetPositionKeys())
+				times.push_back(key.timeStamp);
+			for (const KeyRotation& key : bone.GetRotationKeys())
+				times.push_back(key.timeStamp);
+			for (const KeyScale& key : bone.GetScaleKeys())
+				times.push_back(key.timeStamp);
+		}
+		std::sort(times.begin(), times.end());
+		times.erase(std::unique(times.begin(), times.end()), times.end());
+
+		for (float time : times)
+		{
+			for (size_t n = 0; n < m_Skeleton.size(); n++)
+			{
+				const SkeletonNode& node = m_Skeleton[n];
+				if (node.isStatic)
+				{
+					sourceGlobals[n] = compressedGlobals[n] = node.transformation;
+					continue;
+				}
+
+				glm::mat4 sourceLocal = node.transformation, compressedLocal = node.transformation;
+				if (node.channelIndex >= 0)
+				{
+					sourceLocal = m_Bones[node.channelIndex].Sample(time, sourceCursors[node.channelIndex]);
+					compressedLocal = m_Compressed->Sample(node.channelIndex, time, compressedCursors[node.channelIndex]);
+				}
+				sourceGlobals[n] = sourceGlobals[node.parentIndex] * sourceLocal;
+				compressedGlobals[n] = compressedGlobals[node.parentIndex] * compressedLocal;
+
+				float error = glm::length(glm::vec3(sourceGlobals[n][3]) - glm::vec3(compressedGlobals[n][3]));
+				if (error > maxError)
+					maxError = error;
+			}
+		}
+		return maxError;
+	}
+
+	void ReadAnimation(const aiAnimation* animation, std::shared_ptr<const Skeleton> skeleton)
+	{
+		m_Name = animation->mName.C_Str();
+		m_Duration = animation->mDuration;
+		m_TicksPerSecond = animation->mTicksPerSecond;
+		m_SharedSkeleton = skeleton;
+
+		//reading channels(bones engaged in an animation and their keyframes)
+		m_Bones.reserve(animation->mNumChannels);
+		for (unsigned int i = 0; i < animation->mNumChannels; i++)
+		{
+			auto channel = animation->mChannels[i];
+			auto boneInfo = skeleton->boneInfoMap.find(channel->mNodeName.data);
+			assert(boneInfo != skeleton->boneInfoMap.end());
+			m_Bones.push_back(Bone(channel->mNodeName.data, boneInfo->second.id, channel));
+		}
+
+		CompileSkeleton();
+	}
+
+	/*flattens the shared hierarchy into m_Skeleton once, binding channels and offsets by
+	index so the per-frame update does no string or map lookups. subtrees that
+	contain no bone are dropped*/
+	void CompileSkeleton()
+	{
+		m_Skeleton.clear();
+		std::map<std::string, int> channelIndices;
+		for (int i = 0; i < (int)m_Bones.size(); i++)
+			channelIndices.emplace(m_Bones[i].GetBoneName(), i);
+
+		CompileNode(m_SharedSkeleton->rootNode, -1, channelIndices);
+
+		//children come after their parents, so one backward pass settles every height
+		for (int i = (int)m_Skeleton.size() - 1; i > 0; i--)
+		{
+			SkeletonNode& parent = m_Skeleton[m_Skeleton[i].parentIndex];
+			parent.height = std::max(parent.height, m_Skeleton[i].height + 1);
+		}
+	}
+
+	bool CompileNode(const AssimpNodeData& src, int parentIndex, const std::map<std::string, int>& channelIndices)
+	{
+		SkeletonNode node;
+		node.name = src.name;
+		node.parentIndex = parentIndex;
+		node.channelIndex = -1;
+		node.boneID = -1;
+		node.height = 0;
+		node.isDetail = IsDetailBoneName(src.name);
+		node.transformation = src.transformation;
+		node.offset = glm::mat4(1.0f);
+		node.localTransformation = src.transformation;
+
+		auto channel = channelIndices.find(src.name);
+		if (channel != channelIndices.end())
+			node.channelIndex = channel->second;
+
+		auto boneInfo = m_SharedSkeleton->boneInfoMap.find(src.name);
+		if (boneInfo != m_SharedSkeleton->boneInfoMap.end())
+		{
+			node.boneID = boneInfo->second.id;
+			node.offset = boneInfo->second.offset;
+		}
+
+		//fold static chains from the root into constant global transforms
+		bool parentStatic = parentIndex < 0 || m_Skeleton[parentIndex].isStatic;
+		node.isStatic = parentStatic && node.channelIndex < 0;
+		if (node.isStatic && parentIndex >= 0)
+			node.transformation = m_Skeleton[parentIndex].transformation * node.transformation;
+
+		int index = (int)m_Skeleton.size();
+		m_Skeleton.push_back(node);
+
+		bool used = node.boneID >= 0 || node.channelIndex >= 0;
+		for (int i = 0; i < src.childrenCount; i++)
+			used = CompileNode(src.children[i], index, channelIndices) || used;
+
+		if (!used)
+			m_Skeleton.resize(index);
+		return used;
+	}
+
 	float m_Duration;
 	int m_TicksPerSecond;
 	std::vector<Bone> m_Bones;
-	AssimpNodeData m_RootNode;
-	std::map<std::string, BoneInfo> m_BoneInfoMap;
+	std::vector<SkeletonNode> m_Skeleton;
+	std::shared_ptr<const CompressedClip> m_Compressed;
+	ClipCompressionStats m_CompressionStats;
+	std::string m_Name;
+	std::shared_ptr<const Skeleton> m_SharedSkeleton;
 };
 
@@ -0,0 +1,267 @@
+#pragma once
+
+/* Mixes several animation clips in local space with weights, cross-fades and bone masks */
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <learnopengl/animation.h>
+#include <learnopengl/pose_soa.h>
+
+/*all clips are bound to the skeleton of a reference animation of the same
+model. binding, masks and scratch memory are set up in AddClip, so Update
+does no heap allocation and its cost grows linearly with the number of clips
+whose weight is above zero. the result is a bone palette just like
+Animator::GetFinalBoneMatrices*/
+class AnimationBlender
+{
+public:
+	AnimationBlender(Animation* reference, int maxClips = 4)
+		:
+		m_Reference(reference)
+	{
+		const std::vector<SkeletonNode>& skeleton = m_Reference->GetSkeleton();
+		int numNodes = (int)skeleton.size();
+
+		m_Clips.reserve(maxClips);
+		m_BindPose.Resize(numNodes);
+		m_NodePose.Resize(numNodes);
+		m_Blend.Resize(numNodes);
+		m_LaneWeights.assign(m_Blend.padded, 0.0f);
+		m_WeightSum.assign(m_Blend.padded, 0.0f);
+		m_Static.assign(numNodes, 1);
+		m_LocalTransforms.resize(numNodes);
+		m_GlobalTransforms.resize(numNodes);
+		m_FinalBoneMatrices.assign(m_Reference->GetBoneCount(), glm::mat4(1.0f));
+
+		for (int n = 0; n < numNodes; n++)
+			SetBindPose(n, skeleton[n].localTransformation);
+		UpdateStaticNodes();
+	}
+
+	// binds clip to the reference skeleton and returns its index. clip must animate the same model
+	int AddClip(Animation* clip, float weight = 0.0f)
+	{
+		const std::vector<SkeletonNode>& skeleton = m_Reference->GetSkeleton();
+
+		BlendClip blendClip;
+		blendClip.animation = clip;
+		blendClip.time = 0.0f;
+		blendClip.weight = weight;
+		blendClip.fadeTarget = weight;
+		blendClip.fadeSpeed = 0.0f;
+		blendClip.cursors.assign(clip->GetBoneChannelCount(), BoneCursor());
+		blendClip.nodeChannels.assign(skeleton.size(), -1);
+		blendClip.mask.assign(m_Blend.padded, 0.0f);
+		std::fill(blendClip.mask.begin(), blendClip.mask.begin() + skeleton.size(), 1.0f);
+		blendClip.pose.Resize(clip->GetBoneChannelCount());
+		blendClip.sampler.Reserve(clip->GetBoneChannelCount());
+
+		for (int c = 0; c < clip->GetBoneChannelCount(); c++)
+		{
+			const std::string& name = clip->GetBone(c).GetBoneName();
+			for (size_t n = 0; n < skeleton.size(); n++)
+			{
+				if (skeleton[n].name == name && blendClip.nodeChannels[n] < 0)
+				{
+					blendClip.nodeChannels[n] = c;
+					break;
+				}
+			}
+		}
+
+		m_Clips.push_back(blendClip);
+		UpdateStaticNodes();
+		return (int)m_Clips.size() - 1;
+	}
+
+	void SetWeight(int clip, float weight)
+	{
+		m_Clips[clip].weight = weight;
+		m_Clips[clip].fadeTarget = weight;
+		m_Clips[clip].fadeSpeed = 0.0f;
+	}
+
+	float GetWeight(int clip) const { return m_Clips[clip].weight; }
+
+	// fades the weight of clip to target over duration seconds
+	void FadeTo(int clip, float target, float duration)
+	{
+		BlendClip& blendClip = m_Clips[clip];
+		if (duration <= 0.0f)
+		{
+			SetWeight(clip, target);
+			return;
+		}
+		blendClip.fadeTarget = target;
+		blendClip.fadeSpeed = std::fabs(target - blendClip.weight) / duration;
+	}
+
+	// fades clip in to full weight and every other clip out over duration seconds
+	void CrossFade(int clip, float duration)
+	{
+		if (m_Clips[clip].weight <= 0.0f)
+			SetClipTime(clip, 0.0f);
+
+		for (int i = 0; i < (int)m_Clips.size(); i++)
+			FadeTo(i, i == clip ? 1.0f : 0.0f, duration);
+	}
+
+	void SetClipTime(int clip, float time) { m_Clips[clip].time = time; }
+
+	// scales the clip's weight by weight on the node called rootNode and on all of its descendants
+	void SetBoneMask(int clip, const std::string& rootNode, float weight)
+	{
+		const std::vector<SkeletonNode>& skeleton = m_Reference->GetSkeleton();
+		std::vector<char> inSubtree(skeleton.size(), 0);
+
+		for (size_t n = 0; n < skeleton.size(); n++)
+		{
+			int parent = skeleton[n].parentIndex;
+			inSubtree[n] = skeleton[n].name == rootNode || (parent >= 0 && inSubtree[parent]);
+			if (inSubtree[n])
+				m_Clips[clip].mask[n] = weight;
+		}
+	}
+
+	void Update(float dt)
+	{
+		const std::vector<SkeletonNode>& skeleton = m_Reference->GetSkeleton();
+		int numNodes = (int)skeleton.size();
+
+		m_Blend.Clear();
+		std::fill(m_WeightSum.begin(), m_WeightSum.end(), 0.0f);
+
+		for (BlendClip& clip : m_Clips)
+		{
+			if (clip.weight != clip.fadeTarget)
+			{
+				float step = clip.fadeSpeed * dt;
+				if (std::fabs(clip.fadeTarget - clip.weight) <= step)
+					clip.weight = clip.fadeTarget;
+				else
+					clip.weight += clip.fadeTarget > clip.weight ? step : -step;
+			}
+			if (clip.weight <= 0.0f)
+				continue;
+
+			Animation& animation = *clip.animation;
+			clip.time += animation.GetTicksPerSecond() * dt;
+			clip.time = fmod(clip.time, animation.GetDuration());
+			clip.sampler.Sample(animation, clip.time, clip.cursors.data(), clip.pose);
+
+			//move the clip's channels onto the reference nodes, unanimated nodes keep their bind pose
+			for (int n = 0; n < numNodes; n++)
+			{
+				int channel = clip.nodeChannels[n];
+				if (channel >= 0)
+					m_NodePose.Copy(n, clip.pose, channel);
+				else
+					m_NodePose.Copy(n, m_BindPose, n);
+				m_LaneWeights[n] = clip.weight * clip.mask[n];
+			}
+			PoseAccumulate(m_NodePose, m_LaneWeights.data(), m_Blend, m_WeightSum.data());
+		}
+
+		PoseNormalizeBlend(m_Blend, m_WeightSum.data());
+		for (int n = 0; n < numNodes; n++)
+		{
+			if (m_WeightSum[n] <= 0.0f)
+				m_Blend.Copy(n, m_BindPose, n);
+		}
+		PoseCompose(m_Blend, m_LocalTransforms.data());
+
+		for (int n = 0; n < numNodes; n++)
+		{
+			if (m_Static[n])
+				continue;
+
+			const SkeletonNode& node = skeleton[n];
+			if (node.parentIndex >= 0)
+				m_GlobalTransforms[n] = m_GlobalTransforms[node.parentIndex] * m_LocalTransforms[n];
+			else
+				m_GlobalTransforms[n] = m_LocalTransforms[n];
+
+			if (node.boneID >= 0)
+				m_FinalBoneMatrices[node.boneID] = m_GlobalTransforms[n] * node.offset;
+		}
+	}
+
+	const std::vector<glm::mat4>& GetFinalBoneMatrices() const
+	{
+		return m_FinalBoneMatrices;
+	}
+
+	int GetClipCount() const { return (int)m_Clips.size(); }
+
+private:
+	struct BlendClip
+	{
+		Animation* animation;
+		float time;
+		float weight;
+		float fadeTarget;
+		float fadeSpeed;	//weight change per second
+		std::vector<BoneCursor> cursors;
+		std::vector<int> nodeChannels;	//channel of this clip for each reference node, -1 if not animated
+		PoseFloats mask;	//per node weight factor
+		PoseSampler sampler;
+		PoseSoA pose;
+	};
+
+	void SetBindPose(int node, const glm::mat4& transform)
+	{
+		glm::vec3 translation(transform[3]);
+		glm::vec3 scale(glm::length(glm::vec3(transform[0])),
+			glm::length(glm::vec3(transform[1])),
+			glm::length(glm::vec3(transform[2])));
+		glm::mat3 rotation(glm::vec3(transform[0]) / scale.x,
+			glm::vec3(transform[1]) / scale.y,
+			glm::vec3(transform[2]) / scale.z);
+		m_BindPose.Set(node, translation, glm::normalize(glm::quat_cast(rotation)), scale);
+	}
+
+	/*nodes that no clip animates, and whose ancestors no clip animates, keep
+	their bind pose : their palette entries are computed here once and
+	skipped by Update*/
+	void UpdateStaticNodes()
+	{
+		const std::vector<SkeletonNode>& skeleton = m_Reference->GetSkeleton();
+
+		for (size_t n = 0; n < skeleton.size(); n++)
+		{
+			const SkeletonNode& node = skeleton[n];
+			bool animated = false;
+			for (const BlendClip& clip : m_Clips)
+				animated = animated || clip.nodeChannels[n] >= 0;
+
+			bool parentStatic = node.parentIndex < 0 || m_Static[node.parentIndex];
+			m_Static[n] = parentStatic && !animated;
+			if (!m_Static[n])
+				continue;
+
+			if (node.parentIndex >= 0)
+				m_GlobalTransforms[n] = m_GlobalTransforms[node.parentIndex] * node.localTransformation;
+			else
+				m_GlobalTransforms[n] = node.localTransformation;
+			if (node.boneID >= 0)
+				m_FinalBoneMatrices[node.boneID] = m_GlobalTransforms[n] * node.offset;
+		}
+	}
+
+	Animation* m_Reference;
+	std::vector<BlendClip> m_Clips;
+
+	PoseSoA m_BindPose;	//local bind transform of every reference node
+	PoseSoA m_NodePose;	//scratch : one clip's pose in reference node order
+	PoseSoA m_Blend;
+	PoseFloats m_LaneWeights;
+	PoseFloats m_WeightSum;
+	std::vector<char> m_Static;
+
+	std::vector<glm::mat4> m_LocalTransforms;
+	std::vector<glm::mat4> m_GlobalTransforms;
+	std::vector<glm::mat4> m_FinalBoneMatrices;
+};
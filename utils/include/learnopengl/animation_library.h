@@ -0,0 +1,122 @@
+#pragma once
+
+/* Imports a rigged model and all of its clips once, on one shared skeleton */
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <learnopengl/model_animation.h>
+#include <learnopengl/animation.h>
+
+/*the model file is read by Assimp once, for its meshes and for every clip it
+holds. more clips can come from files that only carry animation on the same
+rig (e.g. exported mixamo takes) : their hierarchy is ignored and their
+channels are bound to the model's by name.
+
+bones that only clips reference are added to the model first, then the
+skeleton is frozen and every clip is built on the same const Skeleton, so
+no clip keeps its own hierarchy or bone map. clips are never moved, so
+Animation pointers stay valid for the library's lifetime.*/
+class AnimationLibrary
+{
+public:
+	// options say how the model's meshes and textures are loaded (see ModelLoadOptions)
+	AnimationLibrary(const std::string& modelPath, const std::vector<std::string>& clipPaths = std::vector<std::string>(),
+		const ModelLoadOptions& options = ModelLoadOptions())
+		:
+		m_LoadSeconds(0.0)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		//every importer stays alive until all clips are read
+		std::vector<std::unique_ptr<Assimp::Importer>> importers;
+		std::vector<const aiScene*> scenes;
+
+		importers.push_back(std::unique_ptr<Assimp::Importer>(new Assimp::Importer()));
+		const aiScene* scene = importers.back()->ReadFile(modelPath,
+			aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace);
+		if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+		{
+			std::cout << "ERROR::ASSIMP:: " << importers.back()->GetErrorString() << std::endl;
+			return;
+		}
+		m_Model.reset(new Model(scene, modelPath, options));
+		scenes.push_back(scene);
+
+		for (const std::string& clipPath : clipPaths)
+		{
+			importers.push_back(std::unique_ptr<Assimp::Importer>(new Assimp::Importer()));
+			scene = importers.back()->ReadFile(clipPath, 0);
+			if (!scene || !scene->mRootNode)
+			{
+				std::cout << "ERROR::ASSIMP:: " << importers.back()->GetErrorString() << std::endl;
+				continue;
+			}
+			scenes.push_back(scene);
+		}
+
+		std::shared_ptr<Skeleton> skeleton = std::make_shared<Skeleton>();
+		Animation::ReadHierarchyData(skeleton->rootNode, scenes[0]->mRootNode);
+		for (const aiScene* clipScene : scenes)
+		{
+			for (unsigned int i = 0; i < clipScene->mNumAnimations; i++)
+				Animation::AddMissingBones(clipScene->mAnimations[i], *m_Model);
+		}
+		skeleton->boneInfoMap = m_Model->GetBoneInfoMap();
+		m_Skeleton = skeleton;
+
+		for (const aiScene* clipScene : scenes)
+		{
+			for (unsigned int i = 0; i < clipScene->mNumAnimations; i++)
+				m_Clips.push_back(std::unique_ptr<Animation>(new Animation(clipScene->mAnimations[i], m_Skeleton)));
+		}
+
+		m_LoadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// a library whose parts are already loaded, e.g. from a baked asset
+	AnimationLibrary(std::unique_ptr<Model> model, std::shared_ptr<const Skeleton> skeleton,
+		std::vector<std::unique_ptr<Animation>> clips, double loadSeconds)
+		:
+		m_Model(std::move(model)),
+		m_Skeleton(skeleton),
+		m_Clips(std::move(clips)),
+		m_LoadSeconds(loadSeconds)
+	{
+	}
+
+	AnimationLibrary(const AnimationLibrary&) = delete;
+	AnimationLibrary& operator=(const AnimationLibrary&) = delete;
+
+	bool IsLoaded() const { return m_Model != nullptr; }
+	Model& GetModel() { return *m_Model; }
+	const std::shared_ptr<const Skeleton>& GetSkeleton() const { return m_Skeleton; }
+
+	int GetClipCount() const { return (int)m_Clips.size(); }
+	Animation* GetClip(int clip) { return m_Clips[clip].get(); }
+
+	// first clip called name, or NULL
+	Animation* FindClip(const std::string& name)
+	{
+		for (auto& clip : m_Clips)
+		{
+			if (clip->GetName() == name)
+				return clip.get();
+		}
+		return NULL;
+	}
+
+	// wall time of the imports and of building the model and every clip
+	double GetLoadSeconds() const { return m_LoadSeconds; }
+
+private:
+	std::unique_ptr<Model> m_Model;
+	std::shared_ptr<const Skeleton> m_Skeleton;
+	std::vector<std::unique_ptr<Animation>> m_Clips;
+	double m_LoadSeconds;
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+/* Picks how often and how finely each animated character is evaluated from its size on screen */
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <vector>
+#include <learnopengl/animator.h>
+#include <learnopengl/mesh.h>
+
+struct AnimationLodLevel
+{
+	float minScreenSize;	//projected height over screen height from which this level is used
+	int updateInterval;	//the animator is updated every updateInterval frames
+	int skippedBoneHeight;	//see Animator::SetSkippedBoneHeight
+	int influences;	//skin influences the shader should use, up to MAX_BONE_INFLUENCE
+};
+
+/*levels are sorted from the closest to the farthest : a character uses the
+first level its bounding sphere is big enough for.
+
+reduced rates are time-sliced : an instance with interval n is updated on
+the frames where (frame + instance) % n == 0 with the time accumulated since
+its last update, so the updates of a crowd spread evenly over the frames
+instead of landing on the same one.*/
+class AnimationLod
+{
+public:
+	AnimationLod()
+		:
+		m_Frame(0),
+		m_BonesEvaluated(0),
+		m_InstancesUpdated(0)
+	{
+		//only detail bones are skipped, so heads, hands and feet move at every level :
+		//finger tips first, whole fingers (4 joints with the end site) far away
+		m_Levels.push_back({ 0.25f, 1, 0, MAX_BONE_INFLUENCE });
+		m_Levels.push_back({ 0.10f, 2, 2, 2 });
+		m_Levels.push_back({ 0.04f, 4, 4, 1 });
+		m_Levels.push_back({ 0.0f, 8, 4, 1 });
+	}
+
+	void SetLevels(const std::vector<AnimationLodLevel>& levels) { m_Levels = levels; }
+
+	// animator has to outlive the lod. radius bounds the character around position
+	int AddInstance(Animator* animator, const glm::vec3& position, float radius)
+	{
+		Instance instance;
+		instance.animator = animator;
+		instance.position = position;
+		instance.radius = radius;
+		instance.pendingTime = 0.0f;
+		instance.level = 0;
+		m_Instances.push_back(instance);
+
+		animator->SetSkippedBoneHeight(m_Levels[0].skippedBoneHeight);
+		animator->UpdateAnimation(0.0f);
+		return (int)m_Instances.size() - 1;
+	}
+
+	void SetPosition(int instance, const glm::vec3& position) { m_Instances[instance].position = position; }
+
+	// picks every instance's level for this camera, then updates the instances due this frame
+	void Update(float dt, const glm::mat4& view, const glm::mat4& projection)
+	{
+		m_BonesEvaluated = 0;
+		m_InstancesUpdated = 0;
+
+		for (int i = 0; i < (int)m_Instances.size(); i++)
+		{
+			Instance& instance = m_Instances[i];
+			instance.level = SelectLevel(ScreenSize(instance, view, projection));
+			const AnimationLodLevel& level = m_Levels[instance.level];
+
+			if (instance.animator->GetSkippedBoneHeight() != level.skippedBoneHeight)
+				instance.animator->SetSkippedBoneHeight(level.skippedBoneHeight);
+
+			instance.pendingTime += dt;
+			int interval = std::max(level.updateInterval, 1);
+			if ((m_Frame + i) % interval != 0)
+				continue;
+
+			instance.animator->UpdateAnimation(instance.pendingTime);
+			instance.pendingTime = 0.0f;
+			m_BonesEvaluated += instance.animator->GetBonesEvaluated();
+			m_InstancesUpdated++;
+		}
+		m_Frame++;
+	}
+
+	int GetInstanceCount() const { return (int)m_Instances.size(); }
+	int GetLevel(int instance) const { return m_Instances[instance].level; }
+	int GetInfluences(int instance) const { return m_Levels[m_Instances[instance].level].influences; }
+
+	// counters of the last Update
+	int GetBonesEvaluated() const { return m_BonesEvaluated; }
+	int GetInstancesUpdated() const { return m_InstancesUpdated; }
+
+private:
+	struct Instance
+	{
+		Animator* animator;
+		glm::vec3 position;
+		float radius;
+		float pendingTime;	//time passed since the last update
+		int level;
+	};
+
+	// diameter of the bounding sphere projected on screen, as a fraction of the screen height
+	static float ScreenSize(const Instance& instance, const glm::mat4& view, const glm::mat4& projection)
+	{
+		float depth = -(view * glm::vec4(instance.position, 1.0f)).z;
+		if (depth <= instance.radius)
+			return 1.0f;
+		return instance.radius * projection[1][1] / depth;
+	}
+
+	int SelectLevel(float screenSize) const
+	{
+		for (int i = 0; i < (int)m_Levels.size(); i++)
+		{
+			if (screenSize >= m_Levels[i].minScreenSize)
+				return i;
+		}
+		return (int)m_Levels.size() - 1;
+	}
+
+	std::vector<AnimationLodLevel> m_Levels;
+	std::vector<Instance> m_Instances;
+	unsigned long long m_Frame;
+	int m_BonesEvaluated;
+	int m_InstancesUpdated;
+};
@@ -1,12 +1,18 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <algorithm>
 #include <map>
 #include <vector>
 #include <assimp/scene.h>
 #include <assimp/Importer.hpp>
 #include <learnopengl/animation.h>
 #include <learnopengl/bone.h>
+#include <learnopengl/pose_soa.h>
+
+/*palette size of an animator without a clip : identity matrices for as many
+bones as the shaders used to bound the palette by*/
+#define MAX_BONES 100
 
 class Animator
 {
@@ -15,28 +21,74 @@ public:
 	{
 		m_CurrentTime = 0.0;
 		m_CurrentAnimation = animation;
+		m_SkippedBoneHeight = 0;
+		m_BonesEvaluated = 0;
 
-		m_FinalBoneMatrices.reserve(100);
-
-		for (int i = 0; i < 100; i++)
-			m_FinalBoneMatrices.push_back(glm::mat4(1.0f));
+		if (m_CurrentAnimation)
+			ResizeForAnimation();
+		else
+			m_FinalBoneMatrices.assign(MAX_BONES, glm::mat4(1.0f));
 	}
 
 	void UpdateAnimation(float dt)
 	{
-		m_DeltaTime = dt;
+		UpdateAnimation(dt, m_FinalBoneMatrices.data());
+	}
+
+	// same as above, but writes the palette to finalBoneMatrices (GetBoneCount() matrices) instead of the animator's own
+	void UpdateAnimation(float dt, glm::mat4* finalBoneMatrices)
+	{
 		if (m_CurrentAnimation)
 		{
 			m_CurrentTime += m_CurrentAnimation->GetTicksPerSecond() * dt;
 			m_CurrentTime = fmod(m_CurrentTime, m_CurrentAnimation->GetDuration());
-			CalculateBoneTransform(&m_CurrentAnimation->GetRootNode(), glm::mat4(1.0f));
+			CalculateSkeletonTransforms(finalBoneMatrices);
 		}
+		else
+			std::fill_n(finalBoneMatrices, m_FinalBoneMatrices.size(), glm::mat4(1.0f));
 	}
 
+	// NULL stops playback : the palette goes back to identity, the bind pose of the skinned mesh
 	void PlayAnimation(Animation* pAnimation)
 	{
 		m_CurrentAnimation = pAnimation;
 		m_CurrentTime = 0.0f;
+		m_BonesEvaluated = 0;
+		if (m_CurrentAnimation)
+			ResizeForAnimation();
+		else
+			m_FinalBoneMatrices.assign(std::max(m_FinalBoneMatrices.size(), (size_t)MAX_BONES), glm::mat4(1.0f));
+	}
+
+	// evaluates the pose with one pass over the flattened skeleton of the current animation
+	void CalculateSkeletonTransforms(glm::mat4* finalBoneMatrices)
+	{
+		const std::vector<SkeletonNode>& skeleton = m_CurrentAnimation->GetSkeleton();
+
+		//sample and compose every channel at once, then walk the hierarchy
+		const char* skip = m_SkippedBoneHeight > 0 ? m_SkipChannels.data() : NULL;
+		m_Sampler.Sample(*m_CurrentAnimation, m_CurrentTime, m_Cursors.data(), m_Pose, skip);
+		PoseCompose(m_Pose, m_LocalTransforms.data());
+		m_BonesEvaluated = m_EvaluatedChannels;
+
+		for (size_t i = 0; i < skeleton.size(); i++)
+		{
+			const SkeletonNode& node = skeleton[i];
+			glm::mat4& globalTransformation = m_GlobalTransforms[i];
+
+			if (node.isStatic)
+				globalTransformation = node.transformation;
+			else
+			{
+				bool sampled = node.channelIndex >= 0 && !(skip && skip[node.channelIndex]);
+				const glm::mat4& nodeTransform = sampled ?
+					m_LocalTransforms[node.channelIndex] : node.transformation;
+				globalTransformation = m_GlobalTransforms[node.parentIndex] * nodeTransform;
+			}
+
+			if (node.boneID >= 0)
+				finalBoneMatrices[node.boneID] = globalTransformation * node.offset;
+		}
 	}
 
 	void CalculateBoneTransform(const AssimpNodeData* node, glm::mat4 parentTransform)
@@ -46,19 +98,18 @@ public:
 
 		Bone* Bone = m_CurrentAnimation->FindBone(nodeName);
 
+		//the bones are shared by every animator of the clip, the playback position is this animator's
 		if (Bone)
-		{
-			Bone->Update(m_CurrentTime);
-			nodeTransform = Bone->GetLocalTransform();
-		}
+			nodeTransform = Bone->Sample(m_CurrentTime, m_Cursors[Bone - &m_CurrentAnimation->GetBone(0)]);
 
 		glm::mat4 globalTransformation = parentTransform * nodeTransform;
 
-		auto boneInfoMap = m_CurrentAnimation->GetBoneIDMap();
-		if (boneInfoMap.find(nodeName) != boneInfoMap.end())
+		const auto& boneInfoMap = m_CurrentAnimation->GetBoneIDMap();
+		auto boneInfo = boneInfoMap.find(nodeName);
+		if (boneInfo != boneInfoMap.end())
 		{
-			int index = boneInfoMap[nodeName].id;
-			glm::mat4 offset = boneInfoMap[nodeName].offset;
+			int index = boneInfo->second.id;
+			glm::mat4 offset = boneInfo->second.offset;
 			m_FinalBoneMatrices[index] = globalTransformation * offset;
 		}
 
@@ -66,15 +117,69 @@ public:
 			CalculateBoneTransform(&node->children[i], globalTransformation);
 	}
 
-	std::vector<glm::mat4> GetFinalBoneMatrices()
+	const std::vector<glm::mat4>& GetFinalBoneMatrices() const
 	{
 		return m_FinalBoneMatrices;
 	}
 
+	int GetBoneCount() const { return (int)m_FinalBoneMatrices.size(); }
+	float GetCurrentTime() const { return m_CurrentTime; }
+	void SetCurrentTime(float time) { m_CurrentTime = time; }
+
+	/*detail nodes (fingers, face, end sites : SkeletonNode::isDetail) less
+	than height levels above their deepest descendant are not sampled : they
+	keep their bind pose relative to the parent and follow it rigidly. every
+	other node is always sampled. 0 evaluates every node*/
+	void SetSkippedBoneHeight(int height)
+	{
+		m_SkippedBoneHeight = height;
+		if (m_CurrentAnimation)
+			UpdateSkippedChannels();
+	}
+	int GetSkippedBoneHeight() const { return m_SkippedBoneHeight; }
+
+	// bone channels sampled by the last update
+	int GetBonesEvaluated() const { return m_BonesEvaluated; }
+
 private:
+	// the palette holds one matrix per bone of the clip's model
+	void ResizeForAnimation()
+	{
+		m_FinalBoneMatrices.resize((size_t)m_CurrentAnimation->GetBoneCount(), glm::mat4(1.0f));
+		m_FinalBoneMatrices.shrink_to_fit();
+		m_GlobalTransforms.resize(m_CurrentAnimation->GetSkeleton().size());
+		m_Cursors.assign(m_CurrentAnimation->GetBoneChannelCount(), BoneCursor());
+		m_LocalTransforms.resize(m_CurrentAnimation->GetBoneChannelCount());
+		UpdateSkippedChannels();
+	}
+
+	// a channel is skipped when every node it drives is a detail node below the skipped height
+	void UpdateSkippedChannels()
+	{
+		int numChannels = m_CurrentAnimation->GetBoneChannelCount();
+		m_SkipChannels.assign(numChannels, m_SkippedBoneHeight > 0 ? 1 : 0);
+		for (const SkeletonNode& node : m_CurrentAnimation->GetSkeleton())
+		{
+			if (node.channelIndex >= 0 && (!node.isDetail || node.height >= m_SkippedBoneHeight))
+				m_SkipChannels[node.channelIndex] = 0;
+		}
+
+		m_EvaluatedChannels = 0;
+		for (char skipped : m_SkipChannels)
+			m_EvaluatedChannels += skipped ? 0 : 1;
+	}
+
 	std::vector<glm::mat4> m_FinalBoneMatrices;
+	std::vector<glm::mat4> m_GlobalTransforms;
+	std::vector<BoneCursor> m_Cursors;
+	std::vector<glm::mat4> m_LocalTransforms;
+	PoseSampler m_Sampler;
+	PoseSoA m_Pose;
+	std::vector<char> m_SkipChannels;
+	int m_SkippedBoneHeight;
+	int m_EvaluatedChannels;
+	int m_BonesEvaluated;
 	Animation* m_CurrentAnimation;
 	float m_CurrentTime;
-	float m_DeltaTime;
 
 };
@@ -0,0 +1,172 @@
+#pragma once
+
+/* Evaluates many animated instances in parallel into one palette array */
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <learnopengl/animation.h>
+#include <learnopengl/animator.h>
+#include <learnopengl/worker_pool.h>
+
+/*every instance is an Animator with its own playback time and key cursors,
+so instances sharing one Animation are evaluated independently. palettes of
+all instances are packed back to back in one contiguous array that can be
+uploaded in a single buffer write. instances are only reachable read-only
+from outside, so a clip change goes through PlayAnimation, which resizes the
+instance's palette slice to the new rig.
+
+work is split in chunks of instances. each thread starts on its own queue of
+chunks and steals from the back of the other queues once its own is empty,
+so uneven rigs/clips still keep every core busy until the frame is done.*/
+class AnimatorPool
+{
+public:
+	// numThreads = 0 uses every hardware thread. the calling thread always takes part in Update
+	AnimatorPool(unsigned int numThreads = 0, int chunkSize = 16)
+		:
+		m_ChunkSize(chunkSize > 0 ? chunkSize : 1),
+		m_DeltaTime(0.0f),
+		m_Pool(WorkerPool::ThreadCount(numThreads) - 1)
+	{
+		//one queue per thread, the calling thread's first
+		for (int i = 0; i <= m_Pool.GetWorkerCount(); i++)
+			m_Queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+	}
+
+	AnimatorPool(const AnimatorPool&) = delete;
+	AnimatorPool& operator=(const AnimatorPool&) = delete;
+
+	// adds an instance playing animation from startTime (in ticks) and returns its index
+	int AddInstance(Animation* animation, float startTime = 0.0f)
+	{
+		Animator animator(animation);
+		animator.SetCurrentTime(startTime);
+
+		m_PaletteOffsets.push_back((int)m_Palettes.size());
+		m_PaletteSizes.push_back(animator.GetBoneCount());
+		m_Palettes.resize(m_Palettes.size() + animator.GetBoneCount(), glm::mat4(1.0f));
+		m_Instances.push_back(animator);
+		return (int)m_Instances.size() - 1;
+	}
+
+	/*switches instance to animation from startTime (in ticks). a rig with more
+	bones than the instance's palette slice moves the slices after it, so call
+	it between Updates*/
+	void PlayAnimation(int instance, Animation* animation, float startTime = 0.0f)
+	{
+		Animator& animator = m_Instances[instance];
+		animator.PlayAnimation(animation);
+		animator.SetCurrentTime(startTime);
+		if (animator.GetBoneCount() > m_PaletteSizes[instance])
+			ResizePalette(instance, animator.GetBoneCount());
+	}
+
+	// advances every instance by dt and blocks until all palettes are written
+	void Update(float dt)
+	{
+		int numInstances = (int)m_Instances.size();
+		if (numInstances == 0)
+			return;
+
+		int numChunks = (numInstances + m_ChunkSize - 1) / m_ChunkSize;
+		int numQueues = (int)m_Queues.size();
+		for (int q = 0; q < numQueues; q++)
+		{
+			std::lock_guard<std::mutex> lock(m_Queues[q]->mutex);
+			for (int c = numChunks * q / numQueues; c < numChunks * (q + 1) / numQueues; c++)
+				m_Queues[q]->chunks.push_back(c);
+		}
+
+		m_DeltaTime = dt;
+		m_Pool.Run([this](int thread) { RunChunks(thread); });
+	}
+
+	int GetInstanceCount() const { return (int)m_Instances.size(); }
+	int GetThreadCount() const { return (int)m_Queues.size(); }
+	const Animator& GetInstance(int instance) const { return m_Instances[instance]; }
+
+	// the palettes of all instances, back to back
+	const std::vector<glm::mat4>& GetPalettes() const { return m_Palettes; }
+	int GetPaletteOffset(int instance) const { return m_PaletteOffsets[instance]; }
+	const glm::mat4* GetPalette(int instance) const { return &m_Palettes[m_PaletteOffsets[instance]]; }
+
+private:
+	// gives instance a slice of boneCount matrices, keeping every palette in place
+	void ResizePalette(int instance, int boneCount)
+	{
+		std::vector<glm::mat4> palettes;
+		palettes.reserve(m_Palettes.size() + boneCount - m_PaletteSizes[instance]);
+		for (size_t i = 0; i < m_Instances.size(); i++)
+		{
+			int offset = (int)palettes.size();
+			palettes.insert(palettes.end(), m_Palettes.begin() + m_PaletteOffsets[i],
+				m_Palettes.begin() + m_PaletteOffsets[i] + m_PaletteSizes[i]);
+			if ((int)i == instance)
+			{
+				palettes.resize(palettes.size() + boneCount - m_PaletteSizes[i], glm::mat4(1.0f));
+				m_PaletteSizes[i] = boneCount;
+			}
+			m_PaletteOffsets[i] = offset;
+		}
+		m_Palettes.swap(palettes);
+	}
+
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		std::deque<int> chunks;
+	};
+
+	void RunChunks(int queueIndex)
+	{
+		int chunk;
+		while (PopChunk(queueIndex, chunk) || StealChunk(queueIndex, chunk))
+		{
+			int begin = chunk * m_ChunkSize;
+			int end = std::min(begin + m_ChunkSize, (int)m_Instances.size());
+			for (int i = begin; i < end; i++)
+				m_Instances[i].UpdateAnimation(m_DeltaTime, &m_Palettes[m_PaletteOffsets[i]]);
+		}
+	}
+
+	bool PopChunk(int queueIndex, int& chunk)
+	{
+		WorkQueue& queue = *m_Queues[queueIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.chunks.empty())
+			return false;
+		chunk = queue.chunks.front();
+		queue.chunks.pop_front();
+		return true;
+	}
+
+	bool StealChunk(int queueIndex, int& chunk)
+	{
+		int numQueues = (int)m_Queues.size();
+		for (int i = 1; i < numQueues; i++)
+		{
+			WorkQueue& victim = *m_Queues[(queueIndex + i) % numQueues];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (victim.chunks.empty())
+				continue;
+			chunk = victim.chunks.back();
+			victim.chunks.pop_back();
+			return true;
+		}
+		return false;
+	}
+
+	std::vector<Animator> m_Instances;
+	std::vector<int> m_PaletteOffsets;
+	std::vector<int> m_PaletteSizes;
+	std::vector<glm::mat4> m_Palettes;
+
+	std::vector<std::unique_ptr<WorkQueue>> m_Queues;
+	int m_ChunkSize;
+	float m_DeltaTime;
+	WorkerPool m_Pool;	//last, so its workers stop before the members they use go
+};
@@ -0,0 +1,347 @@
+#pragma once
+
+/* Imports models on worker threads and uploads them to GL a little every frame */
+
+#include <glad/glad.h>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <learnopengl/model_animation.h>
+#include <learnopengl/texture_cache.h>
+#include <learnopengl/worker_pool.h>
+
+// a model handed out by AsyncModelLoader::Load, filled in while it loads
+class AsyncModel
+{
+public:
+	AsyncModel()
+		:
+		m_Failed(false),
+		m_NumMeshes(-1),
+		m_NumUploaded(0),
+		m_LoadSeconds(0.0)
+	{
+	}
+
+	// every mesh is uploaded; the bone map is complete from then on
+	bool IsReady() const { return m_NumUploaded == m_NumMeshes; }
+	bool IsFailed() const { return m_Failed; }
+
+	// meshes are added as they are uploaded, so the model can be drawn at any time on the GL thread
+	Model& GetModel() { return m_Model; }
+	void Draw(Shader& shader) { m_Model.Draw(shader); }
+
+	// -1 until the file is parsed
+	int GetMeshCount() const { return m_NumMeshes; }
+	int GetMeshesUploaded() const { return m_NumUploaded; }
+	// from Load to the last mesh upload
+	double GetLoadSeconds() const { return m_LoadSeconds; }
+
+private:
+	friend class AsyncModelLoader;
+
+	Model m_Model;
+	std::atomic<bool> m_Failed;
+	std::atomic<int> m_NumMeshes;
+	int m_NumUploaded;	//GL thread only
+	double m_LoadSeconds;
+	std::chrono::steady_clock::time_point m_Start;
+};
+
+/*Load returns at once. a worker parses the file with Assimp, gives the bones
+their ids in the order a blocking Model load would, then queues one job per
+mesh (vertex conversion) and one per distinct texture the TextureCache does
+not hold yet (stb_image decode) for the other workers.
+
+finished meshes and decoded textures are staged, and Update uploads them on
+the GL thread until its time budget is spent, so loading never stalls a
+frame for more than about the budget plus one upload. a mesh is uploaded once
+all of its textures are, so a model never draws with missing textures.*/
+class AsyncModelLoader
+{
+public:
+	// numThreads = 0 uses every hardware thread
+	AsyncModelLoader(unsigned int numThreads = 0)
+		:
+		m_Working(0),
+		m_Pool(WorkerPool::ThreadCount(numThreads))
+	{
+	}
+
+	AsyncModelLoader(const AsyncModelLoader&) = delete;
+	AsyncModelLoader& operator=(const AsyncModelLoader&) = delete;
+
+	std::shared_ptr<AsyncModel> Load(const string& path, const ModelLoadOptions& options = ModelLoadOptions())
+	{
+		std::shared_ptr<LoadJob> job = std::make_shared<LoadJob>();
+		job->model = std::make_shared<AsyncModel>();
+		job->model->m_Model.options = options;
+		job->model->m_Start = std::chrono::steady_clock::now();
+		job->path = path;
+		Post([this, job] { Import(job); });
+		return job->model;
+	}
+
+	// GL thread, once a frame : uploads staged textures, then meshes, for about budgetMs (at least one each call)
+	void Update(double budgetMs = 2.0)
+	{
+		auto start = std::chrono::steady_clock::now();
+		{
+			std::lock_guard<std::mutex> lock(m_StagedMutex);
+			for (auto& texture : m_StagedTextures)
+				m_Textures.push_back(std::move(texture));
+			for (auto& mesh : m_StagedMeshes)
+				m_Meshes.push_back(std::move(mesh));
+			m_StagedTextures.clear();
+			m_StagedMeshes.clear();
+		}
+
+		int uploads = 0;
+		auto spent = [&] {
+			return uploads > 0 && std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() >= budgetMs;
+		};
+
+		while (!m_Textures.empty())
+		{
+			if (spent())
+				return;
+			UploadTexture(*m_Textures.front());
+			m_Textures.pop_front();
+			uploads++;
+		}
+		for (size_t i = 0; i < m_Meshes.size();)
+		{
+			if (spent())
+				return;
+			if (!TexturesUploaded(*m_Meshes[i]))
+			{
+				i++;
+				continue;
+			}
+			UploadMesh(*m_Meshes[i]);
+			m_Meshes.erase(m_Meshes.begin() + i);
+			uploads++;
+		}
+	}
+
+	// something is still being imported, decoded or waiting for upload
+	bool IsBusy() const
+	{
+		if (m_Working > 0 || !m_Textures.empty() || !m_Meshes.empty())
+			return true;
+		std::lock_guard<std::mutex> lock(m_StagedMutex);
+		return !m_StagedTextures.empty() || !m_StagedMeshes.empty();
+	}
+
+	int GetThreadCount() const { return m_Pool.GetWorkerCount(); }
+
+private:
+	struct LoadJob
+	{
+		std::shared_ptr<AsyncModel> model;
+		std::string path;
+		Assimp::Importer importer;
+		const aiScene* scene = nullptr;
+		std::atomic<int> meshesLeft{ 0 };	//conversions still reading the scene, the last one frees it
+		std::vector<Texture> textures;	//one per distinct path, id is 0 until uploaded
+		std::vector<TextureRequest> textureRequests;	//TextureCache requests and keys of textures
+		std::vector<std::string> textureKeys;
+	};
+
+	struct StagedTexture
+	{
+		std::shared_ptr<LoadJob> job;
+		int index = 0;
+		PreparedTexture texture;
+	};
+
+	struct StagedMesh
+	{
+		std::shared_ptr<LoadJob> job;
+		vector<Vertex> vertices;
+		vector<unsigned int> indices;
+		vector<MeshLod> lods;
+		std::vector<int> textures;	//indices into job->textures
+	};
+
+	void Post(std::function<void()> work)
+	{
+		m_Working++;
+		m_Pool.Post([this, work] {
+			work();
+			m_Working--;
+		});
+	}
+
+	void Import(std::shared_ptr<LoadJob> job)
+	{
+		Model& model = job->model->m_Model;
+		const aiScene* scene = job->importer.ReadFile(job->path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace);
+		if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+		{
+			std::cout << "ERROR::ASSIMP:: " << job->importer.GetErrorString() << std::endl;
+			job->model->m_Failed = true;
+			return;
+		}
+		job->scene = scene;
+		model.directory = job->path.substr(0, job->path.find_last_of('/'));
+
+		std::vector<aiMesh*> meshes;
+		CollectMeshes(scene->mRootNode, scene, meshes);
+
+		// same texture kinds, in the same order, as Model::processMesh
+		static const std::pair<aiTextureType, const char*> textureKinds[] = {
+			{ aiTextureType_DIFFUSE, "texture_diffuse" },
+			{ aiTextureType_SPECULAR, "texture_specular" },
+			{ aiTextureType_HEIGHT, "texture_normal" },
+			{ aiTextureType_AMBIENT, "texture_height" },
+		};
+
+		std::map<string, int> textureIndex;
+		std::vector<std::vector<int>> meshTextures(meshes.size());
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			for (unsigned int b = 0; b < meshes[i]->mNumBones; b++)
+				model.RegisterBone(meshes[i]->mBones[b]);
+
+			aiMaterial* material = scene->mMaterials[meshes[i]->mMaterialIndex];
+			for (const auto& kind : textureKinds)
+			{
+				for (unsigned int t = 0; t < material->GetTextureCount(kind.first); t++)
+				{
+					aiString str;
+					material->GetTexture(kind.first, t, &str);
+					auto found = textureIndex.find(str.C_Str());
+					if (found == textureIndex.end())
+					{
+						Texture texture;
+						texture.id = 0;
+						texture.type = kind.second;
+						texture.path = str.C_Str();
+						found = textureIndex.insert(std::make_pair(texture.path, (int)job->textures.size())).first;
+						job->textures.push_back(texture);
+						job->textureRequests.push_back(TextureRequest{ model.directory + '/' + texture.path, model.options.flipTextures });
+						const TextureRequest& request = job->textureRequests.back();
+						job->textureKeys.push_back(TextureCache::Key(request.path, request.flip));
+					}
+					meshTextures[i].push_back(found->second);
+				}
+			}
+		}
+
+		job->meshesLeft = (int)meshes.size();
+		if (meshes.empty())
+		{
+			job->importer.FreeScene();
+			job->model->m_LoadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - job->model->m_Start).count();
+		}
+		job->model->m_NumMeshes = (int)meshes.size();
+
+		// textures other models already loaded are used as they are
+		for (int t = 0; t < (int)job->textures.size(); t++)
+		{
+			if (!TextureCache::Get().Find(job->textureKeys[t], job->textures[t].id))
+				Post([this, job, t] { DecodeTexture(job, t); });
+		}
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			aiMesh* mesh = meshes[i];
+			std::vector<int> textures = meshTextures[i];
+			Post([this, job, mesh, textures] { ConvertMesh(job, mesh, textures); });
+		}
+	}
+
+	// meshes in the order Model::processNode visits them
+	static void CollectMeshes(aiNode* node, const aiScene* scene, std::vector<aiMesh*>& meshes)
+	{
+		for (unsigned int i = 0; i < node->mNumMeshes; i++)
+			meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
+		for (unsigned int i = 0; i < node->mNumChildren; i++)
+			CollectMeshes(node->mChildren[i], scene, meshes);
+	}
+
+	void DecodeTexture(std::shared_ptr<LoadJob> job, int index)
+	{
+		std::unique_ptr<StagedTexture> staged(new StagedTexture());
+		staged->job = job;
+		staged->index = index;
+
+		staged->texture = TextureCache::Get().Prepare(job->textureRequests[index]);
+
+		std::lock_guard<std::mutex> lock(m_StagedMutex);
+		m_StagedTextures.push_back(std::move(staged));
+	}
+
+	// every bone is registered by Import, so this only reads the bone map
+	void ConvertMesh(std::shared_ptr<LoadJob> job, aiMesh* mesh, const std::vector<int>& textures)
+	{
+		std::unique_ptr<StagedMesh> staged(new StagedMesh());
+		staged->job = job;
+		staged->textures = textures;
+		job->model->m_Model.convertMesh(mesh, staged->vertices, staged->indices, staged->lods);
+		if (--job->meshesLeft == 0)
+			job->importer.FreeScene();
+
+		std::lock_guard<std::mutex> lock(m_StagedMutex);
+		m_StagedMeshes.push_back(std::move(staged));
+	}
+
+	static bool TexturesUploaded(const StagedMesh& staged)
+	{
+		for (int index : staged.textures)
+		{
+			if (staged.job->textures[index].id == 0)
+				return false;
+		}
+		return true;
+	}
+
+	static void UploadTexture(StagedTexture& staged)
+	{
+		Texture& texture = staged.job->textures[staged.index];
+		texture.id = TextureCache::Get().Insert(staged.job->textureKeys[staged.index], staged.texture);
+	}
+
+	static void UploadMesh(StagedMesh& staged)
+	{
+		vector<Texture> textures;
+		for (int index : staged.textures)
+			textures.push_back(staged.job->textures[index]);
+
+		AsyncModel& model = *staged.job->model;
+		for (int index : staged.textures)
+		{
+			const Texture& texture = staged.job->textures[index];
+			if (model.m_Model.m_TextureIndex.insert(std::make_pair(texture.path, model.m_Model.textures_loaded.size())).second)
+				model.m_Model.textures_loaded.push_back(texture);
+		}
+		model.m_Model.meshes.push_back(Mesh(std::move(staged.vertices), std::move(staged.indices), std::move(textures),
+			model.m_Model.options.packVertices, std::move(staged.lods)));
+		if (++model.m_NumUploaded == model.m_NumMeshes)
+			model.m_LoadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - model.m_Start).count();
+	}
+
+	std::atomic<int> m_Working;	//jobs queued or running
+
+	//finished by the workers, not yet taken by Update
+	mutable std::mutex m_StagedMutex;
+	std::vector<std::unique_ptr<StagedTexture>> m_StagedTextures;
+	std::vector<std::unique_ptr<StagedMesh>> m_StagedMeshes;
+
+	//GL thread side, waiting for upload
+	std::deque<std::unique_ptr<StagedTexture>> m_Textures;
+	std::vector<std::unique_ptr<StagedMesh>> m_Meshes;
+
+	//last, so its workers stop before the members they use go. jobs not started by then are dropped, their models stay incomplete
+	WorkerPool m_Pool;
+};
@@ -0,0 +1,194 @@
+#pragma once
+
+/* Animation clips baked into a bone palette texture for GPU-instanced playback */
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <learnopengl/animation.h>
+#include <learnopengl/animator.h>
+#include <learnopengl/bone_palette.h>
+
+// size of the clip table uniform array in the instanced skinning shader
+#define MAX_BAKED_CLIPS 16
+
+/*every clip is sampled at a fixed rate with an Animator, once, and stored as
+one row of an RGBA32F texture per frame : bone b of a frame takes texels
+3b..3b+2, the top three rows of its (affine) palette matrix. all clips of a
+model share the texture, one clip after the other.
+
+the clip table (first row, frame count, frame rate) goes to the shader as a
+uniform array, so an instance only needs a clip id and a time offset : the
+shader picks and blends the two frames around its time and animating the
+whole crowd costs no CPU work per frame.*/
+class BakedAnimationAtlas
+{
+public:
+	// boneCount is the model's bone count, after all of its clips have been loaded
+	BakedAnimationAtlas(int boneCount, float framesPerSecond = 30.0f)
+		:
+		m_BoneCount(boneCount),
+		m_FramesPerSecond(framesPerSecond),
+		m_NumRows(0),
+		m_Texture(0)
+	{
+	}
+
+	~BakedAnimationAtlas()
+	{
+		if (m_Texture)
+			glDeleteTextures(1, &m_Texture);
+	}
+
+	BakedAnimationAtlas(const BakedAnimationAtlas&) = delete;
+	BakedAnimationAtlas& operator=(const BakedAnimationAtlas&) = delete;
+
+	// bakes one looping clip and returns its clip id, -1 once MAX_BAKED_CLIPS are baked
+	int AddClip(Animation* animation)
+	{
+		if ((int)m_Clips.size() >= MAX_BAKED_CLIPS)
+			return -1;
+
+		float seconds = animation->GetDuration() / animation->GetTicksPerSecond();
+		int numFrames = std::max(1, (int)std::ceil(seconds * m_FramesPerSecond));
+		//the last frame blends back into frame 0, so the sample rate is stretched to fit the loop exactly
+		float framesPerSecond = numFrames / seconds;
+
+		Animator animator(animation);
+		std::vector<glm::mat4> palette(std::max(animator.GetBoneCount(), m_BoneCount), glm::mat4(1.0f));
+		m_Texels.resize((size_t)(m_NumRows + numFrames) * m_BoneCount * 12);
+
+		for (int frame = 0; frame < numFrames; frame++)
+		{
+			animator.SetCurrentTime(frame / framesPerSecond * animation->GetTicksPerSecond());
+			animator.CalculateSkeletonTransforms(palette.data());
+
+			float* row = &m_Texels[(size_t)(m_NumRows + frame) * m_BoneCount * 12];
+			for (int bone = 0; bone < m_BoneCount; bone++)
+			{
+				const glm::mat4& m = palette[bone];
+				for (int r = 0; r < 3; r++)
+				{
+					for (int c = 0; c < 4; c++)
+						row[bone * 12 + r * 4 + c] = m[c][r];
+				}
+			}
+		}
+
+		m_Clips.push_back(glm::vec4((float)m_NumRows, (float)numFrames, framesPerSecond, seconds));
+		m_NumRows += numFrames;
+		return (int)m_Clips.size() - 1;
+	}
+
+	// (re)creates the texture from every clip baked so far. the CPU copy is kept for later AddClip calls
+	void Upload()
+	{
+		if (m_NumRows == 0)
+			return;
+		if (!m_Texture)
+			glGenTextures(1, &m_Texture);
+
+		glBindTexture(GL_TEXTURE_2D, m_Texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, m_BoneCount * 3, m_NumRows, 0, GL_RGBA, GL_FLOAT, m_Texels.data());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	// sets the sampler and the clip table of an instanced skinning program, once after Upload. leaves shader in use
+	void SetupProgram(Shader& shader) const
+	{
+		shader.use();
+		shader.setInt("bakedPalettes", BAKED_PALETTE_TEXTURE_UNIT);
+		for (size_t i = 0; i < m_Clips.size(); i++)
+			shader.setVec4("bakedClips[" + std::to_string(i) + "]", m_Clips[i]);
+	}
+
+	void Bind() const
+	{
+		glActiveTexture(GL_TEXTURE0 + BAKED_PALETTE_TEXTURE_UNIT);
+		glBindTexture(GL_TEXTURE_2D, m_Texture);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	int GetClipCount() const { return (int)m_Clips.size(); }
+	int GetFrameCount() const { return m_NumRows; }
+	int GetBoneCount() const { return m_BoneCount; }
+	float GetClipLength(int clip) const { return m_Clips[clip].w; }
+	size_t GetTextureBytes() const { return m_Texels.size() * sizeof(float); }
+
+private:
+	int m_BoneCount;
+	float m_FramesPerSecond;
+	int m_NumRows;
+	std::vector<float> m_Texels;
+	std::vector<glm::vec4> m_Clips;	//first row, frame count, frames per second, length in seconds
+	unsigned int m_Texture;
+};
+
+// per-instance vertex data of the instanced skinning shader, locations 7-11
+struct BakedInstance
+{
+	glm::mat4 model;
+	glm::vec2 clip;	//clip id, time offset in seconds
+};
+
+/*instance buffer of a crowd : attached to the VAO of every mesh of a model
+so the whole crowd draws with one instanced call per mesh*/
+class BakedCrowd
+{
+public:
+	BakedCrowd()
+		:
+		m_Buffer(0),
+		m_Count(0)
+	{
+		glGenBuffers(1, &m_Buffer);
+	}
+
+	~BakedCrowd()
+	{
+		glDeleteBuffers(1, &m_Buffer);
+	}
+
+	BakedCrowd(const BakedCrowd&) = delete;
+	BakedCrowd& operator=(const BakedCrowd&) = delete;
+
+	void SetInstances(const std::vector<BakedInstance>& instances)
+	{
+		m_Count = (int)instances.size();
+		glBindBuffer(GL_ARRAY_BUFFER, m_Buffer);
+		glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(BakedInstance), instances.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// adds the instance attributes to a mesh VAO, once per mesh
+	void Attach(unsigned int vao) const
+	{
+		glBindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, m_Buffer);
+		for (int i = 0; i < 4; i++)
+		{
+			glEnableVertexAttribArray(7 + i);
+			glVertexAttribPointer(7 + i, 4, GL_FLOAT, GL_FALSE, sizeof(BakedInstance), (void*)(i * sizeof(glm::vec4)));
+			glVertexAttribDivisor(7 + i, 1);
+		}
+		glEnableVertexAttribArray(11);
+		glVertexAttribPointer(11, 2, GL_FLOAT, GL_FALSE, sizeof(BakedInstance), (void*)offsetof(BakedInstance, clip));
+		glVertexAttribDivisor(11, 1);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	int GetCount() const { return m_Count; }
+
+private:
+	unsigned int m_Buffer;
+	int m_Count;
+};
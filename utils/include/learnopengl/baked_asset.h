@@ -0,0 +1,525 @@
+#pragma once
+
+/* Cooked binary cache of a model, its skeleton and its clips, mapped straight into memory */
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <learnopengl/animation_library.h>
+#include <learnopengl/texture_cache.h>
+
+// 2 : meshes are stored after MeshOptimizer
+// 3 : level of detail table per mesh
+#define BAKED_ASSET_VERSION 3
+
+/*read-only view of a whole file : mmap where available, one plain read elsewhere*/
+class MappedFile
+{
+public:
+	MappedFile()
+		:
+		m_Data(NULL),
+		m_Size(0),
+		m_Mapped(false)
+	{
+	}
+
+	~MappedFile() { Close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const std::string& path)
+	{
+		Close();
+#ifndef _WIN32
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat info;
+		if (fstat(fd, &info) == 0 && info.st_size > 0)
+		{
+			void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data != MAP_FAILED)
+			{
+				m_Data = static_cast<const unsigned char*>(data);
+				m_Size = (size_t)info.st_size;
+				m_Mapped = true;
+			}
+		}
+		close(fd);
+		return m_Mapped;
+#else
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file)
+			return false;
+		m_Buffer.resize((size_t)file.tellg());
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(m_Buffer.data()), m_Buffer.size());
+		m_Data = m_Buffer.data();
+		m_Size = m_Buffer.size();
+		return (bool)file && m_Size > 0;
+#endif
+	}
+
+	void Close()
+	{
+#ifndef _WIN32
+		if (m_Mapped)
+			munmap(const_cast<unsigned char*>(m_Data), m_Size);
+#endif
+		m_Buffer.clear();
+		m_Data = NULL;
+		m_Size = 0;
+		m_Mapped = false;
+	}
+
+	const unsigned char* GetData() const { return m_Data; }
+	size_t GetSize() const { return m_Size; }
+
+private:
+	const unsigned char* m_Data;
+	size_t m_Size;
+	bool m_Mapped;
+	std::vector<unsigned char> m_Buffer;
+};
+
+struct BakedAssetHeader
+{
+	char magic[8];	//"LOGLBAKE"
+	uint32_t version;
+	uint32_t layout;	//struct sizes of the cooker, see BakedAsset::Layout
+	uint64_t sourceHash;
+	uint64_t fileSize;
+};
+
+/*the container holds, in this order :
+- header
+- meshes : counts, texture (type, path) pairs, then the Vertex and index
+  arrays exactly as Mesh uploads them
+- the model's bone map and bone count
+- the node hierarchy, depth first
+- clips : name, duration, rate, then per channel the KeyPosition,
+  KeyRotation and KeyScale arrays as Bone stores them
+arrays start on 16 byte boundaries, so the loader hands pointers into the
+mapping to glBufferData and to the key vectors without any per-element work.
+
+a cache is only used when its version, struct layout and source hash all
+match : any change to the source files, to BAKED_ASSET_VERSION or to the
+Vertex/key structs sends Load back to Assimp, which re-cooks the file.
+reading creates GL objects, so it has to run on the GL thread.*/
+class BakedAsset
+{
+public:
+	// reads bakedPath (modelPath + ".baked" by default) when it was cooked from these sources, else imports them and re-cooks it
+	static std::unique_ptr<AnimationLibrary> Load(const std::string& modelPath,
+		const std::vector<std::string>& clipPaths = std::vector<std::string>(), std::string bakedPath = "")
+	{
+		if (bakedPath.empty())
+			bakedPath = modelPath + ".baked";
+
+		uint64_t sourceHash = HashSources(modelPath, clipPaths);
+		std::unique_ptr<AnimationLibrary> library = Read(bakedPath, sourceHash, modelPath.substr(0, modelPath.find_last_of('/')));
+		if (library)
+			return library;
+
+		//cooking pays for MeshOptimizer once, every later Read gets the optimized meshes
+		ModelLoadOptions options;
+		options.optimizeMeshes = true;
+		library.reset(new AnimationLibrary(modelPath, clipPaths, options));
+		if (library->IsLoaded())
+			Cook(*library, bakedPath, sourceHash);
+		return library;
+	}
+
+	// content hash of the model file and every clip file, in order
+	static uint64_t HashSources(const std::string& modelPath, const std::vector<std::string>& clipPaths)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		uint32_t version = BAKED_ASSET_VERSION;
+		hash = Hash(&version, sizeof(version), hash);
+
+		std::vector<std::string> paths(1, modelPath);
+		paths.insert(paths.end(), clipPaths.begin(), clipPaths.end());
+		for (const std::string& path : paths)
+		{
+			MappedFile file;
+			uint64_t size = file.Open(path) ? file.GetSize() : ~0ull;
+			hash = Hash(&size, sizeof(size), hash);
+			hash = Hash(file.GetData(), file.GetSize(), hash);
+		}
+		return hash;
+	}
+
+	// writes library to bakedPath. call it before compressing clips with discardSourceKeys
+	static bool Cook(AnimationLibrary& library, const std::string& bakedPath, uint64_t sourceHash)
+	{
+		//written next to the target and renamed, so a reader never sees half a file
+		std::string tempPath = bakedPath + ".tmp";
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out)
+			return false;
+
+		BakedAssetHeader header;
+		std::memcpy(header.magic, "LOGLBAKE", 8);
+		header.version = BAKED_ASSET_VERSION;
+		header.layout = Layout();
+		header.sourceHash = sourceHash;
+		header.fileSize = 0;
+		Write(out, header);
+
+		Model& model = library.GetModel();
+		Write(out, (uint32_t)model.meshes.size());
+		for (const Mesh& mesh : model.meshes)
+		{
+			Write(out, (uint32_t)mesh.vertices.size());
+			Write(out, (uint32_t)mesh.indices.size());
+			Write(out, (uint32_t)mesh.textures.size());
+			for (const Texture& texture : mesh.textures)
+			{
+				WriteString(out, texture.type);
+				WriteString(out, texture.path);
+			}
+			WriteArray(out, mesh.vertices.data(), mesh.vertices.size());
+			WriteArray(out, mesh.indices.data(), mesh.indices.size());
+			Write(out, (uint32_t)mesh.lods.size());
+			WriteArray(out, mesh.lods.data(), mesh.lods.size());
+		}
+
+		const std::map<std::string, BoneInfo>& boneInfoMap = library.GetSkeleton()->boneInfoMap;
+		Write(out, (int32_t)model.GetBoneCount());
+		Write(out, (uint32_t)boneInfoMap.size());
+		for (const auto& bone : boneInfoMap)
+		{
+			WriteString(out, bone.first);
+			Write(out, (int32_t)bone.second.id);
+			Write(out, bone.second.offset);
+		}
+
+		WriteNode(out, library.GetSkeleton()->rootNode);
+
+		Write(out, (uint32_t)library.GetClipCount());
+		for (int c = 0; c < library.GetClipCount(); c++)
+		{
+			Animation& clip = *library.GetClip(c);
+			WriteString(out, clip.GetName());
+			Write(out, clip.GetDuration());
+			Write(out, (int32_t)clip.GetTicksPerSecond());
+			Write(out, (uint32_t)clip.GetBoneChannelCount());
+			for (int i = 0; i < clip.GetBoneChannelCount(); i++)
+			{
+				const Bone& bone = clip.GetBone(i);
+				WriteString(out, bone.GetBoneName());
+				Write(out, (int32_t)bone.GetBoneID());
+				Write(out, (uint32_t)bone.GetPositionKeys().size());
+				Write(out, (uint32_t)bone.GetRotationKeys().size());
+				Write(out, (uint32_t)bone.GetScaleKeys().size());
+				WriteArray(out, bone.GetPositionKeys().data(), bone.GetPositionKeys().size());
+				WriteArray(out, bone.GetRotationKeys().data(), bone.GetRotationKeys().size());
+				WriteArray(out, bone.GetScaleKeys().data(), bone.GetScaleKeys().size());
+			}
+		}
+
+		header.fileSize = (uint64_t)out.tellp();
+		out.seekp(0);
+		Write(out, header);
+		out.close();
+		if (!out)
+			return false;
+
+		std::remove(bakedPath.c_str());
+		return std::rename(tempPath.c_str(), bakedPath.c_str()) == 0;
+	}
+
+	/*maps bakedPath and builds the library from it, or returns nullptr when
+	the file is missing, stale or damaged. directory is where the textures
+	are loaded from. meshes only keep their vertices/indices on the CPU
+	(bulk copies out of the mapping) when keepVertexData is set. packVertices
+	uploads them as PackedVertex (see ModelLoadOptions::packVertices)*/
+	static std::unique_ptr<AnimationLibrary> Read(const std::string& bakedPath, uint64_t sourceHash,
+		const std::string& directory, bool keepVertexData = false, bool packVertices = false)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		MappedFile file;
+		if (!file.Open(bakedPath))
+			return nullptr;
+
+		Reader in(file.GetData(), file.GetSize());
+		const BakedAssetHeader* header = in.Array<BakedAssetHeader>(1);
+		if (!header || std::memcmp(header->magic, "LOGLBAKE", 8) != 0 || header->version != BAKED_ASSET_VERSION ||
+			header->layout != Layout() || header->sourceHash != sourceHash || header->fileSize != file.GetSize())
+			return nullptr;
+
+		std::unique_ptr<Model> model(new Model());
+		model->directory = directory;
+		model->options.packVertices = packVertices;
+		LoadTextures(in, *model);
+
+		uint32_t numMeshes = in.Pod<uint32_t>();
+		for (uint32_t m = 0; m < numMeshes && in.ok; m++)
+		{
+			uint32_t numVertices = in.Pod<uint32_t>();
+			uint32_t numIndices = in.Pod<uint32_t>();
+			uint32_t numTextures = in.Pod<uint32_t>();
+			std::vector<Texture> textures;
+			for (uint32_t t = 0; t < numTextures && in.ok; t++)
+			{
+				std::string type = in.String();
+				std::string path = in.String();
+				if (in.ok)
+					textures.push_back(model->loadTexture(path.c_str(), type));
+			}
+			const Vertex* vertices = in.Array<Vertex>(numVertices);
+			const unsigned int* indices = in.Array<unsigned int>(numIndices);
+			uint32_t numLods = in.Pod<uint32_t>();
+			const MeshLod* lods = in.Array<MeshLod>(numLods);
+			if (!in.ok)
+				return nullptr;
+
+			std::vector<MeshLod> lodTable(lods, lods + numLods);
+			for (const MeshLod& lod : lodTable)
+			{
+				if ((uint64_t)lod.indexOffset + lod.indexCount > numIndices)
+					return nullptr;
+			}
+			if (keepVertexData)
+				model->meshes.push_back(Mesh(std::vector<Vertex>(vertices, vertices + numVertices),
+					std::vector<unsigned int>(indices, indices + numIndices), textures, packVertices, lodTable));
+			else
+				model->meshes.push_back(Mesh(vertices, numVertices, indices, numIndices, textures, packVertices, lodTable));
+		}
+
+		model->GetBoneCount() = in.Pod<int32_t>();
+		uint32_t numBones = in.Pod<uint32_t>();
+		for (uint32_t b = 0; b < numBones && in.ok; b++)
+		{
+			std::string name = in.String();
+			BoneInfo& info = model->GetBoneInfoMap()[name];
+			info.id = in.Pod<int32_t>();
+			info.offset = in.Pod<glm::mat4>();
+		}
+
+		std::shared_ptr<Skeleton> skeleton = std::make_shared<Skeleton>();
+		ReadNode(in, skeleton->rootNode);
+		skeleton->boneInfoMap = model->GetBoneInfoMap();
+
+		std::vector<std::unique_ptr<Animation>> clips;
+		uint32_t numClips = in.Pod<uint32_t>();
+		for (uint32_t c = 0; c < numClips && in.ok; c++)
+		{
+			std::string name = in.String();
+			float duration = in.Pod<float>();
+			int ticksPerSecond = in.Pod<int32_t>();
+			uint32_t numChannels = in.Pod<uint32_t>();
+
+			std::vector<Bone> bones;
+			bones.reserve(numChannels);
+			for (uint32_t i = 0; i < numChannels && in.ok; i++)
+			{
+				std::string boneName = in.String();
+				int id = in.Pod<int32_t>();
+				uint32_t numPositions = in.Pod<uint32_t>();
+				uint32_t numRotations = in.Pod<uint32_t>();
+				uint32_t numScales = in.Pod<uint32_t>();
+				const KeyPosition* positions = in.Array<KeyPosition>(numPositions);
+				const KeyRotation* rotations = in.Array<KeyRotation>(numRotations);
+				const KeyScale* scales = in.Array<KeyScale>(numScales);
+				if (!in.ok || numPositions == 0 || numRotations == 0 || numScales == 0)
+					return nullptr;
+
+				bones.push_back(Bone(boneName, id,
+					std::vector<KeyPosition>(positions, positions + numPositions),
+					std::vector<KeyRotation>(rotations, rotations + numRotations),
+					std::vector<KeyScale>(scales, scales + numScales)));
+			}
+			if (in.ok)
+				clips.push_back(std::unique_ptr<Animation>(new Animation(name, duration, ticksPerSecond, std::move(bones), skeleton)));
+		}
+		if (!in.ok)
+			return nullptr;
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return std::unique_ptr<AnimationLibrary>(new AnimationLibrary(std::move(model), skeleton, std::move(clips), seconds));
+	}
+
+	/*the texture requests Read batches before building the meshes, for
+	checking a cooked file against the model it was cooked from. model gives
+	the directory and flip flag; the source hash is not checked*/
+	static bool ListTextures(const std::string& bakedPath, const Model& model, std::vector<TextureRequest>& requests)
+	{
+		MappedFile file;
+		if (!file.Open(bakedPath))
+			return false;
+		Reader in(file.GetData(), file.GetSize());
+		const BakedAssetHeader* header = in.Array<BakedAssetHeader>(1);
+		if (!header || std::memcmp(header->magic, "LOGLBAKE", 8) != 0 || header->version != BAKED_ASSET_VERSION ||
+			header->layout != Layout() || header->fileSize != file.GetSize())
+			return false;
+		return ReadTextureRequests(in, model, requests);
+	}
+
+	// sizes of every struct stored as raw memory, one byte each
+	static uint32_t Layout()
+	{
+		return (uint32_t)sizeof(Vertex) | (uint32_t)sizeof(KeyPosition) << 8 |
+			(uint32_t)sizeof(KeyRotation) << 16 | (uint32_t)sizeof(KeyScale) << 24;
+	}
+
+private:
+	// bounds checked cursor over the mapping. any overrun clears ok and every later read returns zeroes
+	struct Reader
+	{
+		const unsigned char* data;
+		size_t size;
+		size_t pos;
+		bool ok;
+
+		Reader(const unsigned char* data, size_t size) : data(data), size(size), pos(0), ok(true) {}
+
+		bool Skip(size_t bytes)
+		{
+			if (!ok || bytes > size - pos)
+				return ok = false;
+			pos += bytes;
+			return true;
+		}
+
+		template<typename T>
+		T Pod()
+		{
+			T value;
+			std::memset(&value, 0, sizeof(T));
+			size_t at = pos;
+			if (Skip(sizeof(T)))
+				std::memcpy(&value, data + at, sizeof(T));
+			return value;
+		}
+
+		template<typename T>
+		const T* Array(size_t count)
+		{
+			if (!Skip((16 - pos % 16) % 16))
+				return NULL;
+			size_t at = pos;
+			if (count > (size - pos) / sizeof(T))
+				ok = false;
+			if (!Skip(count * sizeof(T)))
+				return NULL;
+			return reinterpret_cast<const T*>(data + at);
+		}
+
+		std::string String()
+		{
+			uint32_t length = Pod<uint32_t>();
+			size_t at = pos;
+			if (!Skip(length))
+				return std::string();
+			return std::string(reinterpret_cast<const char*>(data + at), length);
+		}
+	};
+
+	// 64 bit FNV-1a style hash, eight bytes per step
+	static uint64_t Hash(const void* bytes, size_t size, uint64_t hash)
+	{
+		const unsigned char* p = static_cast<const unsigned char*>(bytes);
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8)
+		{
+			uint64_t word;
+			std::memcpy(&word, p + i, 8);
+			hash = (hash ^ word) * 1099511628211ull;
+		}
+		for (; i < size; i++)
+			hash = (hash ^ p[i]) * 1099511628211ull;
+		return hash;
+	}
+
+	template<typename T>
+	static void Write(std::ofstream& out, const T& value)
+	{
+		out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	static void WriteArray(std::ofstream& out, const T* values, size_t count)
+	{
+		static const char zeroes[16] = {};
+		out.write(zeroes, (16 - (size_t)out.tellp() % 16) % 16);
+		out.write(reinterpret_cast<const char*>(values), count * sizeof(T));
+	}
+
+	static void WriteString(std::ofstream& out, const std::string& value)
+	{
+		Write(out, (uint32_t)value.size());
+		out.write(value.data(), value.size());
+	}
+
+	static void WriteNode(std::ofstream& out, const AssimpNodeData& node)
+	{
+		WriteString(out, node.name);
+		Write(out, node.transformation);
+		Write(out, (uint32_t)node.children.size());
+		for (const AssimpNodeData& child : node.children)
+			WriteNode(out, child);
+	}
+
+	// decodes the textures of every mesh as one TextureCache batch; reads a copy of in, so in stays at the meshes
+	static void LoadTextures(Reader in, const Model& model)
+	{
+		std::vector<TextureRequest> requests;
+		if (ReadTextureRequests(in, model, requests))
+			TextureCache::Get().Load(requests);
+	}
+
+	// the textures of every mesh in file order, skipping over the rest of the mesh records; false on a damaged file
+	static bool ReadTextureRequests(Reader in, const Model& model, std::vector<TextureRequest>& requests)
+	{
+		uint32_t numMeshes = in.Pod<uint32_t>();
+		for (uint32_t m = 0; m < numMeshes && in.ok; m++)
+		{
+			uint32_t numVertices = in.Pod<uint32_t>();
+			uint32_t numIndices = in.Pod<uint32_t>();
+			uint32_t numTextures = in.Pod<uint32_t>();
+			for (uint32_t t = 0; t < numTextures && in.ok; t++)
+			{
+				in.String();	//type
+				std::string path = in.String();
+				if (in.ok)
+					requests.push_back(TextureRequest{ model.directory + '/' + path, model.options.flipTextures });
+			}
+			in.Array<Vertex>(numVertices);
+			in.Array<unsigned int>(numIndices);
+			uint32_t numLods = in.Pod<uint32_t>();
+			in.Array<MeshLod>(numLods);
+		}
+		return in.ok;
+	}
+
+	static void ReadNode(Reader& in, AssimpNodeData& node)
+	{
+		node.name = in.String();
+		node.transformation = in.Pod<glm::mat4>();
+		uint32_t numChildren = in.Pod<uint32_t>();
+		node.childrenCount = 0;
+		for (uint32_t i = 0; i < numChildren && in.ok; i++)
+		{
+			node.children.push_back(AssimpNodeData());
+			ReadNode(in, node.children.back());
+			node.childrenCount++;
+		}
+	}
+};
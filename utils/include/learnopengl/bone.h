@@ -3,6 +3,7 @@
 /* Container for bone data */
 
 #include <vector>
+#include <algorithm>
 #include <assimp/scene.h>
 #include <list>
 #include <glm/glm.hpp>
@@ -28,14 +29,46 @@ struct KeyScale
 	float timeStamp;
 };
 
+/*the value of a track without keys : no translation, no rotation, unit scale.
+picked by the track's type, so a sampler can fall back to it for any track*/
+inline const KeyPosition& IdentityKey(const std::vector<KeyPosition>&)
+{
+	static const KeyPosition key = { glm::vec3(0.0f), 0.0f };
+	return key;
+}
+inline const KeyRotation& IdentityKey(const std::vector<KeyRotation>&)
+{
+	static const KeyRotation key = { glm::quat(1.0f, 0.0f, 0.0f, 0.0f), 0.0f };
+	return key;
+}
+inline const KeyScale& IdentityKey(const std::vector<KeyScale>&)
+{
+	static const KeyScale key = { glm::vec3(1.0f), 0.0f };
+	return key;
+}
+
+/*time of a key, so the key search below runs over any key array*/
+template<typename KeyType>
+inline float GetKeyTime(const KeyType& key) { return key.timeStamp; }
+inline float GetKeyTime(unsigned short frame) { return (float)frame; }
+
+/*playback position of one bone channel : the key pair found by the last
+sample of each track. every animated instance owns its own cursors, so the
+keys themselves can be shared read-only*/
+struct BoneCursor
+{
+	int position = 0;
+	int rotation = 0;
+	int scale = 0;
+};
+
 class Bone
 {
 public:
 	Bone(const std::string& name, int ID, const aiNodeAnim* channel)
 		:
 		m_Name(name),
-		m_ID(ID),
-		m_LocalTransform(1.0f)
+		m_ID(ID)
 	{
 		m_NumPositions = channel->mNumPositionKeys;
 
@@ -72,67 +105,111 @@ public:
 		}
 	}
 	
-	void Update(float animationTime)
+	// a channel whose keys are already decoded, e.g. from a baked asset
+	Bone(const std::string& name, int ID, std::vector<KeyPosition> positions,
+		std::vector<KeyRotation> rotations, std::vector<KeyScale> scales)
+		:
+		m_Positions(std::move(positions)),
+		m_Rotations(std::move(rotations)),
+		m_Scales(std::move(scales)),
+		m_Name(name),
+		m_ID(ID)
 	{
-		glm::mat4 translation = InterpolatePosition(animationTime);
-		glm::mat4 rotation = InterpolateRotation(animationTime);
-		glm::mat4 scale = InterpolateScaling(animationTime);
-		m_LocalTransform = translation * rotation * scale;
+		m_NumPositions = (int)m_Positions.size();
+		m_NumRotations = (int)m_Rotations.size();
+		m_NumScalings = (int)m_Scales.size();
 	}
-	glm::mat4 GetLocalTransform() { return m_LocalTransform; }
+
+	/*samples the local transform without touching the bone, so one clip can
+	be evaluated by any number of instances (and threads) at once. a track
+	without keys contributes its IdentityKey*/
+	glm::mat4 Sample(float animationTime, BoneCursor& cursor) const
+	{
+		glm::mat4 translation = InterpolatePosition(animationTime, cursor.position);
+		glm::mat4 rotation = InterpolateRotation(animationTime, cursor.rotation);
+		glm::mat4 scale = InterpolateScaling(animationTime, cursor.scale);
+		return translation * rotation * scale;
+	}
+
 	std::string GetBoneName() const { return m_Name; }
-	int GetBoneID() { return m_ID; }
-	
+	int GetBoneID() const { return m_ID; }
 
+	const std::vector<KeyPosition>& GetPositionKeys() const { return m_Positions; }
+	const std::vector<KeyRotation>& GetRotationKeys() const { return m_Rotations; }
+	const std::vector<KeyScale>& GetScaleKeys() const { return m_Scales; }
 
-	int GetPositionIndex(float animationTime)
+	// frees every key but the first of each track, once the clip is played from compressed data. empty tracks stay empty
+	void DiscardKeys()
 	{
-		for (int index = 0; index < m_NumPositions - 1; ++index)
-		{
-			if (animationTime < m_Positions[index + 1].timeStamp)
-				return index;
-		}
-		assert(0);
+		m_Positions.resize(std::min(m_Positions.size(), (size_t)1)); m_Positions.shrink_to_fit();
+		m_Rotations.resize(std::min(m_Rotations.size(), (size_t)1)); m_Rotations.shrink_to_fit();
+		m_Scales.resize(std::min(m_Scales.size(), (size_t)1)); m_Scales.shrink_to_fit();
+		m_NumPositions = (int)m_Positions.size();
+		m_NumRotations = (int)m_Rotations.size();
+		m_NumScalings = (int)m_Scales.size();
 	}
 
-	int GetRotationIndex(float animationTime)
+	static float GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime)
 	{
-		for (int index = 0; index < m_NumRotations - 1; ++index)
-		{
-			if (animationTime < m_Rotations[index + 1].timeStamp)
-				return index;
-		}
-		assert(0);
+		float scaleFactor = 0.0f;
+		float midWayLength = animationTime - lastTimeStamp;
+		float framesDiff = nextTimeStamp - lastTimeStamp;
+		if (framesDiff <= 0.0f)
+			return 0.0f;
+		scaleFactor = midWayLength / framesDiff;
+		//times before the first key or past the last key hold the end pose
+		if (scaleFactor < 0.0f) scaleFactor = 0.0f;
+		if (scaleFactor > 1.0f) scaleFactor = 1.0f;
+		return scaleFactor;
 	}
 
-	int GetScaleIndex(float animationTime)
+	/*returns index i of the key pair [i, i+1] that brackets animationTime.
+	cursor is the index found by the previous call : normal forward playback
+	lands on the same or the next pair, so only seeks and loop wrap fall back
+	to a binary search. times outside the clip clamp to the first/last pair.
+	tracks of fewer than two keys have no pair and return 0 : callers handle
+	them before indexing.*/
+	template<typename KeyType>
+	static int FindKeyIndex(const std::vector<KeyType>& keys, float animationTime, int& cursor)
 	{
-		for (int index = 0; index < m_NumScalings - 1; ++index)
+		int numKeys = static_cast<int>(keys.size());
+		if (numKeys < 2)
+			return 0;
+
+		int lastPair = numKeys - 2;
+		if (cursor < 0 || cursor > lastPair)
+			cursor = 0;
+
+		if (animationTime >= GetKeyTime(keys[cursor]))
 		{
-			if (animationTime < m_Scales[index + 1].timeStamp)
-				return index;
+			if (cursor == lastPair || animationTime < GetKeyTime(keys[cursor + 1]))
+				return cursor;
+			if (cursor + 1 == lastPair || animationTime < GetKeyTime(keys[cursor + 2]))
+				return ++cursor;
 		}
-		assert(0);
+
+		if (animationTime < GetKeyTime(keys[1]))
+			return cursor = 0;
+		if (animationTime >= GetKeyTime(keys[lastPair]))
+			return cursor = lastPair;
+
+		auto next = std::upper_bound(keys.begin() + 1, keys.begin() + lastPair + 1, animationTime,
+			[](float time, const KeyType& key) { return time < GetKeyTime(key); });
+		cursor = static_cast<int>(next - keys.begin()) - 1;
+		return cursor;
 	}
 
 
 private:
 
-	float GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime)
-	{
-		float scaleFactor = 0.0f;
-		float midWayLength = animationTime - lastTimeStamp;
-		float framesDiff = nextTimeStamp - lastTimeStamp;
-		scaleFactor = midWayLength / framesDiff;
-		return scaleFactor;
-	}
-
-	glm::mat4 InterpolatePosition(float animationTime)
+	glm::mat4 InterpolatePosition(float animationTime, int& cursor) const
 	{
+		if (0 == m_NumPositions)
+			return glm::translate(glm::mat4(1.0f), IdentityKey(m_Positions).position);
 		if (1 == m_NumPositions)
 			return glm::translate(glm::mat4(1.0f), m_Positions[0].position);
 
-		int p0Index = GetPositionIndex(animationTime);
+		int p0Index = FindKeyIndex(m_Positions, animationTime, cursor);
 		int p1Index = p0Index + 1;
 		float scaleFactor = GetScaleFactor(m_Positions[p0Index].timeStamp,
 			m_Positions[p1Index].timeStamp, animationTime);
@@ -141,15 +218,17 @@ private:
 		return glm::translate(glm::mat4(1.0f), finalPosition);
 	}
 
-	glm::mat4 InterpolateRotation(float animationTime)
+	glm::mat4 InterpolateRotation(float animationTime, int& cursor) const
 	{
+		if (0 == m_NumRotations)
+			return glm::toMat4(IdentityKey(m_Rotations).orientation);
 		if (1 == m_NumRotations)
 		{
 			auto rotation = glm::normalize(m_Rotations[0].orientation);
 			return glm::toMat4(rotation);
 		}
 
-		int p0Index = GetRotationIndex(animationTime);
+		int p0Index = FindKeyIndex(m_Rotations, animationTime, cursor);
 		int p1Index = p0Index + 1;
 		float scaleFactor = GetScaleFactor(m_Rotations[p0Index].timeStamp,
 			m_Rotations[p1Index].timeStamp, animationTime);
@@ -160,12 +239,14 @@ private:
 
 	}
 
-	glm::mat4 InterpolateScaling(float animationTime)
+	glm::mat4 InterpolateScaling(float animationTime, int& cursor) const
 	{
+		if (0 == m_NumScalings)
+			return glm::scale(glm::mat4(1.0f), IdentityKey(m_Scales).scale);
 		if (1 == m_NumScalings)
 			return glm::scale(glm::mat4(1.0f), m_Scales[0].scale);
 
-		int p0Index = GetScaleIndex(animationTime);
+		int p0Index = FindKeyIndex(m_Scales, animationTime, cursor);
 		int p1Index = p0Index + 1;
 		float scaleFactor = GetScaleFactor(m_Scales[p0Index].timeStamp,
 			m_Scales[p1Index].timeStamp, animationTime);
@@ -181,7 +262,6 @@ private:
 	int m_NumRotations;
 	int m_NumScalings;
 
-	glm::mat4 m_LocalTransform;
 	std::string m_Name;
 	int m_ID;
 };
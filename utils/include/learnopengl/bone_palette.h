@@ -0,0 +1,91 @@
+#pragma once
+
+/* GPU storage for the final bone matrices of one character */
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstring>
+#include <vector>
+
+// texture units of the per-draw buffers, from the top down so they stay clear of the material units used by Mesh::Draw.
+// each has its own unit : a skinned, a baked and a batched draw can share a frame
+#define BONE_PALETTE_TEXTURE_UNIT 15
+// BakedAnimationAtlas
+#define BAKED_PALETTE_TEXTURE_UNIT 14
+// MeshBatch's instance transforms
+#define BATCH_TRANSFORM_TEXTURE_UNIT 13
+
+/*the matrices live in a texture buffer (4 RGBA32F texels per matrix) so the
+palette is sized to the real bone count instead of a fixed uniform array.
+the skinning shader reads it with texelFetch from a samplerBuffer*/
+class BonePalette
+{
+public:
+	BonePalette()
+		:
+		m_Buffer(0),
+		m_Texture(0),
+		m_Capacity(0)
+	{
+		glGenBuffers(1, &m_Buffer);
+		glGenTextures(1, &m_Texture);
+	}
+
+	~BonePalette()
+	{
+		glDeleteTextures(1, &m_Texture);
+		glDeleteBuffers(1, &m_Buffer);
+	}
+
+	BonePalette(const BonePalette&) = delete;
+	BonePalette& operator=(const BonePalette&) = delete;
+
+	// one buffer write : orphans the previous contents and copies the matrices into the mapped store
+	void Upload(const glm::mat4* matrices, int count)
+	{
+		if (count <= 0)
+			return;
+
+		glBindBuffer(GL_TEXTURE_BUFFER, m_Buffer);
+		GLsizeiptr size = count * sizeof(glm::mat4);
+		if (count > m_Capacity)
+		{
+			glBufferData(GL_TEXTURE_BUFFER, size, NULL, GL_STREAM_DRAW);
+			m_Capacity = count;
+
+			//the texture has to be re-attached once the data store changes size
+			glBindTexture(GL_TEXTURE_BUFFER, m_Texture);
+			glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_Buffer);
+			glBindTexture(GL_TEXTURE_BUFFER, 0);
+		}
+
+		void* dest = glMapBufferRange(GL_TEXTURE_BUFFER, 0, size,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (dest)
+		{
+			std::memcpy(dest, matrices, size);
+			glUnmapBuffer(GL_TEXTURE_BUFFER);
+		}
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	}
+
+	void Upload(const std::vector<glm::mat4>& matrices)
+	{
+		Upload(matrices.data(), (int)matrices.size());
+	}
+
+	// one bind : the shader's samplerBuffer has to be set to BONE_PALETTE_TEXTURE_UNIT once
+	void Bind() const
+	{
+		glActiveTexture(GL_TEXTURE0 + BONE_PALETTE_TEXTURE_UNIT);
+		glBindTexture(GL_TEXTURE_BUFFER, m_Texture);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	int GetCapacity() const { return m_Capacity; }
+
+private:
+	unsigned int m_Buffer;
+	unsigned int m_Texture;
+	int m_Capacity;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+/* Directories of files generated at run time (program binaries, transcoded textures), kept out of the sources */
+
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <dirent.h>
+#include <sys/stat.h>
+#else
+#include <direct.h>
+#include <io.h>
+#endif
+
+// creates directory (not its parents); true when it exists afterwards
+inline bool MakeCacheDirectory(const std::string& directory)
+{
+#ifndef _WIN32
+	struct stat info;
+	if (stat(directory.c_str(), &info) == 0)
+		return S_ISDIR(info.st_mode);
+	return mkdir(directory.c_str(), 0755) == 0;
+#else
+	struct _stat info;
+	if (_stat(directory.c_str(), &info) == 0)
+		return (info.st_mode & _S_IFDIR) != 0;
+	return _mkdir(directory.c_str()) == 0;
+#endif
+}
+
+// names (not paths) of the files in directory ending with suffix
+inline std::vector<std::string> ListCacheDirectory(const std::string& directory, const std::string& suffix)
+{
+	std::vector<std::string> names;
+	auto matches = [&suffix](const std::string& name)
+	{
+		return name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+	};
+#ifndef _WIN32
+	DIR* dir = opendir(directory.c_str());
+	if (!dir)
+		return names;
+	while (dirent* entry = readdir(dir))
+	{
+		if (matches(entry->d_name))
+			names.push_back(entry->d_name);
+	}
+	closedir(dir);
+#else
+	_finddata_t entry;
+	intptr_t handle = _findfirst((directory + "/*").c_str(), &entry);
+	if (handle == -1)
+		return names;
+	do
+	{
+		if (matches(entry.name))
+			names.push_back(entry.name);
+	} while (_findnext(handle, &entry) == 0);
+	_findclose(handle);
+#endif
+	return names;
+}
@@ -0,0 +1,413 @@
+#pragma once
+
+/* Compressed storage for the bone channels of one animation clip */
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <learnopengl/bone.h>
+
+struct ClipCompressionSettings
+{
+	/*rate of the uniform grid every channel is resampled to, in frames per second*/
+	float sampleRate = 30.0f;
+
+	/*largest position error allowed at any joint, in model units. it is split
+	over the channels of the longest animated chain through each joint, and
+	each channel's share over its translation, rotation and scale*/
+	float positionTolerance = 0.001f;
+
+	/*upper bound on the rotation error of any channel, in radians*/
+	float rotationTolerance = 0.002f;
+
+	/*upper bound on the error of a scale component*/
+	float scaleTolerance = 0.001f;
+
+	/*times the tolerances are halved and sampleRate doubled when the measured
+	joint error is still above positionTolerance : the per-channel bounds hold
+	on the grid frames, not for source keys between them*/
+	int maxRefinements = 4;
+
+	/*drop the full precision Bone keys once the clip is compressed. the bones
+	keep their first key of each track, so Bone::Sample still gives the first pose*/
+	bool discardSourceKeys = false;
+};
+
+struct ClipCompressionStats
+{
+	size_t sourceBytes = 0;
+	size_t compressedBytes = 0;
+	/*largest distance between a joint of the source and of the compressed clip,
+	on the grid frames, between them and at every source key*/
+	float maxJointError = 0.0f;
+	/*false when maxJointError stayed above positionTolerance after every refinement*/
+	bool withinTolerance = true;
+	/*how often the tolerances were halved and the grid rate doubled*/
+	int refinements = 0;
+};
+
+/*error allowed on each track of one channel : translation in the channel's
+local units, rotation in radians, scale per component*/
+struct ChannelTolerance
+{
+	float position;
+	float rotation;
+	float scale;
+};
+
+/*one channel component : keys sit on frames of the uniform grid. when every
+frame is kept, frames is empty and the key index is the frame index itself*/
+struct CompressedTrack
+{
+	std::vector<uint16_t> frames;
+	std::vector<uint16_t> values;	//3 per key
+	glm::vec3 rangeMin = glm::vec3(0.0f);
+	glm::vec3 rangeExtent = glm::vec3(1.0f);
+
+	int GetNumKeys() const { return (int)values.size() / 3; }
+
+	size_t GetBytes() const
+	{
+		return frames.size() * sizeof(uint16_t) + values.size() * sizeof(uint16_t) + 2 * sizeof(glm::vec3);
+	}
+
+	/*finds the key pair around framePosition and the blend factor between them.
+	cursor works like the one of Bone::FindKeyIndex*/
+	void FindKeys(float framePosition, int& cursor, int& key0, int& key1, float& factor) const
+	{
+		int numKeys = GetNumKeys();
+		if (numKeys < 2)
+		{
+			key0 = key1 = 0;
+			factor = 0.0f;
+			return;
+		}
+
+		int index;
+		float frame0, frame1;
+		if (frames.empty())
+		{
+			index = (int)framePosition;
+			if (index < 0) index = 0;
+			if (index > numKeys - 2) index = numKeys - 2;
+			frame0 = (float)index;
+			frame1 = (float)index + 1.0f;
+		}
+		else
+		{
+			index = Bone::FindKeyIndex(frames, framePosition, cursor);
+			frame0 = frames[index];
+			frame1 = frames[index + 1];
+		}
+
+		key0 = index;
+		key1 = index + 1;
+		factor = Bone::GetScaleFactor(frame0, frame1, framePosition);
+	}
+};
+
+/*all channels of a clip, in the same order as the Bone channels of its Animation*/
+class CompressedClip
+{
+public:
+	struct Channel
+	{
+		CompressedTrack position;
+		CompressedTrack rotation;
+		CompressedTrack scale;
+	};
+
+	CompressedClip() = default;
+
+	/*resamples every bone to the uniform grid, drops keys the neighbouring keys
+	reproduce within tolerance and quantizes the rest. the tolerances cover
+	both steps : keys are dropped only within what quantization leaves of them,
+	and a tolerance below the quantization error keeps every frame.
+	tolerances holds one entry per channel*/
+	CompressedClip(const std::vector<Bone>& bones, float duration, float ticksPerSecond,
+		float sampleRate, const std::vector<ChannelTolerance>& tolerances)
+	{
+		m_FramesPerTick = sampleRate / ticksPerSecond;
+		m_NumFrames = (int)std::ceil(duration * m_FramesPerTick) + 1;
+		if (m_NumFrames < 1) m_NumFrames = 1;
+		if (m_NumFrames > 65535) m_NumFrames = 65535;
+
+		std::vector<glm::vec3> positions(m_NumFrames), scales(m_NumFrames);
+		std::vector<glm::quat> rotations(m_NumFrames);
+
+		for (size_t c = 0; c < bones.size(); c++)
+		{
+			BoneCursor cursor;
+			for (int f = 0; f < m_NumFrames; f++)
+			{
+				float time = f / m_FramesPerTick;
+				SampleSource(bones[c], time, cursor, positions[f], rotations[f], scales[f]);
+			}
+
+			Channel channel;
+			channel.position = CompressVectors(positions, tolerances[c].position);
+			channel.rotation = CompressRotations(rotations, tolerances[c].rotation);
+			channel.scale = CompressVectors(scales, tolerances[c].scale);
+			m_Channels.push_back(channel);
+		}
+	}
+
+	int GetChannelCount() const { return (int)m_Channels.size(); }
+
+	size_t GetBytes() const
+	{
+		size_t bytes = 0;
+		for (const Channel& channel : m_Channels)
+			bytes += channel.position.GetBytes() + channel.rotation.GetBytes() + channel.scale.GetBytes();
+		return bytes;
+	}
+
+	/*decodes the keys around animationTime for one channel, for PoseSampler*/
+	void GatherKeys(int channel, float animationTime, BoneCursor& cursor,
+		glm::vec3& position0, glm::vec3& position1, float& positionFactor,
+		glm::quat& rotation0, glm::quat& rotation1, float& rotationFactor,
+		glm::vec3& scale0, glm::vec3& scale1, float& scaleFactor) const
+	{
+		const Channel& data = m_Channels[channel];
+		float framePosition = animationTime * m_FramesPerTick;
+		int key0, key1;
+
+		data.position.FindKeys(framePosition, cursor.position, key0, key1, positionFactor);
+		position0 = DecodeVector(data.position, key0);
+		position1 = DecodeVector(data.position, key1);
+
+		data.rotation.FindKeys(framePosition, cursor.rotation, key0, key1, rotationFactor);
+		rotation0 = DecodeRotation(data.rotation, key0);
+		rotation1 = DecodeRotation(data.rotation, key1);
+
+		data.scale.FindKeys(framePosition, cursor.scale, key0, key1, scaleFactor);
+		scale0 = DecodeVector(data.scale, key0);
+		scale1 = DecodeVector(data.scale, key1);
+	}
+
+	/*local transform of one channel, decoded the same way PoseSampler does it*/
+	glm::mat4 Sample(int channel, float animationTime, BoneCursor& cursor) const
+	{
+		glm::vec3 p0, p1, s0, s1;
+		glm::quat r0, r1;
+		float pf, rf, sf;
+		GatherKeys(channel, animationTime, cursor, p0, p1, pf, r0, r1, rf, s0, s1, sf);
+
+		if (glm::dot(r0, r1) < 0.0f)
+			r1 = -r1;
+		glm::quat rotation = glm::normalize(r0 + (r1 - r0) * rf);
+		return glm::translate(glm::mat4(1.0f), glm::mix(p0, p1, pf)) * glm::toMat4(rotation) *
+			glm::scale(glm::mat4(1.0f), glm::mix(s0, s1, sf));
+	}
+
+	static void SampleSource(const Bone& bone, float time, BoneCursor& cursor,
+		glm::vec3& position, glm::quat& rotation, glm::vec3& scale)
+	{
+		const std::vector<KeyPosition>& positions = bone.GetPositionKeys();
+		const std::vector<KeyRotation>& rotations = bone.GetRotationKeys();
+		const std::vector<KeyScale>& scales = bone.GetScaleKeys();
+
+		if (positions.size() < 2)
+			position = positions.empty() ? IdentityKey(positions).position : positions[0].position;
+		else
+		{
+			int i = Bone::FindKeyIndex(positions, time, cursor.position);
+			float t = Bone::GetScaleFactor(positions[i].timeStamp, positions[i + 1].timeStamp, time);
+			position = glm::mix(positions[i].position, positions[i + 1].position, t);
+		}
+
+		if (rotations.size() < 2)
+			rotation = glm::normalize(rotations.empty() ? IdentityKey(rotations).orientation : rotations[0].orientation);
+		else
+		{
+			int i = Bone::FindKeyIndex(rotations, time, cursor.rotation);
+			float t = Bone::GetScaleFactor(rotations[i].timeStamp, rotations[i + 1].timeStamp, time);
+			rotation = glm::normalize(glm::slerp(rotations[i].orientation, rotations[i + 1].orientation, t));
+		}
+
+		if (scales.size() < 2)
+			scale = scales.empty() ? IdentityKey(scales).scale : scales[0].scale;
+		else
+		{
+			int i = Bone::FindKeyIndex(scales, time, cursor.scale);
+			float t = Bone::GetScaleFactor(scales[i].timeStamp, scales[i + 1].timeStamp, time);
+			scale = glm::mix(scales[i].scale, scales[i + 1].scale, t);
+		}
+	}
+
+private:
+	/*greedy reduction : extends each segment while linear interpolation between
+	its end keys reproduces every skipped frame within tolerance*/
+	template<typename T, typename ErrorFunc, typename LerpFunc>
+	static std::vector<int> ReduceKeys(const std::vector<T>& values, float tolerance, ErrorFunc error, LerpFunc lerp)
+	{
+		int numFrames = (int)values.size();
+		std::vector<int> kept;
+		kept.push_back(0);
+
+		bool constant = true;
+		for (int f = 1; f < numFrames && constant; f++)
+			constant = error(values[0], values[f]) <= tolerance;
+		if (constant)
+			return kept;
+
+		int start = 0;
+		for (int end = 2; end < numFrames; end++)
+		{
+			bool fits = true;
+			for (int f = start + 1; f < end && fits; f++)
+			{
+				float t = float(f - start) / float(end - start);
+				fits = error(lerp(values[start], values[end], t), values[f]) <= tolerance;
+			}
+			if (!fits)
+			{
+				start = end - 1;
+				kept.push_back(start);
+			}
+		}
+		kept.push_back(numFrames - 1);
+		return kept;
+	}
+
+	static void SetFrames(CompressedTrack& track, const std::vector<int>& kept, int numFrames)
+	{
+		//a track that keeps every frame is indexed directly
+		if (kept.size() == 1 || (int)kept.size() == numFrames)
+			return;
+		for (int frame : kept)
+			track.frames.push_back((uint16_t)frame);
+	}
+
+	static CompressedTrack CompressVectors(const std::vector<glm::vec3>& values, float tolerance)
+	{
+		//16 bit quantization over the track's range moves a key by up to half a step per component,
+		//and so the interpolation between keys; the reduction gets what is left of the tolerance
+		glm::vec3 lowest = values[0], highest = values[0];
+		for (const glm::vec3& value : values)
+		{
+			lowest = glm::min(lowest, value);
+			highest = glm::max(highest, value);
+		}
+		float quantizationError = 0.5f * glm::length(highest - lowest) / 65535.0f;
+
+		CompressedTrack track;
+		std::vector<int> kept = ReduceKeys(values, std::max(tolerance - quantizationError, 0.0f),
+			[](const glm::vec3& a, const glm::vec3& b) { return glm::length(a - b); },
+			[](const glm::vec3& a, const glm::vec3& b, float t) { return glm::mix(a, b, t); });
+		SetFrames(track, kept, (int)values.size());
+
+		glm::vec3 minValue = values[kept[0]], maxValue = values[kept[0]];
+		for (int frame : kept)
+		{
+			minValue = glm::min(minValue, values[frame]);
+			maxValue = glm::max(maxValue, values[frame]);
+		}
+		track.rangeMin = minValue;
+		track.rangeExtent = maxValue - minValue;
+		for (int k = 0; k < 3; k++)
+		{
+			if (track.rangeExtent[k] <= 0.0f)
+				track.rangeExtent[k] = 1.0f;
+		}
+
+		for (int frame : kept)
+		{
+			glm::vec3 normalized = (values[frame] - track.rangeMin) / track.rangeExtent;
+			for (int k = 0; k < 3; k++)
+				track.values.push_back((uint16_t)std::lround(glm::clamp(normalized[k], 0.0f, 1.0f) * 65535.0f));
+		}
+		return track;
+	}
+
+	// angle between two rotations, through asin of the chord so it stays accurate for tiny angles
+	static float RotationError(const glm::quat& a, glm::quat b)
+	{
+		if (glm::dot(a, b) < 0.0f)
+			b = -b;
+		float chord = glm::length(a - b) * 0.5f;
+		return 4.0f * std::asin(chord > 1.0f ? 1.0f : chord);
+	}
+
+	static CompressedTrack CompressRotations(const std::vector<glm::quat>& values, float tolerance)
+	{
+		CompressedTrack track;
+		std::vector<int> kept = ReduceKeys(values, std::max(tolerance - ROTATION_QUANTIZATION_ERROR, 0.0f), RotationError,
+			[](const glm::quat& a, glm::quat b, float t)
+			{
+				if (glm::dot(a, b) < 0.0f)
+					b = -b;
+				return glm::normalize(a + (b - a) * t);
+			});
+		SetFrames(track, kept, (int)values.size());
+
+		for (int frame : kept)
+			EncodeRotation(values[frame], track.values);
+		return track;
+	}
+
+	/*largest angle EncodeRotation moves a rotation by : half a 15 bit step on
+	each stored component, sqrt(3) times that on the rebuilt one, twice the
+	quaternion distance as an angle*/
+	static constexpr float ROTATION_QUANTIZATION_ERROR = 1.5e-4f;
+
+	/*smallest three : the largest component is dropped (and rebuilt from the
+	unit length), the other three are stored in 15 bits each. the 2 bit index of
+	the dropped component goes in the top bits of the first two values*/
+	static void EncodeRotation(const glm::quat& q, std::vector<uint16_t>& out)
+	{
+		float c[4] = { q.x, q.y, q.z, q.w };
+		int largest = 0;
+		for (int i = 1; i < 4; i++)
+		{
+			if (std::fabs(c[i]) > std::fabs(c[largest]))
+				largest = i;
+		}
+		float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+
+		uint16_t packed[3];
+		for (int i = 0, j = 0; i < 4; i++)
+		{
+			if (i == largest)
+				continue;
+			float normalized = c[i] * sign * 0.70710678f + 0.5f;
+			packed[j++] = (uint16_t)std::lround(glm::clamp(normalized, 0.0f, 1.0f) * 32767.0f);
+		}
+		out.push_back(packed[0] | (uint16_t)((largest & 1) << 15));
+		out.push_back(packed[1] | (uint16_t)((largest >> 1) << 15));
+		out.push_back(packed[2]);
+	}
+
+	static glm::quat DecodeRotation(const CompressedTrack& track, int key)
+	{
+		const uint16_t* packed = &track.values[key * 3];
+		int largest = (packed[0] >> 15) | ((packed[1] >> 15) << 1);
+
+		float c[4];
+		float sum = 0.0f;
+		for (int i = 0, j = 0; i < 4; i++)
+		{
+			if (i == largest)
+				continue;
+			float normalized = (packed[j++] & 0x7fff) / 32767.0f;
+			c[i] = (normalized - 0.5f) * 1.41421356f;
+			sum += c[i] * c[i];
+		}
+		c[largest] = std::sqrt(sum < 1.0f ? 1.0f - sum : 0.0f);
+		return glm::quat(c[3], c[0], c[1], c[2]);
+	}
+
+	static glm::vec3 DecodeVector(const CompressedTrack& track, int key)
+	{
+		const uint16_t* packed = &track.values[key * 3];
+		return track.rangeMin + glm::vec3(packed[0], packed[1], packed[2]) / 65535.0f * track.rangeExtent;
+	}
+
+	std::vector<Channel> m_Channels;
+	float m_FramesPerTick = 1.0f;
+	int m_NumFrames = 0;
+};
@@ -0,0 +1,507 @@
+#pragma once
+
+/* Block compressed textures (BC1/BC3/BC4) with their mip chain, cached as KTX files */
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+
+// S3TC is an extension to GL 3.3, loaders generated for the core profile may not name it
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// blocks of every mip level, level 0 first
+struct CompressedImage
+{
+	GLenum internalFormat = 0;
+	GLenum baseFormat = 0;
+	int width = 0, height = 0;
+	std::vector<std::vector<unsigned char>> levels;
+
+	bool Empty() const { return levels.empty(); }
+
+	size_t GetBytes() const
+	{
+		size_t bytes = 0;
+		for (const auto& level : levels)
+			bytes += level.size();
+		return bytes;
+	}
+};
+
+/*picks the format from the image : BC4 for single channel images, BC3 when
+some pixel is not opaque and BC1 otherwise. normal maps get BC1 like any
+color image, so they keep z : no shader here rebuilds it from a two channel
+(BC5) map.
+
+mips are box filtered on the CPU down to 1x1 and every level is compressed
+on its own. blocks over the image border repeat the last row and column.
+
+the encoder fits each block's endpoints to the principal axis of its colors
+(BC1) or to the value range (BC4), then gives every pixel the closest
+palette entry : fast enough to run on first load, not tuned for quality.*/
+class TextureCompressor
+{
+public:
+	// pixels as decoded by stb_image, 1 to 4 components
+	static CompressedImage Compress(const unsigned char* pixels, int width, int height, int nrComponents)
+	{
+		CompressedImage image;
+		image.width = width;
+		image.height = height;
+
+		std::vector<unsigned char> rgba((size_t)width * height * 4);
+		bool opaque = true;
+		for (size_t i = 0; i < (size_t)width * height; i++)
+		{
+			const unsigned char* p = pixels + i * nrComponents;
+			unsigned char* q = &rgba[i * 4];
+			if (nrComponents < 3)
+			{
+				q[0] = q[1] = q[2] = p[0];
+				q[3] = nrComponents == 2 ? p[1] : 255;
+			}
+			else
+			{
+				q[0] = p[0];
+				q[1] = p[1];
+				q[2] = p[2];
+				q[3] = nrComponents == 4 ? p[3] : 255;
+			}
+			opaque = opaque && q[3] == 255;
+		}
+
+		if (nrComponents == 1)
+		{
+			image.internalFormat = GL_COMPRESSED_RED_RGTC1;
+			image.baseFormat = GL_RED;
+		}
+		else if (!opaque)
+		{
+			image.internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+			image.baseFormat = GL_RGBA;
+		}
+		else
+		{
+			image.internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+			image.baseFormat = GL_RGB;
+		}
+
+		while (true)
+		{
+			image.levels.push_back(CompressLevel(rgba.data(), width, height, image.internalFormat));
+			if (width == 1 && height == 1)
+				break;
+			rgba = Downsample(rgba.data(), width, height);
+			width = std::max(width / 2, 1);
+			height = std::max(height / 2, 1);
+		}
+		return image;
+	}
+
+	// GL thread. creates the texture with every level of image
+	static unsigned int Upload(const CompressedImage& image)
+	{
+		unsigned int textureID;
+		glGenTextures(1, &textureID);
+		glBindTexture(GL_TEXTURE_2D, textureID);
+
+		int width = image.width, height = image.height;
+		for (size_t level = 0; level < image.levels.size(); level++)
+		{
+			glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, image.internalFormat, width, height, 0,
+				(GLsizei)image.levels[level].size(), image.levels[level].data());
+			width = std::max(width / 2, 1);
+			height = std::max(height / 2, 1);
+		}
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		return textureID;
+	}
+
+	// GL thread. S3TC (BC1, BC3) needs the extension, RGTC (BC4) GL 3.0 or its ARB extension
+	static bool IsSupported()
+	{
+		bool s3tc = false;
+		bool rgtc = GLAD_GL_VERSION_3_0 != 0;
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; i++)
+		{
+			const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+			if (!name)
+				continue;
+			s3tc = s3tc || std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0;
+			rgtc = rgtc || std::strcmp(name, "GL_ARB_texture_compression_rgtc") == 0;
+		}
+		return s3tc && rgtc;
+	}
+
+	// size and modification time of a source image, 0 when it cannot be read
+	static uint64_t SourceStamp(const std::string& path)
+	{
+		struct stat info;
+		if (stat(path.c_str(), &info) != 0)
+			return 0;
+		return ((uint64_t)info.st_mtime << 32) ^ (uint64_t)info.st_size;
+	}
+
+	// reads a KTX file written by WriteKtx for a source with this stamp
+	static bool ReadKtx(const std::string& path, uint64_t sourceStamp, CompressedImage& image)
+	{
+		std::ifstream in(path, std::ios::binary);
+		if (!in)
+			return false;
+
+		unsigned char identifier[12];
+		uint32_t header[13];
+		in.read((char*)identifier, sizeof(identifier));
+		in.read((char*)header, sizeof(header));
+		if (!in || std::memcmp(identifier, KtxIdentifier(), 12) != 0 || header[0] != 0x04030201)
+			return false;
+
+		image.internalFormat = header[4];
+		image.baseFormat = header[5];
+		image.width = (int)header[6];
+		image.height = (int)header[7];
+		uint32_t numLevels = header[11];
+		if (BlockBytes(image.internalFormat) == 0 || header[10] != 1 || numLevels == 0 || numLevels > 32 ||
+			image.width <= 0 || image.height <= 0 || header[12] != KeyValueBytes())
+			return false;
+
+		std::vector<char> keyValue(header[12]);
+		in.read(keyValue.data(), keyValue.size());
+		uint64_t stamp = 0;
+		std::memcpy(&stamp, &keyValue[4 + StampKeyBytes()], sizeof(stamp));
+		if (!in || std::memcmp(&keyValue[4], StampKey(), StampKeyBytes()) != 0 || stamp != sourceStamp)
+			return false;
+
+		int width = image.width, height = image.height;
+		image.levels.resize(numLevels);
+		for (uint32_t level = 0; level < numLevels; level++)
+		{
+			uint32_t size = 0;
+			in.read((char*)&size, sizeof(size));
+			if (!in || size != LevelBytes(width, height, image.internalFormat))
+				return false;
+			image.levels[level].resize(size);
+			in.read((char*)image.levels[level].data(), size);
+			width = std::max(width / 2, 1);
+			height = std::max(height / 2, 1);
+		}
+		return (bool)in;
+	}
+
+	// writes a KTX 1.1 file, through a temporary file so a reader never sees half of it
+	static bool WriteKtx(const std::string& path, uint64_t sourceStamp, const CompressedImage& image)
+	{
+		// per thread, two loads may cook the same file at once
+		std::string tmpPath = path + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+		{
+			std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+			if (!out)
+				return false;
+
+			uint32_t header[13] = { 0x04030201, 0, 1, 0, image.internalFormat, image.baseFormat,
+				(uint32_t)image.width, (uint32_t)image.height, 0, 0, 1, (uint32_t)image.levels.size(), KeyValueBytes() };
+			out.write((const char*)KtxIdentifier(), 12);
+			out.write((const char*)header, sizeof(header));
+
+			uint32_t keyAndValueBytes = StampKeyBytes() + sizeof(sourceStamp);
+			out.write((const char*)&keyAndValueBytes, sizeof(keyAndValueBytes));
+			out.write(StampKey(), StampKeyBytes());
+			out.write((const char*)&sourceStamp, sizeof(sourceStamp));
+			static const char padding[4] = {};
+			out.write(padding, KeyValueBytes() - 4 - keyAndValueBytes);
+
+			for (const auto& level : image.levels)
+			{
+				uint32_t size = (uint32_t)level.size();
+				out.write((const char*)&size, sizeof(size));
+				out.write((const char*)level.data(), size);
+			}
+			if (!out)
+				return false;
+		}
+		return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+	}
+
+	// bytes of one level
+	static size_t LevelBytes(int width, int height, GLenum internalFormat)
+	{
+		return (size_t)((width + 3) / 4) * ((height + 3) / 4) * BlockBytes(internalFormat);
+	}
+
+private:
+	// key of the source stamp in the KTX key/value data, with its terminating zero
+	static const char* StampKey() { return "LOGL.sourceStamp"; }
+	static uint32_t StampKeyBytes() { return (uint32_t)std::strlen(StampKey()) + 1; }
+
+	static const unsigned char* KtxIdentifier()
+	{
+		static const unsigned char identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+		return identifier;
+	}
+
+	// the stamp key/value pair, padded to 4 bytes
+	static uint32_t KeyValueBytes()
+	{
+		return (4 + StampKeyBytes() + sizeof(uint64_t) + 3) / 4 * 4;
+	}
+
+	static size_t BlockBytes(GLenum internalFormat)
+	{
+		switch (internalFormat)
+		{
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RED_RGTC1:
+			return 8;
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+			return 16;
+		}
+		return 0;
+	}
+
+	static std::vector<unsigned char> CompressLevel(const unsigned char* rgba, int width, int height, GLenum internalFormat)
+	{
+		std::vector<unsigned char> blocks(LevelBytes(width, height, internalFormat));
+		unsigned char* out = blocks.data();
+		unsigned char block[16][4];
+		unsigned char channel[16];
+
+		for (int by = 0; by < height; by += 4)
+		{
+			for (int bx = 0; bx < width; bx += 4)
+			{
+				for (int i = 0; i < 16; i++)
+				{
+					int x = std::min(bx + i % 4, width - 1);
+					int y = std::min(by + i / 4, height - 1);
+					std::memcpy(block[i], rgba + ((size_t)y * width + x) * 4, 4);
+				}
+
+				switch (internalFormat)
+				{
+				case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+					EncodeBC1(block, out);
+					out += 8;
+					break;
+				case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+					EncodeBC4(Channel(block, 3, channel), out);
+					EncodeBC1(block, out + 8);
+					out += 16;
+					break;
+				case GL_COMPRESSED_RED_RGTC1:
+					EncodeBC4(Channel(block, 0, channel), out);
+					out += 8;
+					break;
+				}
+			}
+		}
+		return blocks;
+	}
+
+	static const unsigned char* Channel(const unsigned char block[16][4], int c, unsigned char* channel)
+	{
+		for (int i = 0; i < 16; i++)
+			channel[i] = block[i][c];
+		return channel;
+	}
+
+	static std::vector<unsigned char> Downsample(const unsigned char* rgba, int width, int height)
+	{
+		int w = std::max(width / 2, 1), h = std::max(height / 2, 1);
+		std::vector<unsigned char> result((size_t)w * h * 4);
+		for (int y = 0; y < h; y++)
+		{
+			int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+			for (int x = 0; x < w; x++)
+			{
+				int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+				for (int c = 0; c < 4; c++)
+				{
+					int sum = rgba[((size_t)y0 * width + x0) * 4 + c] + rgba[((size_t)y0 * width + x1) * 4 + c] +
+						rgba[((size_t)y1 * width + x0) * 4 + c] + rgba[((size_t)y1 * width + x1) * 4 + c];
+					result[((size_t)y * w + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+		return result;
+	}
+
+	static uint16_t To565(const float* c)
+	{
+		int r = (int)(std::min(std::max(c[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+		int g = (int)(std::min(std::max(c[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+		int b = (int)(std::min(std::max(c[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	static void From565(uint16_t color, int* c)
+	{
+		int r = color >> 11, g = (color >> 5) & 63, b = color & 31;
+		c[0] = (r << 3) | (r >> 2);
+		c[1] = (g << 2) | (g >> 4);
+		c[2] = (b << 3) | (b >> 2);
+	}
+
+	// 4 color block : endpoints on the principal axis of the block's colors, inset by 1/16 of their range
+	static void EncodeBC1(const unsigned char block[16][4], unsigned char* out)
+	{
+		float mean[3] = { 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 3; c++)
+				mean[c] += block[i][c] / 16.0f;
+		}
+
+		float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 16; i++)
+		{
+			float d[3] = { block[i][0] - mean[0], block[i][1] - mean[1], block[i][2] - mean[2] };
+			cov[0] += d[0] * d[0];
+			cov[1] += d[0] * d[1];
+			cov[2] += d[0] * d[2];
+			cov[3] += d[1] * d[1];
+			cov[4] += d[1] * d[2];
+			cov[5] += d[2] * d[2];
+		}
+
+		// power iteration, from the diagonal of the covariance so gray ramps converge at once
+		float axis[3] = { cov[0], cov[3], cov[5] };
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[3] = {
+				cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+				cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+				cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2] };
+			float length = std::max(std::max(std::fabs(next[0]), std::fabs(next[1])), std::fabs(next[2]));
+			if (length < 1e-6f)
+				break;
+			for (int c = 0; c < 3; c++)
+				axis[c] = next[c] / length;
+		}
+		float length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+		if (length < 1e-6f)
+		{
+			axis[0] = axis[1] = axis[2] = 0.57735f;
+			length = 1.0f;
+		}
+		for (int c = 0; c < 3; c++)
+			axis[c] /= length;
+
+		float minT = 1e30f, maxT = -1e30f;
+		for (int i = 0; i < 16; i++)
+		{
+			float t = (block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2];
+			minT = std::min(minT, t);
+			maxT = std::max(maxT, t);
+		}
+		float inset = (maxT - minT) / 16.0f;
+		minT += inset;
+		maxT -= inset;
+
+		float e0[3], e1[3];
+		for (int c = 0; c < 3; c++)
+		{
+			e0[c] = mean[c] + axis[c] * maxT;
+			e1[c] = mean[c] + axis[c] * minT;
+		}
+		uint16_t color0 = To565(e0), color1 = To565(e1);
+		if (color0 < color1)
+			std::swap(color0, color1);
+
+		uint32_t indices = 0;
+		if (color0 != color1)
+		{
+			int palette[4][3];
+			From565(color0, palette[0]);
+			From565(color1, palette[1]);
+			for (int c = 0; c < 3; c++)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			for (int i = 0; i < 16; i++)
+				indices |= (uint32_t)Closest(block[i], palette, 4) << (2 * i);
+		}
+
+		out[0] = color0 & 0xFF;
+		out[1] = color0 >> 8;
+		out[2] = color1 & 0xFF;
+		out[3] = color1 >> 8;
+		for (int b = 0; b < 4; b++)
+			out[4 + b] = (indices >> (8 * b)) & 0xFF;
+	}
+
+	static int Closest(const unsigned char* color, const int palette[][3], int count)
+	{
+		int best = 0, bestError = INT32_MAX;
+		for (int p = 0; p < count; p++)
+		{
+			int dr = color[0] - palette[p][0], dg = color[1] - palette[p][1], db = color[2] - palette[p][2];
+			int error = dr * dr + dg * dg + db * db;
+			if (error < bestError)
+			{
+				bestError = error;
+				best = p;
+			}
+		}
+		return best;
+	}
+
+	// 8 value block between the smallest and the largest value
+	static void EncodeBC4(const unsigned char* values, unsigned char* out)
+	{
+		int lo = 255, hi = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			lo = std::min(lo, (int)values[i]);
+			hi = std::max(hi, (int)values[i]);
+		}
+
+		out[0] = (unsigned char)hi;
+		out[1] = (unsigned char)lo;
+		uint64_t indices = 0;
+		if (hi != lo)
+		{
+			int palette[8] = { hi, lo };
+			for (int p = 2; p < 8; p++)
+				palette[p] = ((8 - p) * hi + (p - 1) * lo) / 7;
+			for (int i = 0; i < 16; i++)
+			{
+				int best = 0, bestError = 256;
+				for (int p = 0; p < 8; p++)
+				{
+					int error = std::abs(values[i] - palette[p]);
+					if (error < bestError)
+					{
+						bestError = error;
+						best = p;
+					}
+				}
+				indices |= (uint64_t)best << (3 * i);
+			}
+		}
+		for (int b = 0; b < 6; b++)
+			out[2 + b] = (indices >> (8 * b)) & 0xFF;
+	}
+};
@@ -0,0 +1,286 @@
+#pragma once
+
+/* Skins meshes on the CPU with SIMD kernels spread over worker threads */
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include <atomic>
+#include <learnopengl/mesh.h>
+#include <learnopengl/pose_soa.h>
+#include <learnopengl/worker_pool.h>
+
+// deformed vertex as streamed to the GPU and read back by picking/collision code
+struct SkinnedVertex
+{
+	glm::vec3 Position;
+	glm::vec3 Normal;
+	glm::vec2 TexCoords;
+};
+
+/*bind pose of one Mesh in structure-of-arrays form plus the dynamic VBO its
+skinned vertices are streamed into. the skinning kernel works on
+POSE_SIMD_WIDTH vertices at a time and gathers the palette entries of each
+influence, so every array is padded to POSE_PADDING vertices.
+
+bone ids are turned into float offsets into a private copy of the palette
+at load time. ids of -1 get weight 0. vertices without any influence or
+with an id beyond the palette stay in the bind pose like in skel_anim.vs :
+they are bound to an extra identity matrix at the end of the palette copy.
+
+the mesh has to keep its vertices and indices on the CPU : baked meshes
+loaded without keepVertexData can't be skinned here (see CanSkin) and stay
+on the GPU path.*/
+class SkinnedMesh
+{
+public:
+	SkinnedMesh(const Mesh& mesh, int numBones)
+		:
+		m_NumBones(numBones),
+		m_NumVertices((int)mesh.vertices.size()),
+		m_NumIndices((int)mesh.lods[0].indexCount)
+	{
+		assert(CanSkin(mesh));
+		int padded = (m_NumVertices + POSE_PADDING - 1) / POSE_PADDING * POSE_PADDING;
+		m_Px.assign(padded, 0.0f); m_Py.assign(padded, 0.0f); m_Pz.assign(padded, 0.0f);
+		m_Nx.assign(padded, 0.0f); m_Ny.assign(padded, 0.0f); m_Nz.assign(padded, 0.0f);
+		for (int k = 0; k < MAX_BONE_INFLUENCE; k++)
+		{
+			m_Offsets[k].assign(padded, 0);
+			m_Weights[k].assign(padded, 0.0f);
+		}
+		glm::mat4 identity(1.0f);
+		m_Palette.assign((size_t)(numBones + 1) * 16, 0.0f);
+		std::memcpy(&m_Palette[(size_t)numBones * 16], &identity[0][0], 16 * sizeof(float));
+
+		m_Skinned.resize(m_NumVertices);
+		for (int v = 0; v < m_NumVertices; v++)
+		{
+			const Vertex& vertex = mesh.vertices[v];
+			m_Px[v] = vertex.Position.x; m_Py[v] = vertex.Position.y; m_Pz[v] = vertex.Position.z;
+			m_Nx[v] = vertex.Normal.x; m_Ny[v] = vertex.Normal.y; m_Nz[v] = vertex.Normal.z;
+			m_Skinned[v].Position = vertex.Position;
+			m_Skinned[v].Normal = vertex.Normal;
+			m_Skinned[v].TexCoords = vertex.TexCoords;
+
+			bool rigid = true;
+			for (int k = 0; k < MAX_BONE_INFLUENCE; k++)
+			{
+				if (vertex.m_BoneIDs[k] == -1)
+					continue;
+				if (vertex.m_BoneIDs[k] >= numBones)
+				{
+					rigid = true;
+					break;
+				}
+				m_Offsets[k][v] = vertex.m_BoneIDs[k] * 16;
+				m_Weights[k][v] = vertex.m_Weights[k];
+				rigid = false;
+			}
+			if (rigid)
+			{
+				for (int k = 0; k < MAX_BONE_INFLUENCE; k++)
+				{
+					m_Offsets[k][v] = numBones * 16;
+					m_Weights[k][v] = k == 0 ? 1.0f : 0.0f;
+				}
+			}
+		}
+
+		SetupBuffers(mesh);
+	}
+
+	// false for meshes whose vertex data only lives in GPU buffers
+	static bool CanSkin(const Mesh& mesh)
+	{
+		return !mesh.vertices.empty() && !mesh.indices.empty();
+	}
+
+	~SkinnedMesh()
+	{
+		glDeleteVertexArrays(1, &m_VAO);
+		glDeleteBuffers(1, &m_VBO);
+		glDeleteBuffers(1, &m_EBO);
+	}
+
+	SkinnedMesh(const SkinnedMesh&) = delete;
+	SkinnedMesh& operator=(const SkinnedMesh&) = delete;
+
+	// copies the palette the next Skin call reads
+	void SetPalette(const glm::mat4* palette)
+	{
+		std::memcpy(m_Palette.data(), palette, (size_t)m_NumBones * sizeof(glm::mat4));
+	}
+
+	// skins vertices [begin, end) : begin must be a multiple of POSE_PADDING
+	void Skin(int begin, int end)
+	{
+		const float* palette = m_Palette.data();
+		alignas(32) float out[6][POSE_SIMD_WIDTH];
+
+		for (int i = begin; i < end; i += POSE_SIMD_WIDTH)
+		{
+			//blend the top three rows of the influencing matrices
+			PoseVec m[12];
+			for (int c = 0; c < 12; c++)
+				m[c] = PoseSet1(0.0f);
+			for (int k = 0; k < MAX_BONE_INFLUENCE; k++)
+			{
+				PoseVec w = PoseLoad(&m_Weights[k][i]);
+				const int* offset = &m_Offsets[k][i];
+				for (int col = 0; col < 4; col++)
+				{
+					for (int row = 0; row < 3; row++)
+						m[col * 3 + row] = PoseAdd(m[col * 3 + row], PoseMul(w, PoseGather(palette + col * 4 + row, offset)));
+				}
+			}
+
+			PoseVec x = PoseLoad(&m_Px[i]), y = PoseLoad(&m_Py[i]), z = PoseLoad(&m_Pz[i]);
+			PoseVec vnx = PoseLoad(&m_Nx[i]), vny = PoseLoad(&m_Ny[i]), vnz = PoseLoad(&m_Nz[i]);
+			for (int row = 0; row < 3; row++)
+			{
+				PoseVec p = PoseAdd(PoseAdd(PoseMul(m[row], x), PoseMul(m[3 + row], y)),
+					PoseAdd(PoseMul(m[6 + row], z), m[9 + row]));
+				PoseVec n = PoseAdd(PoseAdd(PoseMul(m[row], vnx), PoseMul(m[3 + row], vny)), PoseMul(m[6 + row], vnz));
+				PoseStore(out[row], p);
+				PoseStore(out[3 + row], n);
+			}
+
+			int lanes = std::min(POSE_SIMD_WIDTH, m_NumVertices - i);
+			for (int l = 0; l < lanes; l++)
+			{
+				SkinnedVertex& vertex = m_Skinned[i + l];
+				vertex.Position = glm::vec3(out[0][l], out[1][l], out[2][l]);
+				glm::vec3 normal(out[3][l], out[4][l], out[5][l]);
+				float length = glm::length(normal);
+				vertex.Normal = length > 0.0f ? normal / length : normal;
+			}
+		}
+	}
+
+	// one buffer write of every skinned vertex
+	void Upload()
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+		GLsizeiptr size = m_NumVertices * sizeof(SkinnedVertex);
+		void* dest = glMapBufferRange(GL_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (dest)
+		{
+			std::memcpy(dest, m_Skinned.data(), size);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// draws the skinned vertices with the textures of mesh : position, normal and texcoords at locations 0-2
+	void Draw(Mesh& mesh, Shader& shader)
+	{
+		mesh.bindTextures(shader);
+		glBindVertexArray(m_VAO);
+		glDrawElements(GL_TRIANGLES, m_NumIndices, GL_UNSIGNED_INT, 0);
+		glBindVertexArray(0);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	int GetVertexCount() const { return m_NumVertices; }
+	const std::vector<SkinnedVertex>& GetVertices() const { return m_Skinned; }
+
+private:
+	void SetupBuffers(const Mesh& mesh)
+	{
+		glGenVertexArrays(1, &m_VAO);
+		glGenBuffers(1, &m_VBO);
+		glGenBuffers(1, &m_EBO);
+
+		glBindVertexArray(m_VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+		glBufferData(GL_ARRAY_BUFFER, m_NumVertices * sizeof(SkinnedVertex), m_Skinned.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_NumIndices * sizeof(unsigned int), mesh.indices.data() + mesh.lods[0].indexOffset, GL_STATIC_DRAW);
+
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (void*)offsetof(SkinnedVertex, Position));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (void*)offsetof(SkinnedVertex, Normal));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (void*)offsetof(SkinnedVertex, TexCoords));
+		glBindVertexArray(0);
+	}
+
+	int m_NumBones;
+	int m_NumVertices;
+	int m_NumIndices;
+
+	PoseFloats m_Px, m_Py, m_Pz;
+	PoseFloats m_Nx, m_Ny, m_Nz;
+	PoseInts m_Offsets[MAX_BONE_INFLUENCE];	//float offset of each influence's matrix in m_Palette
+	PoseFloats m_Weights[MAX_BONE_INFLUENCE];
+	PoseFloats m_Palette;	//numBones matrices plus the identity
+
+	std::vector<SkinnedVertex> m_Skinned;
+	unsigned int m_VAO, m_VBO, m_EBO;
+};
+
+/*runs SkinnedMesh::Skin over chunks of vertices on a set of worker threads.
+every vertex costs the same, so the chunks are simply handed out through an
+atomic counter. the calling thread takes part and Skin returns once every
+vertex is written.*/
+class CpuSkinningEngine
+{
+public:
+	// numThreads = 0 uses every hardware thread. chunkSize is rounded up to POSE_PADDING
+	CpuSkinningEngine(unsigned int numThreads = 0, int chunkSize = 1024)
+		:
+		m_ChunkSize((std::max(chunkSize, 1) + POSE_PADDING - 1) / POSE_PADDING * POSE_PADDING),
+		m_Mesh(NULL),
+		m_NumChunks(0),
+		m_NextChunk(0),
+		m_LastSeconds(0.0),
+		m_Pool(WorkerPool::ThreadCount(numThreads) - 1)
+	{
+	}
+
+	CpuSkinningEngine(const CpuSkinningEngine&) = delete;
+	CpuSkinningEngine& operator=(const CpuSkinningEngine&) = delete;
+
+	// skins mesh with palette (the numBones matrices the mesh was made for) and blocks until done
+	void Skin(SkinnedMesh& mesh, const glm::mat4* palette)
+	{
+		auto start = std::chrono::steady_clock::now();
+		mesh.SetPalette(palette);
+
+		m_Mesh = &mesh;
+		m_NumChunks = (mesh.GetVertexCount() + m_ChunkSize - 1) / m_ChunkSize;
+		m_NextChunk = 0;
+		m_Pool.Run([this](int) { RunChunks(); });
+		m_LastSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	int GetThreadCount() const { return m_Pool.GetWorkerCount() + 1; }
+	// wall time of the last Skin call, for throughput counters
+	double GetLastSkinSeconds() const { return m_LastSeconds; }
+
+private:
+	void RunChunks()
+	{
+		int chunk;
+		while ((chunk = m_NextChunk.fetch_add(1)) < m_NumChunks)
+		{
+			int begin = chunk * m_ChunkSize;
+			m_Mesh->Skin(begin, std::min(begin + m_ChunkSize, m_Mesh->GetVertexCount()));
+		}
+	}
+
+	int m_ChunkSize;
+	SkinnedMesh* m_Mesh;
+	int m_NumChunks;
+	std::atomic<int> m_NextChunk;
+	double m_LastSeconds;
+	WorkerPool m_Pool;	//last, so its workers stop before the members they use go
+};
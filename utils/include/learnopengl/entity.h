@@ -342,6 +342,23 @@ Frustum createFrustumFromCamera(const Camera& cam, float aspect, float fovY, flo
 	return frustum;
 }
 
+//What the level of detail selection needs from the camera
+struct LodView
+{
+	glm::vec3 position = { 0.f, 0.f, 0.f };
+	float pixelsPerRadian = 1.f; //Screen size of one radian near the view axis
+	float maxErrorPixels = 1.f; //Largest simplification error allowed on screen
+};
+
+LodView createLodViewFromCamera(const Camera& cam, float viewportHeight, float fovY, float maxErrorPixels = 1.f)
+{
+	LodView view;
+	view.position = cam.Position;
+	view.pixelsPerRadian = viewportHeight * 0.5f / tanf(fovY * .5f);
+	view.maxErrorPixels = maxErrorPixels;
+	return view;
+}
+
 AABB generateAABB(const Model& model)
 {
 	glm::vec3 minAABB = glm::vec3(std::numeric_limits<float>::max());
@@ -481,5 +498,35 @@ public:
 			child->drawSelfAndChild(frustum, ourShader, display, total);
 		}
 	}
+
+	//Same, each mesh at the coarsest level of detail whose error projects under view.maxErrorPixels. Counts the triangles drawn
+	void drawSelfAndChild(const Frustum& frustum, const LodView& view, Shader& ourShader, unsigned int& display, unsigned int& total, size_t& triangles)
+	{
+		if (boundingVolume->isOnFrustum(frustum, transform))
+		{
+			//Screen size of the global AABB over its size in model space gives the pixels of one model unit
+			const AABB globalAABB = getGlobalAABB();
+			const float globalRadius = glm::length(globalAABB.extents);
+			const float localRadius = glm::length(boundingVolume->extents);
+			const float distance = glm::length(globalAABB.center - view.position);
+
+			float maxError = 0.f; //Full detail when the camera is inside the box
+			if (distance > globalRadius && localRadius > 0.f)
+			{
+				const float projectedPixels = globalRadius / distance * view.pixelsPerRadian;
+				maxError = view.maxErrorPixels * localRadius / projectedPixels;
+			}
+
+			ourShader.setMat4("model", transform.getModelMatrix());
+			triangles += pModel->DrawLod(ourShader, maxError);
+			display++;
+		}
+		total++;
+
+		for (auto&& child : children)
+		{
+			child->drawSelfAndChild(frustum, view, ourShader, display, total, triangles);
+		}
+	}
 };
 #endif
@@ -0,0 +1,277 @@
+#pragma once
+
+/* The camera, lights and time of a frame, written once into a uniform buffer every program reads */
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstring>
+
+/*the blocks as the shaders declare them (std140, so every member below is
+padded to a vec4 and the C++ structs match byte for byte):
+
+layout (std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+};
+
+struct Light
+{
+    vec4 position;      // w 0: directional light along xyz, 1: point light at xyz
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+    vec4 attenuation;   // constant, linear, quadratic
+};
+layout (std140) uniform Lights
+{
+    Light lights[8];
+    int lightCount;
+};
+
+layout (std140) uniform Frame
+{
+    float time;
+    float deltaTime;
+    int frame;
+};
+
+a program only declares the blocks it reads; Shader attaches the ones in
+FrameUniforms::Blocks() to their binding points when it links.*/
+
+// binding points of the uniform blocks every program shares
+enum FrameBlockBinding
+{
+	CAMERA_BLOCK_BINDING = 0,
+	LIGHTS_BLOCK_BINDING = 1,
+	FRAME_BLOCK_BINDING = 2,
+	FRAME_BLOCK_COUNT
+};
+
+// a block as the shaders name it, and the binding point FrameUniforms feeds
+struct FrameBlockInfo
+{
+	const char* name;
+	FrameBlockBinding binding;
+};
+
+struct CameraBlock
+{
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::vec4 viewPos;
+};
+
+struct BlockLight
+{
+	glm::vec4 position;
+	glm::vec4 ambient;
+	glm::vec4 diffuse;
+	glm::vec4 specular;
+	glm::vec4 attenuation;
+};
+
+struct LightsBlock
+{
+	static const int MAX_LIGHTS = 8;
+
+	BlockLight lights[MAX_LIGHTS];
+	int lightCount;
+	int padding[3];
+};
+
+struct TimeBlock
+{
+	float time;
+	float deltaTime;
+	int frame;
+	int padding;
+};
+
+/*one uniform buffer holding the three blocks, each bound to its binding
+point with glBindBufferRange. the setters only change the copy kept here;
+Upload writes all of it through one mapping of the buffer, orphaned so the
+driver never waits on the frames still reading the previous contents. that
+replaces setting projection, view and the lights on every program: they
+cost the same however many programs read them.*/
+class FrameUniforms
+{
+public:
+	FrameUniforms()
+	{
+		std::memset(&m_Camera, 0, sizeof(m_Camera));
+		std::memset(&m_Lights, 0, sizeof(m_Lights));
+		std::memset(&m_Time, 0, sizeof(m_Time));
+		m_Camera.projection = m_Camera.view = glm::mat4(1.0f);
+	}
+
+	~FrameUniforms()
+	{
+		if (m_UBO != 0)
+			glDeleteBuffers(1, &m_UBO);
+	}
+
+	// every block FrameUniforms writes, indexed by binding point
+	static const FrameBlockInfo* Blocks()
+	{
+		static const FrameBlockInfo blocks[FRAME_BLOCK_COUNT] = {
+			{ "Camera", CAMERA_BLOCK_BINDING },
+			{ "Lights", LIGHTS_BLOCK_BINDING },
+			{ "Frame", FRAME_BLOCK_BINDING }
+		};
+		return blocks;
+	}
+
+	FrameUniforms(const FrameUniforms&) = delete;
+	FrameUniforms& operator=(const FrameUniforms&) = delete;
+
+	void SetProjection(const glm::mat4& projection)
+	{
+		m_Camera.projection = projection;
+		m_Dirty = true;
+	}
+
+	void SetView(const glm::mat4& view, const glm::vec3& viewPos)
+	{
+		m_Camera.view = view;
+		m_Camera.viewPos = glm::vec4(viewPos, 1.0f);
+		m_Dirty = true;
+	}
+
+	void SetDirectionalLight(int light, const glm::vec3& direction, const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular)
+	{
+		SetLight(light, glm::vec4(direction, 0.0f), ambient, diffuse, specular, glm::vec3(1.0f, 0.0f, 0.0f));
+	}
+
+	void SetPointLight(int light, const glm::vec3& position, const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular,
+		float constant, float linear, float quadratic)
+	{
+		SetLight(light, glm::vec4(position, 1.0f), ambient, diffuse, specular, glm::vec3(constant, linear, quadratic));
+	}
+
+	// lights [0, count) are the ones in use
+	void SetLightCount(int count)
+	{
+		m_Lights.lightCount = glm::clamp(count, 0, LightsBlock::MAX_LIGHTS);
+		m_Dirty = true;
+	}
+
+	// call once per frame, before the frame's Upload
+	void SetTime(float time, float deltaTime)
+	{
+		m_Time.time = time;
+		m_Time.deltaTime = deltaTime;
+		m_Time.frame++;
+		m_Dirty = true;
+	}
+
+	// GL thread, once per frame before drawing. writes the blocks if anything changed since the last call
+	void Upload()
+	{
+		if (m_UBO == 0)
+			Setup();
+		if (!m_Dirty)
+			return;
+		glBindBuffer(GL_UNIFORM_BUFFER, m_UBO);
+		unsigned char* data = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, m_Size,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		for (int block = 0; block < FRAME_BLOCK_COUNT; block++)
+		{
+			if (data != NULL)
+				std::memcpy(data + m_Offsets[block], BlockData(block), BlockSize(block));
+			else
+				glBufferSubData(GL_UNIFORM_BUFFER, m_Offsets[block], BlockSize(block), BlockData(block));
+		}
+		if (data != NULL)
+			glUnmapBuffer(GL_UNIFORM_BUFFER);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		m_Dirty = false;
+		m_Uploads++;
+	}
+
+	// binds the blocks again, after other code used the same binding points
+	void Bind() const
+	{
+		for (int block = 0; block < FRAME_BLOCK_COUNT; block++)
+			glBindBufferRange(GL_UNIFORM_BUFFER, Blocks()[block].binding, m_UBO, m_Offsets[block], BlockSize(block));
+	}
+
+	const CameraBlock& GetCamera() const { return m_Camera; }
+	const LightsBlock& GetLights() const { return m_Lights; }
+	const TimeBlock& GetTime() const { return m_Time; }
+	// how many times Upload wrote the buffer
+	unsigned long GetUploadCount() const { return m_Uploads; }
+
+private:
+	void SetLight(int light, const glm::vec4& position, const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular,
+		const glm::vec3& attenuation)
+	{
+		if (light < 0 || light >= LightsBlock::MAX_LIGHTS)
+			return;
+		BlockLight& block = m_Lights.lights[light];
+		block.position = position;
+		block.ambient = glm::vec4(ambient, 1.0f);
+		block.diffuse = glm::vec4(diffuse, 1.0f);
+		block.specular = glm::vec4(specular, 1.0f);
+		block.attenuation = glm::vec4(attenuation, 0.0f);
+		m_Dirty = true;
+	}
+
+	// the blocks' offsets follow GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, which glBindBufferRange requires
+	void Setup()
+	{
+		GLint alignment = 256;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		if (alignment < 1)
+			alignment = 256;
+		m_Size = 0;
+		for (int block = 0; block < FRAME_BLOCK_COUNT; block++)
+		{
+			m_Offsets[block] = Align(m_Size, alignment);
+			m_Size = m_Offsets[block] + BlockSize(block);
+		}
+
+		glGenBuffers(1, &m_UBO);
+		glBindBuffer(GL_UNIFORM_BUFFER, m_UBO);
+		glBufferData(GL_UNIFORM_BUFFER, m_Size, NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		Bind();
+		m_Dirty = true;
+	}
+
+	const void* BlockData(int binding) const
+	{
+		switch (binding)
+		{
+		case CAMERA_BLOCK_BINDING: return &m_Camera;
+		case LIGHTS_BLOCK_BINDING: return &m_Lights;
+		default: return &m_Time;
+		}
+	}
+
+	static GLsizeiptr BlockSize(int binding)
+	{
+		switch (binding)
+		{
+		case CAMERA_BLOCK_BINDING: return sizeof(CameraBlock);
+		case LIGHTS_BLOCK_BINDING: return sizeof(LightsBlock);
+		default: return sizeof(TimeBlock);
+		}
+	}
+
+	static GLintptr Align(size_t offset, GLint alignment)
+	{
+		return (GLintptr)((offset + alignment - 1) / alignment * alignment);
+	}
+
+	CameraBlock m_Camera;
+	LightsBlock m_Lights;
+	TimeBlock m_Time;
+
+	GLuint m_UBO = 0;
+	GLintptr m_Offsets[FRAME_BLOCK_COUNT] = {};
+	GLsizeiptr m_Size = 0;
+	bool m_Dirty = true;
+	unsigned long m_Uploads = 0;
+};
@@ -7,9 +7,12 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <learnopengl/packed_vertex.h>
 
 #include <string>
 #include <vector>
+#include <utility>
+#include <iostream>
 using namespace std;
 
 #define MAX_BONE_INFLUENCE 4
@@ -37,36 +40,174 @@ struct Texture {
     string path;
 };
 
+// one material texture resolved against a shader; it goes to the texture unit of its index in the block
+struct TextureBinding {
+    UniformHandle sampler;
+    unsigned int texture;
+};
+
+// the uniforms a mesh sets on one program, resolved once per program (see Mesh::resolveBindings)
+struct MeshBindings {
+    unsigned int program = 0;
+    vector<TextureBinding> textures;
+    UniformHandle positionOffset, positionScale, packedVertex;
+};
+
+// one level of detail : a range of the mesh's indices over the shared vertices
+struct MeshLod {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    float error;    // distance the simplified surface may be off the full one, in model units
+};
+
 class Mesh {
 public:
     // mesh Data
     vector<Vertex>       vertices;
-    vector<unsigned int> indices;
+    vector<unsigned int> indices;   // every level of detail, one after the other
     vector<Texture>      textures;
+    vector<MeshLod>      lods;      // lods[0] is the full mesh, the rest coarser and coarser (see MeshSimplifier)
     unsigned int VAO;
 
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // constructor. packed uploads the vertices as PackedVertex and the indices as 16 bit when they fit (see packed_vertex.h).
+    // without lods, all the indices are one level
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, bool packed = false, vector<MeshLod> lods = vector<MeshLod>())
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->textures = std::move(textures);
+        this->lods = std::move(lods);
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh(&this->vertices[0], this->vertices.size(), &this->indices[0], this->indices.size(), packed);
+    }
+
+    // uploads vertex/index data straight from memory the mesh does not keep (e.g. a mapped baked asset); vertices and indices stay empty
+    Mesh(const Vertex* vertexData, size_t numVertices, const unsigned int* indexData, size_t numIndices, vector<Texture> textures,
+        bool packed = false, vector<MeshLod> lods = vector<MeshLod>())
+    {
+        this->textures = textures;
+        this->lods = std::move(lods);
+        setupMesh(vertexData, numVertices, indexData, numIndices, packed);
+    }
+
+    // the coarsest level whose error stays within maxError model units
+    int selectLod(float maxError) const
+    {
+        int lod = 0;
+        while (lod + 1 < (int)lods.size() && lods[lod + 1].error <= maxError)
+            lod++;
+        return lod;
+    }
+
+    // whether the vertices went up as PackedVertex; meshes with bone ids over 127 stay in the full layout
+    bool isPacked() const { return packed; }
+
+    // most bone influences of any vertex, 0 for a mesh no bone moves; what a skinning shader variant has to loop over
+    int getInfluenceCount() const { return influenceCount; }
+
+    // whether the material has a texture of type ("texture_normal", "texture_specular"...)
+    bool hasTexture(const string& type) const
+    {
+        for (const Texture& texture : textures)
+        {
+            if (texture.type == type)
+                return true;
+        }
+        return false;
+    }
+
+    // video memory of the vertex and index buffers
+    size_t getVertexBufferBytes() const { return vertexBufferBytes; }
+    size_t getIndexBufferBytes() const { return indexBufferBytes; }
+
+    // render the mesh, at one of its levels of detail
+    void Draw(Shader &shader, int lod = 0) 
+    {
+        bindTextures(shader);
+        bindQuantization(shader);
+        
+        // draw mesh
+        glBindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, lods[lod].indexCount, indexType, indexPointer(lod));
+        glBindVertexArray(0);
+
+        // always good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // render instanceCount copies of the mesh at one of its levels of detail; per-instance attributes have to be attached to the VAO beforehand
+    void DrawInstanced(Shader &shader, unsigned int instanceCount, int lod = 0)
+    {
+        bindTextures(shader);
+        bindQuantization(shader);
+
+        glBindVertexArray(VAO);
+        glDrawElementsInstanced(GL_TRIANGLES, lods[lod].indexCount, indexType, indexPointer(lod), instanceCount);
+        glBindVertexArray(0);
+
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // binds the material textures and sets their samplers, for draws that use another VAO.
+    // the sampler names are looked up once per shader (see resolveBindings), so a draw only sets units and binds;
+    // units the sampler already has are filtered out by the shader
+    void bindTextures(Shader &shader)
+    {
+        const MeshBindings &bindings = bindingsFor(shader);
+        for(unsigned int i = 0; i < bindings.textures.size(); i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i);
+            shader.setInt(bindings.textures[i].sampler, i);
+            glBindTexture(GL_TEXTURE_2D, bindings.textures[i].texture);
+        }
+    }
+
+    // drops the resolved bindings, for programs relinked under the same ID or textures replaced in place
+    void invalidateBindings()
+    {
+        for (const MeshBindings &bindings : programBindings)
+            programQuantization(bindings.program) = 0;
+        programBindings.clear();
+    }
+
+    // the bindings of shader, resolved on its first draw of the mesh
+    const MeshBindings &bindingsFor(Shader &shader)
+    {
+        if (lastBindings < programBindings.size() && programBindings[lastBindings].program == shader.ID &&
+            programBindings[lastBindings].textures.size() == textures.size())
+            return programBindings[lastBindings];
+        return resolveBindings(shader);
     }
 
-    // render the mesh
-    void Draw(Shader &shader) 
+    // sampler and quantization uniforms of shader, and the textures they get. a mesh drawn by several programs
+    // (shader variants, depth passes) keeps one entry per program
+    const MeshBindings &resolveBindings(Shader &shader)
     {
-        // bind appropriate textures
+        lastBindings = 0;
+        while (lastBindings < programBindings.size() && programBindings[lastBindings].program != shader.ID)
+            lastBindings++;
+        if (lastBindings == programBindings.size())
+            programBindings.push_back(MeshBindings());
+        else if (programBindings[lastBindings].textures.size() == textures.size())
+            return programBindings[lastBindings];
+
+        MeshBindings &bindings = programBindings[lastBindings];
+        bindings.program = shader.ID;
+        bindings.textures.resize(textures.size());
+        bindings.positionOffset = shader.uniform("positionOffset");
+        bindings.positionScale = shader.uniform("positionScale");
+        bindings.packedVertex = shader.uniform("packedVertex");
+        programQuantization(shader.ID) = 0;
+        if (packed && bindings.packedVertex.slot < 0 && readsFullNormals(shader))
+            cout << "WARNING::MESH:: packed mesh drawn with a shader reading a vec3 normal without packedVertex (see packed_vertex.h)" << endl;
+
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
@@ -79,43 +220,122 @@ public:
              else if(name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to string
 
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            // the sampler of the texture unit, and the texture bound to it
+            bindings.textures[i].sampler = shader.uniform(name + number);
+            bindings.textures[i].texture = textures[i].id;
         }
-        
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+        return bindings;
+    }
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    // byte offset of a level in the element buffer
+    const void* indexPointer(int lod) const
+    {
+        size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+        return (const void*)(lods[lod].indexOffset * indexSize);
+    }
+
+    // moves packed positions back into the mesh's bounds and tells packed normals apart, identity for the full layout.
+    // nothing is set when the program already holds this mesh's quantization, as for consecutive full layout meshes
+    void bindQuantization(Shader &shader)
+    {
+        const MeshBindings &bindings = bindingsFor(shader);
+        uint64_t &programStamp = programQuantization(shader.ID);
+        if (programStamp == quantizationStamp)
+            return;
+        programStamp = quantizationStamp;
+        shader.setVec3(bindings.positionOffset, quantization.offset);
+        shader.setVec3(bindings.positionScale, quantization.scale);
+        shader.setBool(bindings.packedVertex, packed);
+    }
+
+    // whether shader reads the normal attribute (location 1) as a vec3, which a packed mesh only fills with x and y
+    static bool readsFullNormals(const Shader &shader)
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(shader.ID, GL_ACTIVE_ATTRIBUTES, &count);
+        glGetProgramiv(shader.ID, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+        vector<GLchar> name(maxLength + 1);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveAttrib(shader.ID, i, (GLsizei)name.size(), NULL, &size, &type, name.data());
+            if (type == GL_FLOAT_VEC3 && glGetAttribLocation(shader.ID, name.data()) == 1)
+                return true;
+        }
+        return false;
     }
 
 private:
     // render data 
     unsigned int VBO, EBO;
+    GLenum indexType;
+    bool packed;
+    int influenceCount;
+    VertexQuantization quantization;
+    size_t vertexBufferBytes, indexBufferBytes;
+    // material bindings of every program that drew the mesh, lastBindings the one of the last draw
+    vector<MeshBindings> programBindings;
+    size_t lastBindings = 0;
+    // 1 for the identity quantization of the full layout, unique per packed mesh (copies share it)
+    uint64_t quantizationStamp;
+
+    // the quantization stamp of the mesh whose uniforms the program holds, 0 when unknown
+    static uint64_t &programQuantization(unsigned int program)
+    {
+        static vector<uint64_t> stamps;
+        if (program >= stamps.size())
+            stamps.resize(program + 1, 0);
+        return stamps[program];
+    }
+
+    static uint64_t nextQuantizationStamp()
+    {
+        static uint64_t stamp = 1;
+        return ++stamp;
+    }
 
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const Vertex* vertexData, size_t numVertices, const unsigned int* indexData, size_t numIndices, bool pack)
     {
+        if (lods.empty())
+            lods.push_back(MeshLod{ 0, static_cast<unsigned int>(numIndices), 0.0f });
+        packed = pack && VertexPacker::CanPack(vertexData, numVertices);
+        quantizationStamp = packed ? nextQuantizationStamp() : 1;
+        influenceCount = 0;
+        for (size_t v = 0; v < numVertices && influenceCount < MAX_BONE_INFLUENCE; v++)
+        {
+            for (int k = influenceCount; k < MAX_BONE_INFLUENCE; k++)
+            {
+                if (vertexData[v].m_BoneIDs[k] >= 0)
+                    influenceCount = k + 1;
+            }
+        }
+
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
         glBindVertexArray(VAO);
+        if (packed)
+        {
+            setupPackedMesh(vertexData, numVertices, indexData, numIndices);
+            glBindVertexArray(0);
+            return;
+        }
+        indexType = GL_UNSIGNED_INT;
+        vertexBufferBytes = numVertices * sizeof(Vertex);
+        indexBufferBytes = numIndices * sizeof(unsigned int);
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
+        glBufferData(GL_ARRAY_BUFFER, numVertices * sizeof(Vertex), vertexData, GL_STATIC_DRAW);  
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(unsigned int), indexData, GL_STATIC_DRAW);
 
         // set the vertex attribute pointers
         // vertex Positions
@@ -142,5 +362,43 @@ private:
 		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
         glBindVertexArray(0);
     }
+
+    // same attribute locations as above in the PackedVertex formats; the bitangent (4) is left to the shader
+    void setupPackedMesh(const Vertex* vertexData, size_t numVertices, const unsigned int* indexData, size_t numIndices)
+    {
+        vector<PackedVertex> packedVertices;
+        quantization = VertexPacker::Pack(vertexData, numVertices, packedVertices);
+        vertexBufferBytes = numVertices * sizeof(PackedVertex);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertexBufferBytes, packedVertices.data(), GL_STATIC_DRAW);
+
+        vector<uint16_t> shortIndices;
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        if (VertexPacker::PackIndices(indexData, numIndices, numVertices, shortIndices))
+        {
+            indexType = GL_UNSIGNED_SHORT;
+            indexBufferBytes = numIndices * sizeof(uint16_t);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBufferBytes, shortIndices.data(), GL_STATIC_DRAW);
+        }
+        else
+        {
+            indexType = GL_UNSIGNED_INT;
+            indexBufferBytes = numIndices * sizeof(unsigned int);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBufferBytes, indexData, GL_STATIC_DRAW);
+        }
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, TexCoords));
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Tangent));
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, 4, GL_BYTE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, BoneIDs));
+        glEnableVertexAttribArray(6);
+        glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Weights));
+    }
 };
 #endif
@@ -0,0 +1,342 @@
+#pragma once
+
+/* Draws the meshes of many models out of one shared vertex/index buffer with a handful of draw calls */
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <learnopengl/bone_palette.h>
+#include <learnopengl/model_animation.h>
+
+// what glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER for each draw
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+/*the meshes of every added model go once into a shared VBO and EBO, their
+indices rebased onto it. every instance of a model adds one draw per mesh,
+and the draws are sorted by material (the textures of their mesh). a
+material's textures are bound once, then all its draws go out as a single
+glMultiDrawElementsIndirect when the context has GL 4.3, and as plain
+glDrawElements otherwise, with no other state change in between.
+
+per-draw data is attribute 7, the draw's instance (uint). indirect draws
+read it as an instanced attribute at their baseInstance, the others get it
+as a constant attribute value. the vertex shader then fetches the instance
+transform from the samplerBuffer instanceTransforms, one matrix every 4
+texels (see 47_MeshBatching/batch.vs).
+
+only lods[0] of the meshes, in the full Vertex layout. the models have to
+keep their vertices (see BakedAsset::Read's keepVertexData) and outlive the
+batch, whose material textures are bound through their meshes.*/
+class MeshBatch
+{
+public:
+	// allowIndirect false keeps to the GL 3.3 path, to compare both
+	MeshBatch(bool allowIndirect = true) : m_AllowIndirect(allowIndirect)
+	{
+	}
+
+	~MeshBatch()
+	{
+		Release();
+	}
+
+	MeshBatch(const MeshBatch&) = delete;
+	MeshBatch& operator=(const MeshBatch&) = delete;
+
+	// copies the model's meshes into the shared buffers, once per model; returns the model's index for AddInstance
+	int AddModel(Model& model)
+	{
+		auto found = m_ModelIndex.find(&model);
+		if (found != m_ModelIndex.end())
+			return found->second;
+
+		std::vector<int> meshes;
+		for (Mesh& mesh : model.meshes)
+		{
+			if (mesh.vertices.empty())
+				continue;
+			MeshRange range;
+			range.mesh = &mesh;
+			range.firstIndex = (unsigned int)m_Indices.size();
+			range.indexCount = mesh.lods[0].indexCount;
+			range.material = MaterialOf(mesh);
+
+			unsigned int baseVertex = (unsigned int)m_Vertices.size();
+			m_Vertices.insert(m_Vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+			const unsigned int* indices = mesh.indices.data() + mesh.lods[0].indexOffset;
+			for (unsigned int i = 0; i < range.indexCount; i++)
+				m_Indices.push_back(baseVertex + indices[i]);
+
+			meshes.push_back((int)m_Meshes.size());
+			m_Meshes.push_back(range);
+		}
+		m_Models.push_back(meshes);
+		m_ModelIndex[&model] = (int)m_Models.size() - 1;
+		m_GeometryDirty = m_DrawsDirty = true;
+		return (int)m_Models.size() - 1;
+	}
+
+	// one more copy of an added model; returns the instance's index for SetTransform
+	int AddInstance(int model, const glm::mat4& transform)
+	{
+		m_InstanceModels.push_back(model);
+		m_Transforms.push_back(transform);
+		m_DrawsDirty = m_TransformsDirty = true;
+		return (int)m_Transforms.size() - 1;
+	}
+
+	void SetTransform(int instance, const glm::mat4& transform)
+	{
+		m_Transforms[instance] = transform;
+		m_TransformsDirty = true;
+	}
+
+	// GL thread. uploads what changed since the last call; Draw calls it too
+	void Build()
+	{
+		if (m_VAO == 0)
+			Setup();
+		if (m_GeometryDirty)
+		{
+			// the element buffer binding belongs to the VAO
+			glBindVertexArray(m_VAO);
+			glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+			glBufferData(GL_ARRAY_BUFFER, m_Vertices.size() * sizeof(Vertex), m_Vertices.data(), GL_STATIC_DRAW);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_Indices.size() * sizeof(unsigned int), m_Indices.data(), GL_STATIC_DRAW);
+			glBindVertexArray(0);
+			m_GeometryDirty = false;
+		}
+		if (m_DrawsDirty)
+		{
+			BuildDraws();
+			m_DrawsDirty = false;
+		}
+		if (m_TransformsDirty)
+		{
+			glBindBuffer(GL_TEXTURE_BUFFER, m_TransformBuffer);
+			glBufferData(GL_TEXTURE_BUFFER, m_Transforms.size() * sizeof(glm::mat4), m_Transforms.data(), GL_DYNAMIC_DRAW);
+			glBindBuffer(GL_TEXTURE_BUFFER, 0);
+			m_TransformsDirty = false;
+		}
+	}
+
+	// draws every instance; returns the number of draw calls issued
+	int Draw(Shader& shader)
+	{
+		Build();
+		int drawCalls = 0;
+		glBindVertexArray(m_VAO);
+		glActiveTexture(GL_TEXTURE0 + BATCH_TRANSFORM_TEXTURE_UNIT);
+		glBindTexture(GL_TEXTURE_BUFFER, m_TransformTexture);
+		shader.setInt("instanceTransforms", BATCH_TRANSFORM_TEXTURE_UNIT);
+#ifdef GL_VERSION_4_3
+		// context state, not part of the VAO
+		if (m_Indirect)
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_IndirectBuffer);
+#endif
+
+		for (const Group& group : m_Groups)
+		{
+			group.material->bindTextures(shader);
+#ifdef GL_VERSION_4_3
+			if (m_Indirect)
+			{
+				glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+					(const void*)(group.firstDraw * sizeof(DrawElementsIndirectCommand)), (GLsizei)group.drawCount, 0);
+				drawCalls++;
+				continue;
+			}
+#endif
+			for (size_t d = group.firstDraw; d < group.firstDraw + group.drawCount; d++)
+			{
+				const DrawElementsIndirectCommand& command = m_Commands[d];
+				glVertexAttribI1ui(7, m_DrawInstances[d]);
+				glDrawElements(GL_TRIANGLES, command.count, GL_UNSIGNED_INT, (const void*)(command.firstIndex * sizeof(unsigned int)));
+				drawCalls++;
+			}
+		}
+
+#ifdef GL_VERSION_4_3
+		if (m_Indirect)
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+#endif
+		glBindVertexArray(0);
+		glActiveTexture(GL_TEXTURE0);
+		return drawCalls;
+	}
+
+	// draws per frame before batching : meshes times instances
+	size_t GetDrawCount() const { return m_Commands.size(); }
+	// materials, so texture bindings per frame
+	size_t GetGroupCount() const { return m_Groups.size(); }
+	bool IsIndirect() const { return m_Indirect; }
+	size_t GetVertexCount() const { return m_Vertices.size(); }
+
+private:
+	struct MeshRange
+	{
+		Mesh* mesh;
+		unsigned int firstIndex;
+		unsigned int indexCount;
+		int material;
+	};
+
+	// a run of draws sharing the textures of material
+	struct Group
+	{
+		Mesh* material;
+		size_t firstDraw;
+		size_t drawCount;
+	};
+
+	void Setup()
+	{
+#ifdef GL_VERSION_4_3
+		m_Indirect = m_AllowIndirect && GLAD_GL_VERSION_4_3;
+#endif
+		glGenVertexArrays(1, &m_VAO);
+		glGenBuffers(1, &m_VBO);
+		glGenBuffers(1, &m_EBO);
+		glGenBuffers(1, &m_DrawBuffer);
+		glGenBuffers(1, &m_TransformBuffer);
+		glGenTextures(1, &m_TransformTexture);
+
+		glBindTexture(GL_TEXTURE_BUFFER, m_TransformTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_TransformBuffer);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+		// the attributes of Mesh::setupMesh, plus the instance
+		glBindVertexArray(m_VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Position));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+		glEnableVertexAttribArray(4);
+		glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+		glEnableVertexAttribArray(5);
+		glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
+		glEnableVertexAttribArray(6);
+		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
+		if (m_Indirect)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, m_DrawBuffer);
+			glEnableVertexAttribArray(7);
+			glVertexAttribIPointer(7, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+			glVertexAttribDivisor(7, 1);
+		}
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// one draw per mesh of every instance, sorted by material, then mesh
+	void BuildDraws()
+	{
+		std::vector<std::pair<int, int>> draws;	// mesh, instance
+		for (size_t i = 0; i < m_InstanceModels.size(); i++)
+		{
+			for (int mesh : m_Models[m_InstanceModels[i]])
+				draws.push_back(std::make_pair(mesh, (int)i));
+		}
+		std::stable_sort(draws.begin(), draws.end(), [this](const std::pair<int, int>& a, const std::pair<int, int>& b)
+		{
+			if (m_Meshes[a.first].material != m_Meshes[b.first].material)
+				return m_Meshes[a.first].material < m_Meshes[b.first].material;
+			return a.first < b.first;
+		});
+
+		m_Commands.clear();
+		m_DrawInstances.clear();
+		m_Groups.clear();
+		int material = -1;
+		for (const std::pair<int, int>& draw : draws)
+		{
+			const MeshRange& range = m_Meshes[draw.first];
+			if (range.material != material)
+			{
+				m_Groups.push_back(Group{ range.mesh, m_Commands.size(), 0 });
+				material = range.material;
+			}
+			m_Groups.back().drawCount++;
+			m_Commands.push_back(DrawElementsIndirectCommand{ range.indexCount, 1, range.firstIndex, 0, (GLuint)m_Commands.size() });
+			m_DrawInstances.push_back((GLuint)draw.second);
+		}
+
+#ifdef GL_VERSION_4_3
+		if (m_Indirect)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, m_DrawBuffer);
+			glBufferData(GL_ARRAY_BUFFER, m_DrawInstances.size() * sizeof(GLuint), m_DrawInstances.data(), GL_STATIC_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			if (m_IndirectBuffer == 0)
+				glGenBuffers(1, &m_IndirectBuffer);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_IndirectBuffer);
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, m_Commands.size() * sizeof(DrawElementsIndirectCommand), m_Commands.data(), GL_STATIC_DRAW);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		}
+#endif
+	}
+
+	// meshes with the same textures, in the same order, share a material
+	int MaterialOf(const Mesh& mesh)
+	{
+		std::vector<std::pair<std::string, unsigned int>> key;
+		for (const Texture& texture : mesh.textures)
+			key.push_back(std::make_pair(texture.type, texture.id));
+		auto inserted = m_Materials.insert(std::make_pair(key, (int)m_Materials.size()));
+		return inserted.first->second;
+	}
+
+	void Release()
+	{
+		if (m_VAO == 0)
+			return;
+		glDeleteVertexArrays(1, &m_VAO);
+		GLuint buffers[] = { m_VBO, m_EBO, m_DrawBuffer, m_TransformBuffer, m_IndirectBuffer };
+		glDeleteBuffers(m_IndirectBuffer ? 5 : 4, buffers);
+		glDeleteTextures(1, &m_TransformTexture);
+		m_VAO = 0;
+	}
+
+	//CPU side
+	bool m_AllowIndirect;
+	std::vector<Vertex> m_Vertices;
+	std::vector<unsigned int> m_Indices;
+	std::vector<MeshRange> m_Meshes;
+	std::vector<std::vector<int>> m_Models;	//mesh ranges of each model
+	std::map<const Model*, int> m_ModelIndex;
+	std::map<std::vector<std::pair<std::string, unsigned int>>, int> m_Materials;
+	std::vector<int> m_InstanceModels;
+	std::vector<glm::mat4> m_Transforms;
+	std::vector<DrawElementsIndirectCommand> m_Commands;
+	std::vector<GLuint> m_DrawInstances;
+	std::vector<Group> m_Groups;
+	bool m_GeometryDirty = false;
+	bool m_DrawsDirty = false;
+	bool m_TransformsDirty = false;
+
+	//GL side
+	bool m_Indirect = false;
+	GLuint m_VAO = 0, m_VBO = 0, m_EBO = 0;
+	GLuint m_DrawBuffer = 0;
+	GLuint m_IndirectBuffer = 0;
+	GLuint m_TransformBuffer = 0, m_TransformTexture = 0;
+};
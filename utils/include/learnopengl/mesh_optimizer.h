@@ -0,0 +1,406 @@
+#pragma once
+
+/* Import-time optimization of a mesh's vertex and index streams */
+
+#include <learnopengl/mesh.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// post-transform cache behaviour of an index stream, simulated as a FIFO
+struct VertexCacheStats
+{
+	float acmr = 0.0f;			// vertex shader runs per triangle : 0.5 at best, 3 with no reuse
+	float atvr = 0.0f;			// vertex shader runs per vertex : 1 at best
+	float overfetch = 0.0f;		// vertex bytes read per byte of vertex data the draw uses : 1 at best
+};
+
+// the stats after each step, in the order Optimize runs them
+struct MeshOptimizationStats
+{
+	size_t verticesBefore = 0, verticesAfter = 0;
+	size_t triangles = 0;
+	VertexCacheStats original, welded, cacheOrdered, overdrawOrdered, fetchOrdered;
+};
+
+/*the steps run on the CPU arrays of a mesh before they are uploaded, so the
+GPU (or a software rasterizer) runs the vertex shader fewer times:
+
+- weld : vertices with the exact same attributes (positions, normals, uvs,
+  bone weights...) become one. OBJ files and Assimp without
+  aiProcess_JoinIdenticalVertices emit one vertex per face corner.
+- cache : triangles are reordered with Tipsify (Sander et al. 2007) so the
+  vertices they share are still in the post-transform cache.
+- overdraw : the runs of triangles Tipsify produces are cut into clusters
+  that keep the cache efficiency within a threshold of the whole mesh, and
+  clusters facing out of the mesh are drawn first so they occlude the rest.
+- fetch : vertices are renumbered in the order the triangles first use
+  them, so the vertex fetch reads the buffer front to back. unreferenced
+  vertices are dropped.
+
+none of the steps change what is drawn, only the order.*/
+class MeshOptimizer
+{
+public:
+	// entries of the simulated post-transform cache, a typical size for desktop GPUs
+	static const int CACHE_SIZE = 16;
+
+	static MeshOptimizationStats Optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+		float overdrawThreshold = 1.05f)
+	{
+		MeshOptimizationStats stats;
+		stats.verticesBefore = vertices.size();
+		stats.triangles = indices.size() / 3;
+		stats.original = AnalyzeVertexCache(indices, vertices.size());
+
+		WeldVertices(vertices, indices);
+		stats.welded = AnalyzeVertexCache(indices, vertices.size());
+
+		std::vector<size_t> clusters;
+		OptimizeVertexCache(indices, vertices.size(), &clusters);
+		stats.cacheOrdered = AnalyzeVertexCache(indices, vertices.size());
+
+		OptimizeOverdraw(indices, vertices, clusters, overdrawThreshold);
+		stats.overdrawOrdered = AnalyzeVertexCache(indices, vertices.size());
+
+		OptimizeVertexFetch(vertices, indices);
+		stats.fetchOrdered = AnalyzeVertexCache(indices, vertices.size());
+		stats.verticesAfter = vertices.size();
+		return stats;
+	}
+
+	static VertexCacheStats AnalyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount,
+		int cacheSize = CACHE_SIZE)
+	{
+		VertexCacheStats stats;
+		if (indices.empty() || vertexCount == 0)
+			return stats;
+
+		// a vertex is in the cache while fewer than cacheSize misses happened since it was loaded
+		std::vector<unsigned int> loadedAt(vertexCount, 0);
+		std::vector<bool> used(vertexCount, false);
+		unsigned int misses = 0;
+		size_t usedCount = 0;
+		for (unsigned int index : indices)
+		{
+			if (!used[index])
+			{
+				used[index] = true;
+				usedCount++;
+			}
+			if (loadedAt[index] == 0 || misses - loadedAt[index] >= (unsigned int)cacheSize)
+				loadedAt[index] = ++misses;
+		}
+		stats.acmr = (float)misses / (indices.size() / 3);
+		stats.atvr = (float)misses / usedCount;
+		stats.overfetch = AnalyzeVertexFetch(indices, vertexCount, usedCount);
+		return stats;
+	}
+
+	// merges the vertices that are bitwise equal, keeping the first of each
+	static void WeldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+	{
+		std::unordered_map<unsigned int, unsigned int, VertexHash, VertexEqual> unique(vertices.size(),
+			VertexHash{ vertices.data() }, VertexEqual{ vertices.data() });
+		std::vector<unsigned int> remap(vertices.size());
+		std::vector<Vertex> welded;
+		welded.reserve(vertices.size());
+		for (unsigned int i = 0; i < vertices.size(); i++)
+		{
+			auto it = unique.emplace(i, (unsigned int)welded.size());
+			if (it.second)
+				welded.push_back(vertices[i]);
+			remap[i] = it.first->second;
+		}
+		for (unsigned int& index : indices)
+			index = remap[index];
+		vertices.swap(welded);
+	}
+
+	/*Tipsify : fans out from one vertex at a time, emitting all its triangles,
+	then moves to the neighbour loaded the longest ago that will still be in
+	the cache once its own triangles are emitted. clusters receives the first triangle of every run that
+	had to restart from a vertex out of the cache.*/
+	static void OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount,
+		std::vector<size_t>* clusters = nullptr, int cacheSize = CACHE_SIZE)
+	{
+		size_t triangleCount = indices.size() / 3;
+		if (clusters)
+			clusters->clear();
+		if (triangleCount == 0)
+			return;
+
+		// triangles of every vertex
+		std::vector<unsigned int> live(vertexCount, 0);
+		for (unsigned int index : indices)
+			live[index]++;
+		std::vector<unsigned int> offsets(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; v++)
+			offsets[v + 1] = offsets[v] + live[v];
+		std::vector<unsigned int> adjacency(indices.size());
+		std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+			adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+		std::vector<unsigned int> cacheTime(vertexCount, 0);
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<unsigned int> deadEnd;
+		std::vector<unsigned int> candidates;
+		std::vector<unsigned int> result;
+		result.reserve(indices.size());
+
+		unsigned int time = cacheSize + 1;
+		size_t cursor = 0;
+		int vertex = NextLiveVertex(live, cursor);
+		if (clusters)
+			clusters->push_back(0);
+		while (vertex >= 0)
+		{
+			candidates.clear();
+			for (unsigned int a = offsets[vertex]; a < offsets[vertex + 1]; a++)
+			{
+				unsigned int triangle = adjacency[a];
+				if (emitted[triangle])
+					continue;
+				emitted[triangle] = true;
+				for (int k = 0; k < 3; k++)
+				{
+					unsigned int v = indices[triangle * 3 + k];
+					result.push_back(v);
+					deadEnd.push_back(v);
+					candidates.push_back(v);
+					live[v]--;
+					if (time - cacheTime[v] > (unsigned int)cacheSize)
+						cacheTime[v] = time++;
+				}
+			}
+
+			// the candidate that stays in the cache the longest once its own triangles are emitted
+			int best = -1;
+			int bestPriority = -1;
+			for (unsigned int v : candidates)
+			{
+				if (live[v] == 0)
+					continue;
+				int priority = 0;
+				if (time - cacheTime[v] + 2 * live[v] <= (unsigned int)cacheSize)
+					priority = time - cacheTime[v];
+				if (priority > bestPriority)
+				{
+					bestPriority = priority;
+					best = v;
+				}
+			}
+			if (best < 0)
+			{
+				// dead end : the most recent vertex with triangles left, or the next one in index order
+				while (!deadEnd.empty() && best < 0)
+				{
+					unsigned int v = deadEnd.back();
+					deadEnd.pop_back();
+					if (live[v] > 0)
+						best = v;
+				}
+				if (best < 0)
+					best = NextLiveVertex(live, cursor);
+				if (best >= 0 && clusters && time - cacheTime[best] > (unsigned int)cacheSize)
+					clusters->push_back(result.size() / 3);
+			}
+			vertex = best;
+		}
+		indices.swap(result);
+	}
+
+	/*cuts the cache-ordered triangles into clusters and sorts them so the
+	ones on the outside of the mesh come first. a Tipsify run is cut as soon
+	as its cache miss ratio so far is within threshold of the whole run's,
+	so the sort costs at most that much cache efficiency.*/
+	static void OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices,
+		const std::vector<size_t>& hardClusters, float threshold = 1.05f, int cacheSize = CACHE_SIZE)
+	{
+		size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0)
+			return;
+
+		// cache simulation of one range of triangles at a time, cleared after each
+		std::vector<unsigned int> loadedAt(vertices.size(), 0);
+		unsigned int misses = 0;
+		auto simulate = [&](size_t t) {
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[t * 3 + k];
+				if (loadedAt[v] == 0 || misses - loadedAt[v] >= (unsigned int)cacheSize)
+					loadedAt[v] = ++misses;
+			}
+		};
+		auto clear = [&](size_t begin, size_t end) {
+			for (size_t t = begin; t < end; t++)
+				for (int k = 0; k < 3; k++)
+					loadedAt[indices[t * 3 + k]] = 0;
+			misses = 0;
+		};
+
+		std::vector<size_t> clusters;
+		for (size_t c = 0; c < hardClusters.size(); c++)
+		{
+			size_t begin = hardClusters[c];
+			size_t end = c + 1 < hardClusters.size() ? hardClusters[c + 1] : triangleCount;
+			for (size_t t = begin; t < end; t++)
+				simulate(t);
+			float runAcmr = (float)misses / (end - begin);
+			clear(begin, end);
+
+			size_t start = begin;
+			clusters.push_back(begin);
+			for (size_t t = begin; t < end; t++)
+			{
+				simulate(t);
+				if (t + 1 < end && (float)misses / (t + 1 - start) <= runAcmr * threshold)
+				{
+					clear(start, t + 1);
+					start = t + 1;
+					clusters.push_back(start);
+				}
+			}
+			clear(start, end);
+		}
+
+		// area weighted centroid of the mesh
+		glm::vec3 meshCentroid(0.0f);
+		float meshArea = 0.0f;
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			float area;
+			TriangleNormal(indices, vertices, t, area);
+			meshCentroid += TriangleCentroid(indices, vertices, t) * area;
+			meshArea += area;
+		}
+		if (meshArea > 0.0f)
+			meshCentroid /= meshArea;
+
+		// clusters facing away from the centroid are on the outside, the further out the earlier
+		std::vector<std::pair<float, size_t>> order;
+		for (size_t c = 0; c < clusters.size(); c++)
+		{
+			size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+			glm::vec3 centroid(0.0f), normal(0.0f);
+			float clusterArea = 0.0f;
+			for (size_t t = clusters[c]; t < end; t++)
+			{
+				float area;
+				normal += TriangleNormal(indices, vertices, t, area) * area;
+				centroid += TriangleCentroid(indices, vertices, t) * area;
+				clusterArea += area;
+			}
+			float key = 0.0f;
+			if (clusterArea > 0.0f && glm::dot(normal, normal) > 0.0f)
+				key = glm::dot(centroid / clusterArea - meshCentroid, glm::normalize(normal));
+			order.push_back(std::make_pair(-key, c));
+		}
+		std::stable_sort(order.begin(), order.end(),
+			[](const std::pair<float, size_t>& a, const std::pair<float, size_t>& b) { return a.first < b.first; });
+
+		std::vector<unsigned int> result;
+		result.reserve(indices.size());
+		for (const auto& entry : order)
+		{
+			size_t c = entry.second;
+			size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+			result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + end * 3);
+		}
+		indices.swap(result);
+	}
+
+	// renumbers the vertices in order of first use and drops the unused ones
+	static void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+	{
+		const unsigned int unused = ~0u;
+		std::vector<unsigned int> remap(vertices.size(), unused);
+		std::vector<Vertex> ordered;
+		ordered.reserve(vertices.size());
+		for (unsigned int& index : indices)
+		{
+			if (remap[index] == unused)
+			{
+				remap[index] = (unsigned int)ordered.size();
+				ordered.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+		vertices.swap(ordered);
+	}
+
+private:
+	struct VertexHash
+	{
+		const Vertex* vertices;
+		size_t operator()(unsigned int i) const
+		{
+			// FNV-1a over the bytes; Vertex is all 4 byte fields, so there is no padding
+			const unsigned char* p = reinterpret_cast<const unsigned char*>(&vertices[i]);
+			uint64_t hash = 14695981039346656037ull;
+			for (size_t b = 0; b < sizeof(Vertex); b++)
+				hash = (hash ^ p[b]) * 1099511628211ull;
+			return (size_t)hash;
+		}
+	};
+
+	struct VertexEqual
+	{
+		const Vertex* vertices;
+		bool operator()(unsigned int a, unsigned int b) const
+		{
+			return memcmp(&vertices[a], &vertices[b], sizeof(Vertex)) == 0;
+		}
+	};
+
+	static int NextLiveVertex(const std::vector<unsigned int>& live, size_t& cursor)
+	{
+		while (cursor < live.size() && live[cursor] == 0)
+			cursor++;
+		return cursor < live.size() ? (int)cursor : -1;
+	}
+
+	/*bytes the vertex fetch reads through a small cache of 64 byte lines,
+	relative to the bytes of the vertices the draw uses.*/
+	static float AnalyzeVertexFetch(const std::vector<unsigned int>& indices, size_t vertexCount, size_t usedCount)
+	{
+		const size_t LINE = 64;
+		const size_t LINES = 64;
+		std::vector<size_t> cache(LINES, ~(size_t)0);
+		size_t fetched = 0;
+		for (unsigned int index : indices)
+		{
+			size_t first = index * sizeof(Vertex) / LINE;
+			size_t last = ((size_t)index * sizeof(Vertex) + sizeof(Vertex) - 1) / LINE;
+			for (size_t line = first; line <= last; line++)
+			{
+				// direct mapped
+				size_t& slot = cache[line % LINES];
+				if (slot != line)
+				{
+					slot = line;
+					fetched += LINE;
+				}
+			}
+		}
+		return (float)fetched / (usedCount * sizeof(Vertex));
+	}
+
+	static glm::vec3 TriangleCentroid(const std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, size_t t)
+	{
+		return (vertices[indices[t * 3]].Position + vertices[indices[t * 3 + 1]].Position + vertices[indices[t * 3 + 2]].Position) / 3.0f;
+	}
+
+	// unit normal, and the area in area
+	static glm::vec3 TriangleNormal(const std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, size_t t, float& area)
+	{
+		const glm::vec3& a = vertices[indices[t * 3]].Position;
+		glm::vec3 n = glm::cross(vertices[indices[t * 3 + 1]].Position - a, vertices[indices[t * 3 + 2]].Position - a);
+		float length = glm::length(n);
+		area = length * 0.5f;
+		return length > 0.0f ? n / length : glm::vec3(0.0f);
+	}
+};
@@ -0,0 +1,484 @@
+#pragma once
+
+/* Quadric error edge collapse simplification and the level of detail chain of a mesh */
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+/*Garland-Heckbert quadrics with half edge collapses : a vertex is merged
+into one of its neighbours and takes its place, so every level indexes the
+vertices of the full mesh and only adds indices.
+
+vertices are grouped by position, a group with several vertices sits on an
+attribute seam (uv, normal, bone weights). a group is only collapsed when
+each of its vertices has an edge to a vertex of the target group; the seam
+then moves along itself and its two sides stay closed. open borders only
+collapse along the border and carry extra quadrics that keep them in place,
+groups on non-manifold edges never move. collapses that would flip a
+triangle are skipped, and moving a vertex onto one with other bone weights
+costs as much as an error of SKIN_ERROR times the mesh radius.
+
+collapses run in passes : every pass sorts all the edges by error and
+collapses the cheapest ones whose neighbourhoods don't overlap.*/
+class MeshSimplifier
+{
+public:
+	// error of a collapse between vertices with entirely different bone weights, relative to the mesh radius
+	static constexpr float SKIN_ERROR = 0.1f;
+	// weight of the border quadrics against the surface ones
+	static constexpr float BORDER_WEIGHT = 10.0f;
+
+	/*indices of a simplified copy of the triangles, with at most
+	targetIndexCount indices unless that needs an error over maxError (model
+	units). error receives the largest error of the collapses done*/
+	static std::vector<unsigned int> Simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+		size_t targetIndexCount, float maxError, float* error = nullptr)
+	{
+		std::vector<unsigned int> result(indices);
+		if (error)
+			*error = 0.0f;
+		if (vertices.empty() || indices.empty())
+			return result;
+
+		const size_t vertexCount = vertices.size();
+		std::vector<unsigned int> group(vertexCount), nextWedge(vertexCount);
+		BuildGroups(vertices, group, nextWedge);
+
+		float radius = Radius(vertices);
+		float skinError = SKIN_ERROR * radius;
+		float maxCost = maxError * maxError;
+		float worst = 0.0f;
+
+		// quadrics stay with the group's first vertex and follow it through the collapses
+		std::vector<Quadric> quadrics(vertexCount);
+		for (size_t t = 0; t + 2 < result.size(); t += 3)
+			AddTriangleQuadric(vertices, group, &result[t], quadrics);
+
+		std::vector<unsigned int> collapseTo(vertexCount);
+		std::vector<bool> touched(vertexCount);
+		std::vector<Edge> edges;
+		std::vector<unsigned int> partner(vertexCount);
+		Topology topology;
+		for (int pass = 0; result.size() > targetIndexCount; pass++)
+		{
+			BuildTopology(result, group, vertexCount, topology);
+			// the borders only slide along themselves, so their planes are taken once from the input
+			if (pass == 0)
+				AddBorderQuadrics(vertices, group, result, topology, quadrics);
+
+			// cheapest valid direction of every edge
+			edges.clear();
+			for (const auto& entry : topology.edgeTriangles)
+			{
+				unsigned int a = (unsigned int)(entry.first >> 32), b = (unsigned int)(entry.first & 0xffffffffu);
+				Edge edge;
+				edge.cost = -1.0f;
+				for (int direction = 0; direction < 2; direction++)
+				{
+					unsigned int from = direction == 0 ? a : b, to = direction == 0 ? b : a;
+					if (!CanCollapse(from, to, topology))
+						continue;
+					float skin = SkinDifference(vertices[from], vertices[to]) * skinError;
+					float cost = quadrics[from].Evaluate(vertices[to].Position) + skin * skin;
+					if (edge.cost < 0.0f || cost < edge.cost)
+					{
+						edge.cost = cost;
+						edge.from = from;
+						edge.to = to;
+					}
+				}
+				if (edge.cost >= 0.0f)
+					edges.push_back(edge);
+			}
+			std::sort(edges.begin(), edges.end(), [](const Edge& x, const Edge& y) { return x.cost < y.cost; });
+
+			// greedy collapses with disjoint neighbourhoods
+			for (size_t v = 0; v < vertexCount; v++)
+				collapseTo[v] = (unsigned int)v;
+			std::fill(touched.begin(), touched.end(), false);
+			size_t triangles = result.size() / 3, targetTriangles = targetIndexCount / 3;
+			int collapses = 0;
+			for (const Edge& edge : edges)
+			{
+				if (triangles <= targetTriangles || edge.cost > maxCost)
+					break;
+				if (touched[edge.from] || touched[edge.to])
+					continue;
+				if (!FindPartners(edge.from, edge.to, group, nextWedge, result, topology, partner))
+					continue;
+				if (Flips(vertices, group, result, topology, edge.from, edge.to))
+					continue;
+
+				for (unsigned int w = edge.from;;)
+				{
+					collapseTo[w] = partner[w];
+					w = nextWedge[w];
+					if (w == edge.from)
+						break;
+				}
+				quadrics[edge.to].Add(quadrics[edge.from]);
+				worst = std::max(worst, edge.cost);
+				collapses++;
+
+				// the ring around the removed vertex changes, so nothing next to it moves in this pass
+				touched[edge.from] = touched[edge.to] = true;
+				for (unsigned int i = topology.offsets[edge.from]; i < topology.offsets[edge.from + 1]; i++)
+				{
+					const unsigned int* triangle = &result[topology.triangles[i] * 3];
+					bool removed = false;
+					for (int k = 0; k < 3; k++)
+					{
+						touched[group[triangle[k]]] = true;
+						removed |= group[triangle[k]] == edge.to;
+					}
+					if (removed)
+						triangles--;
+				}
+			}
+			if (collapses == 0)
+				break;
+
+			// remap, dropping the triangles that collapsed
+			size_t write = 0;
+			for (size_t t = 0; t + 2 < result.size(); t += 3)
+			{
+				unsigned int a = collapseTo[result[t]], b = collapseTo[result[t + 1]], c = collapseTo[result[t + 2]];
+				if (group[a] == group[b] || group[b] == group[c] || group[a] == group[c])
+					continue;
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+			result.resize(write);
+		}
+
+		if (error)
+			*error = std::sqrt(worst);
+		return result;
+	}
+
+	/*appends up to maxLevels coarser levels to indices, each with about
+	ratio times the triangles of the one before, and returns the table of
+	all the levels. the chain stops when a level cannot get below 85% of
+	the previous one within maxError, relative to the mesh radius. every
+	level is reordered for the vertex cache.*/
+	static std::vector<MeshLod> BuildLodChain(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+		int maxLevels = 4, float ratio = 0.5f, float maxError = 0.1f)
+	{
+		std::vector<MeshLod> lods;
+		lods.push_back(MeshLod{ 0, (unsigned int)indices.size(), 0.0f });
+		if (vertices.empty())
+			return lods;
+		float radius = Radius(vertices);
+
+		std::vector<unsigned int> previous(indices);
+		float error = 0.0f;
+		for (int level = 1; level <= maxLevels; level++)
+		{
+			size_t target = (size_t)(previous.size() / 3 * ratio) * 3;
+			if (target < 36)
+				break;
+			float levelError;
+			std::vector<unsigned int> simplified = Simplify(vertices, previous, target, maxError * radius, &levelError);
+			if (simplified.empty() || simplified.size() > previous.size() * 85 / 100)
+				break;
+
+			MeshOptimizer::OptimizeVertexCache(simplified, vertices.size());
+			// each level is simplified from the previous one, so the errors add up
+			error += levelError;
+			lods.push_back(MeshLod{ (unsigned int)indices.size(), (unsigned int)simplified.size(), error });
+			indices.insert(indices.end(), simplified.begin(), simplified.end());
+			previous.swap(simplified);
+		}
+		return lods;
+	}
+
+private:
+	// symmetric 4x4 matrix of the summed squared plane distances, and the weight it was summed with
+	struct Quadric
+	{
+		double a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+		double b0 = 0, b1 = 0, b2 = 0, c = 0;
+		double weight = 0;
+
+		void AddPlane(const glm::vec3& normal, float distance, double w)
+		{
+			double n0 = normal.x, n1 = normal.y, n2 = normal.z, d = distance;
+			a00 += w * n0 * n0; a11 += w * n1 * n1; a22 += w * n2 * n2;
+			a01 += w * n0 * n1; a02 += w * n0 * n2; a12 += w * n1 * n2;
+			b0 += w * n0 * d; b1 += w * n1 * d; b2 += w * n2 * d;
+			c += w * d * d;
+			weight += w;
+		}
+
+		void Add(const Quadric& q)
+		{
+			a00 += q.a00; a11 += q.a11; a22 += q.a22; a01 += q.a01; a02 += q.a02; a12 += q.a12;
+			b0 += q.b0; b1 += q.b1; b2 += q.b2; c += q.c;
+			weight += q.weight;
+		}
+
+		// mean squared distance of p to the planes
+		float Evaluate(const glm::vec3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			double e = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+				2.0 * (b0 * x + b1 * y + b2 * z) + c;
+			return weight > 0.0 ? (float)std::max(e / weight, 0.0) : 0.0f;
+		}
+	};
+
+	struct Edge
+	{
+		float cost;
+		unsigned int from, to;
+	};
+
+	// the current triangles around every group, and the group edges with the number of triangles on them
+	struct Topology
+	{
+		std::vector<unsigned int> offsets, triangles;
+		std::unordered_map<uint64_t, int> edgeTriangles;	// undirected, smaller group first
+		std::unordered_map<uint64_t, int> borderEdges;		// the edges above seen by a single triangle
+		std::vector<unsigned char> kind;	// per group : 0 interior, 1 border, 2 locked
+	};
+
+	static uint64_t EdgeKey(unsigned int a, unsigned int b)
+	{
+		if (a > b)
+			std::swap(a, b);
+		return (uint64_t)a << 32 | b;
+	}
+
+	static float Radius(const std::vector<Vertex>& vertices)
+	{
+		glm::vec3 lower = vertices[0].Position, upper = vertices[0].Position;
+		for (const Vertex& vertex : vertices)
+		{
+			lower = glm::min(lower, vertex.Position);
+			upper = glm::max(upper, vertex.Position);
+		}
+		return glm::length(upper - lower) * 0.5f;
+	}
+
+	// group[v] : first vertex with v's position. nextWedge links the vertices of a group in a ring
+	static void BuildGroups(const std::vector<Vertex>& vertices, std::vector<unsigned int>& group, std::vector<unsigned int>& nextWedge)
+	{
+		struct PositionHash
+		{
+			const Vertex* vertices;
+			size_t operator()(unsigned int i) const
+			{
+				uint32_t bits[3];
+				std::memcpy(bits, &vertices[i].Position, sizeof(bits));
+				return (size_t)(bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u);
+			}
+		};
+		struct PositionEqual
+		{
+			const Vertex* vertices;
+			bool operator()(unsigned int a, unsigned int b) const
+			{
+				return vertices[a].Position == vertices[b].Position;
+			}
+		};
+		std::unordered_map<unsigned int, unsigned int, PositionHash, PositionEqual> first(vertices.size(),
+			PositionHash{ vertices.data() }, PositionEqual{ vertices.data() });
+		for (unsigned int v = 0; v < vertices.size(); v++)
+		{
+			auto it = first.emplace(v, v);
+			unsigned int g = it.first->second;
+			group[v] = g;
+			if (g == v)
+				nextWedge[v] = v;
+			else
+			{
+				nextWedge[v] = nextWedge[g];
+				nextWedge[g] = v;
+			}
+		}
+	}
+
+	static void AddTriangleQuadric(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& group,
+		const unsigned int* triangle, std::vector<Quadric>& quadrics)
+	{
+		const glm::vec3& p0 = vertices[triangle[0]].Position;
+		glm::vec3 normal = glm::cross(vertices[triangle[1]].Position - p0, vertices[triangle[2]].Position - p0);
+		float length = glm::length(normal);
+		if (length == 0.0f)
+			return;
+		normal /= length;
+		for (int k = 0; k < 3; k++)
+			quadrics[group[triangle[k]]].AddPlane(normal, -glm::dot(normal, p0), length * 0.5f);
+	}
+
+	static void BuildTopology(const std::vector<unsigned int>& indices, const std::vector<unsigned int>& group,
+		size_t vertexCount, Topology& topology)
+	{
+		topology.offsets.assign(vertexCount + 1, 0);
+		for (unsigned int index : indices)
+			topology.offsets[group[index] + 1]++;
+		for (size_t v = 0; v < vertexCount; v++)
+			topology.offsets[v + 1] += topology.offsets[v];
+		topology.triangles.resize(indices.size());
+		std::vector<unsigned int> fill(topology.offsets.begin(), topology.offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+			topology.triangles[fill[group[indices[i]]]++] = (unsigned int)(i / 3);
+
+		topology.edgeTriangles.clear();
+		for (size_t t = 0; t + 2 < indices.size(); t += 3)
+			for (int k = 0; k < 3; k++)
+				topology.edgeTriangles[EdgeKey(group[indices[t + k]], group[indices[t + (k + 1) % 3]])]++;
+
+		topology.kind.assign(vertexCount, 0);
+		topology.borderEdges.clear();
+		for (const auto& entry : topology.edgeTriangles)
+		{
+			unsigned int a = (unsigned int)(entry.first >> 32), b = (unsigned int)(entry.first & 0xffffffffu);
+			if (entry.second == 1)
+			{
+				topology.borderEdges[entry.first] = 1;
+				topology.kind[a] = std::max(topology.kind[a], (unsigned char)1);
+				topology.kind[b] = std::max(topology.kind[b], (unsigned char)1);
+			}
+			else if (entry.second > 2)
+				topology.kind[a] = topology.kind[b] = 2;
+		}
+	}
+
+	// planes through the border edges, perpendicular to their triangle
+	static void AddBorderQuadrics(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& group,
+		const std::vector<unsigned int>& indices, const Topology& topology, std::vector<Quadric>& quadrics)
+	{
+		for (size_t t = 0; t + 2 < indices.size(); t += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int a = group[indices[t + k]], b = group[indices[t + (k + 1) % 3]];
+				uint64_t key = EdgeKey(a, b);
+				if (topology.borderEdges.count(key) == 0)
+					continue;
+				const glm::vec3& p0 = vertices[indices[t]].Position;
+				glm::vec3 normal = glm::cross(vertices[indices[t + 1]].Position - p0, vertices[indices[t + 2]].Position - p0);
+				glm::vec3 edge = vertices[b].Position - vertices[a].Position;
+				glm::vec3 plane = glm::cross(edge, normal);
+				float length = glm::length(plane);
+				if (length == 0.0f)
+					continue;
+				plane /= length;
+				float distance = -glm::dot(plane, vertices[a].Position);
+				double weight = BORDER_WEIGHT * glm::dot(edge, edge);
+				quadrics[a].AddPlane(plane, distance, weight);
+				quadrics[b].AddPlane(plane, distance, weight);
+			}
+		}
+	}
+
+	static bool CanCollapse(unsigned int from, unsigned int to, const Topology& topology)
+	{
+		if (topology.kind[from] == 2)
+			return false;
+		// border vertices only slide along their border
+		if (topology.kind[from] == 1)
+			return topology.borderEdges.count(EdgeKey(from, to)) != 0;
+		return true;
+	}
+
+	/*the vertex of group to that every vertex of group from shares a
+	triangle with; false when one of them has none*/
+	static bool FindPartners(unsigned int from, unsigned int to, const std::vector<unsigned int>& group,
+		const std::vector<unsigned int>& nextWedge, const std::vector<unsigned int>& indices, const Topology& topology,
+		std::vector<unsigned int>& partner)
+	{
+		const unsigned int none = ~0u;
+		for (unsigned int w = from;;)
+		{
+			partner[w] = none;
+			w = nextWedge[w];
+			if (w == from)
+				break;
+		}
+		for (unsigned int i = topology.offsets[from]; i < topology.offsets[from + 1]; i++)
+		{
+			const unsigned int* triangle = &indices[topology.triangles[i] * 3];
+			for (int k = 0; k < 3; k++)
+			{
+				if (group[triangle[k]] != from)
+					continue;
+				for (int j = 1; j < 3; j++)
+					if (group[triangle[(k + j) % 3]] == to)
+						partner[triangle[k]] = triangle[(k + j) % 3];
+			}
+		}
+		// vertices no triangle uses any more can be left out
+		for (unsigned int i = topology.offsets[from]; i < topology.offsets[from + 1]; i++)
+		{
+			const unsigned int* triangle = &indices[topology.triangles[i] * 3];
+			for (int k = 0; k < 3; k++)
+				if (group[triangle[k]] == from && partner[triangle[k]] == none)
+					return false;
+		}
+		return true;
+	}
+
+	// half the L1 distance of the two weight maps : 0 for the same weights, 1 for disjoint bones
+	static float SkinDifference(const Vertex& a, const Vertex& b)
+	{
+		float difference = 0.0f;
+		for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
+		{
+			if (a.m_BoneIDs[i] < 0)
+				continue;
+			float other = 0.0f;
+			for (int j = 0; j < MAX_BONE_INFLUENCE; j++)
+				if (b.m_BoneIDs[j] == a.m_BoneIDs[i])
+					other = b.m_Weights[j];
+			difference += std::fabs(a.m_Weights[i] - other);
+		}
+		for (int j = 0; j < MAX_BONE_INFLUENCE; j++)
+		{
+			if (b.m_BoneIDs[j] < 0)
+				continue;
+			bool shared = false;
+			for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
+				shared |= a.m_BoneIDs[i] == b.m_BoneIDs[j];
+			if (!shared)
+				difference += b.m_Weights[j];
+		}
+		return difference * 0.5f;
+	}
+
+	// whether moving from onto to turns a remaining triangle around from over, or makes it degenerate
+	static bool Flips(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& group,
+		const std::vector<unsigned int>& indices, const Topology& topology, unsigned int from, unsigned int to)
+	{
+		const glm::vec3& target = vertices[to].Position;
+		for (unsigned int i = topology.offsets[from]; i < topology.offsets[from + 1]; i++)
+		{
+			const unsigned int* triangle = &indices[topology.triangles[i] * 3];
+			glm::vec3 p[3];
+			bool removed = false;
+			for (int k = 0; k < 3; k++)
+			{
+				p[k] = vertices[triangle[k]].Position;
+				removed |= group[triangle[k]] == to;
+			}
+			if (removed)
+				continue;
+			glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+			for (int k = 0; k < 3; k++)
+				if (group[triangle[k]] == from)
+					p[k] = target;
+			glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+			if (glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after) || glm::dot(after, after) == 0.0f)
+				return true;
+		}
+		return false;
+	}
+};
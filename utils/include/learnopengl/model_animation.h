@@ -11,19 +11,33 @@
 #include <assimp/postprocess.h>
 
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/mesh_simplifier.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture_cache.h>
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <learnopengl/assimp_glm_helpers.h>
 #include <learnopengl/animdata.h>
 
 using namespace std;
 
+// how a Model is built from its file, named so call sites read without counting booleans
+struct ModelLoadOptions
+{
+    bool gammaCorrection = false;
+    bool flipTextures = true;	// flip the images vertically on load, per model instead of stb's global flag (see TextureCache)
+    bool optimizeMeshes = false;	// weld and reorder the vertices and triangles of every mesh on load (see MeshOptimizer)
+    bool packVertices = false;	// upload the meshes in the compact PackedVertex layout, for shaders that apply positionOffset/positionScale
+    bool generateLods = false;	// append simplified levels of detail to every mesh on load (see MeshSimplifier)
+};
+
 class Model 
 {
 public:
@@ -31,31 +45,96 @@ public:
     vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<Mesh>    meshes;
     string directory;
-    bool gammaCorrection;
+    ModelLoadOptions options;
 	
 	
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const &path, const ModelLoadOptions &options = ModelLoadOptions()) : options(options)
     {
         loadModel(path);
     }
 
+    // empty model, filled in by loaders that do not go through Assimp (see BakedAsset)
+    Model()
+    {
+    }
+
+    // builds the model from a scene that is already imported (see AnimationLibrary); path gives the texture directory
+    Model(const aiScene* scene, string const &path, const ModelLoadOptions &options = ModelLoadOptions()) : options(options)
+    {
+        directory = path.substr(0, path.find_last_of('/'));
+        loadTextures(scene);
+        processNode(scene->mRootNode, scene);
+    }
+
     // draws the model, and thus all its meshes
     void Draw(Shader &shader)
     {
         for(unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
     }
+
+    // draws every mesh at its coarsest level of detail within maxError model units, returns the triangles drawn
+    size_t DrawLod(Shader &shader, float maxError)
+    {
+        size_t triangles = 0;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            int lod = meshes[i].selectLod(maxError);
+            meshes[i].Draw(shader, lod);
+            triangles += meshes[i].lods[lod].indexCount / 3;
+        }
+        return triangles;
+    }
+
+    // draws instanceCount copies of the model, one instanced call per mesh
+    void DrawInstanced(Shader &shader, unsigned int instanceCount)
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawInstanced(shader, instanceCount);
+    }
+
+    // DrawInstanced with every mesh at its coarsest level of detail within maxError model units, returns the triangles drawn
+    size_t DrawInstancedLod(Shader &shader, unsigned int instanceCount, float maxError)
+    {
+        size_t triangles = 0;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            int lod = meshes[i].selectLod(maxError);
+            meshes[i].DrawInstanced(shader, instanceCount, lod);
+            triangles += (size_t)meshes[i].lods[lod].indexCount / 3 * instanceCount;
+        }
+        return triangles;
+    }
     
+    // texture at path (relative to directory), shared through the TextureCache with every model that uses the same file
+    Texture loadTexture(const char* path, const string& typeName)
+    {
+        // check if texture was loaded before and if so, skip loading a new texture
+        auto found = m_TextureIndex.find(path);
+        if (found != m_TextureIndex.end())
+            return textures_loaded[found->second];
+        Texture texture;
+        texture.id = TextureCache::Get().Load(this->directory + '/' + path, options.flipTextures);
+        texture.type = typeName;
+        texture.path = path;
+        m_TextureIndex[texture.path] = textures_loaded.size();
+        textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
+        return texture;
+    }
+
 	auto& GetBoneInfoMap() { return m_BoneInfoMap; }
 	int& GetBoneCount() { return m_BoneCounter; }
 	
 
 private:
+	// imports on worker threads through the steps below (see async_model.h)
+	friend class AsyncModelLoader;
 
 	std::map<string, BoneInfo> m_BoneInfoMap;
 	int m_BoneCounter = 0;
+	std::unordered_map<string, size_t> m_TextureIndex;	// path -> index in textures_loaded
 
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
@@ -72,10 +151,39 @@ private:
         // retrieve the directory path of the filepath
         directory = path.substr(0, path.find_last_of('/'));
 
+        // decode all the textures at once, processMesh then finds them in the cache
+        loadTextures(scene);
+
         // process ASSIMP's root node recursively
         processNode(scene->mRootNode, scene);
     }
 
+    // loads the textures of every material the meshes use as one TextureCache batch, so they are decoded in parallel
+    void loadTextures(const aiScene *scene)
+    {
+        static const aiTextureType types[] = { aiTextureType_DIFFUSE, aiTextureType_SPECULAR, aiTextureType_HEIGHT, aiTextureType_AMBIENT };
+        vector<bool> used(scene->mNumMaterials, false);
+        for(unsigned int i = 0; i < scene->mNumMeshes; i++)
+            used[scene->mMeshes[i]->mMaterialIndex] = true;
+
+        vector<TextureRequest> requests;
+        for(unsigned int m = 0; m < scene->mNumMaterials; m++)
+        {
+            if(!used[m])
+                continue;
+            for(aiTextureType type : types)
+            {
+                for(unsigned int i = 0; i < scene->mMaterials[m]->GetTextureCount(type); i++)
+                {
+                    aiString str;
+                    scene->mMaterials[m]->GetTexture(type, i, &str);
+                    requests.push_back(TextureRequest{ directory + '/' + str.C_Str(), options.flipTextures });
+                }
+            }
+        }
+        TextureCache::Get().Load(requests);
+    }
+
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
     void processNode(aiNode *node, const aiScene *scene)
     {
@@ -110,7 +218,28 @@ private:
 		vector<Vertex> vertices;
 		vector<unsigned int> indices;
 		vector<Texture> textures;
+		vector<MeshLod> lods;
+
+		convertMesh(mesh, vertices, indices, lods);
+
+		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+
+		vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+		vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
+		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+		std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
+		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+		std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
+		textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
+		return Mesh(vertices, indices, textures, options.packVertices, lods);
+	}
+
+	// vertex and index streams of a mesh, no GL work : safe on any thread once every bone of the mesh is registered
+	void convertMesh(aiMesh* mesh, vector<Vertex>& vertices, vector<unsigned int>& indices, vector<MeshLod>& lods)
+	{
+		vertices.reserve(mesh->mNumVertices);
 		for (unsigned int i = 0; i < mesh->mNumVertices; i++)
 		{
 			Vertex vertex;
@@ -128,36 +257,45 @@ private:
 			else
 				vertex.TexCoords = glm::vec2(0.0f, 0.0f);
 
+			// every field is set, so equal vertices are bitwise equal for the welding
+			if (mesh->mTangents)
+			{
+				vertex.Tangent = AssimpGLMHelpers::GetGLMVec(mesh->mTangents[i]);
+				vertex.Bitangent = AssimpGLMHelpers::GetGLMVec(mesh->mBitangents[i]);
+			}
+			else
+				vertex.Tangent = vertex.Bitangent = glm::vec3(0.0f);
+
 			vertices.push_back(vertex);
 		}
+		indices.reserve(mesh->mNumFaces * 3);
 		for (unsigned int i = 0; i < mesh->mNumFaces; i++)
 		{
 			aiFace face = mesh->mFaces[i];
 			for (unsigned int j = 0; j < face.mNumIndices; j++)
 				indices.push_back(face.mIndices[j]);
 		}
-		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-
-		vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-		vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-		std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-		std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-		textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
-		ExtractBoneWeightForVertices(vertices,mesh,scene);
+		ExtractBoneWeightForVertices(vertices, mesh, nullptr);
 
-		return Mesh(vertices, indices, textures);
+		if (options.optimizeMeshes)
+			MeshOptimizer::Optimize(vertices, indices);
+		if (options.generateLods)
+			lods = MeshSimplifier::BuildLodChain(vertices, indices);
 	}
 
+	// keeps the MAX_BONE_INFLUENCE strongest influences, sorted by weight so shaders can drop the last ones
 	void SetVertexBoneData(Vertex& vertex, int boneID, float weight)
 	{
 		for (int i = 0; i < MAX_BONE_INFLUENCE; ++i)
 		{
-			if (vertex.m_BoneIDs[i] < 0)
+			if (vertex.m_BoneIDs[i] < 0 || weight > vertex.m_Weights[i])
 			{
+				for (int j = MAX_BONE_INFLUENCE - 1; j > i; --j)
+				{
+					vertex.m_Weights[j] = vertex.m_Weights[j - 1];
+					vertex.m_BoneIDs[j] = vertex.m_BoneIDs[j - 1];
+				}
 				vertex.m_Weights[i] = weight;
 				vertex.m_BoneIDs[i] = boneID;
 				break;
@@ -166,28 +304,26 @@ private:
 	}
 
 
-	void ExtractBoneWeightForVertices(std::vector<Vertex>& vertices, aiMesh* mesh, const aiScene* scene)
+	// id of a bone, added to the bone map on first use. only reads the map when the bone is already there
+	int RegisterBone(aiBone* bone)
 	{
-		auto& boneInfoMap = m_BoneInfoMap;
-		int& boneCount = m_BoneCounter;
+		std::string boneName = bone->mName.C_Str();
+		auto it = m_BoneInfoMap.find(boneName);
+		if (it != m_BoneInfoMap.end())
+			return it->second.id;
+
+		BoneInfo newBoneInfo;
+		newBoneInfo.id = m_BoneCounter;
+		newBoneInfo.offset = AssimpGLMHelpers::ConvertMatrixToGLMFormat(bone->mOffsetMatrix);
+		m_BoneInfoMap[boneName] = newBoneInfo;
+		return m_BoneCounter++;
+	}
 
+	void ExtractBoneWeightForVertices(std::vector<Vertex>& vertices, aiMesh* mesh, const aiScene* scene)
+	{
 		for (int boneIndex = 0; boneIndex < mesh->mNumBones; ++boneIndex)
 		{
-			int boneID = -1;
-			std::string boneName = mesh->mBones[boneIndex]->mName.C_Str();
-			if (boneInfoMap.find(boneName) == boneInfoMap.end())
-			{
-				BoneInfo newBoneInfo;
-				newBoneInfo.id = boneCount;
-				newBoneInfo.offset = AssimpGLMHelpers::ConvertMatrixToGLMFormat(mesh->mBones[boneIndex]->mOffsetMatrix);
-				boneInfoMap[boneName] = newBoneInfo;
-				boneID = boneCount;
-				boneCount++;
-			}
-			else
-			{
-				boneID = boneInfoMap[boneName].id;
-			}
+			int boneID = RegisterBone(mesh->mBones[boneIndex]);
 			assert(boneID != -1);
 			auto weights = mesh->mBones[boneIndex]->mWeights;
 			int numWeights = mesh->mBones[boneIndex]->mNumWeights;
@@ -203,46 +339,6 @@ private:
 	}
 
 
-	unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false)
-	{
-		string filename = string(path);
-		filename = directory + '/' + filename;
-
-		unsigned int textureID;
-		glGenTextures(1, &textureID);
-
-		int width, height, nrComponents;
-		unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-		if (data)
-		{
-			GLenum format = GL_RED;
-			if (nrComponents == 1)
-				format = GL_RED;
-			else if (nrComponents == 3)
-				format = GL_RGB;
-			else if (nrComponents == 4)
-				format = GL_RGBA;
-
-			glBindTexture(GL_TEXTURE_2D, textureID);
-			glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-			glGenerateMipmap(GL_TEXTURE_2D);
-
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-			stbi_image_free(data);
-		}
-		else
-		{
-			std::cout << "Texture failed to load at path: " << path << std::endl;
-			stbi_image_free(data);
-		}
-
-		return textureID;
-	}
-    
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
     // the required info is returned as a Texture struct.
     vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
@@ -252,26 +348,7 @@ private:
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
-            }
+            textures.push_back(loadTexture(str.C_Str(), typeName));
         }
         return textures;
     }
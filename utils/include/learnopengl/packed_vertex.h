@@ -0,0 +1,190 @@
+#pragma once
+
+/* Compact vertex layout for Mesh, 28 bytes instead of the 88 of Vertex */
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/*attribute locations are the ones of Vertex, so shaders keep their inputs :
+
+0 Position  : xyz snorm16 in the mesh's bounds, w the bitangent sign
+1 Normal    : octahedral snorm16
+2 TexCoords : half floats
+3 Tangent   : octahedral snorm16
+4 Bitangent : not stored, cross(Normal, Tangent) * Position.w
+5 BoneIDs   : int8, -1 for no bone as in Vertex
+6 Weights   : unorm8, summing to 255
+
+the position has to be moved back into the mesh's bounds by the vertex
+shader : pos = positionOffset + positionScale * pos. the normal and the
+tangent arrive in the x and y of a vec3 input and have to be decoded. Mesh
+sets positionOffset, positionScale and packedVertex on every draw, to
+identity and false for meshes in the full layout, so one shader draws both.
+
+the demos drawing packed meshes include packed_vertex.glsl, which declares
+the uniforms and does both (unpackPosition, unpackNormal). Mesh warns when
+a packed mesh is drawn with a shader reading a vec3 normal but not
+declaring packedVertex, which would light with (x, y, 0).*/
+struct PackedVertex
+{
+	int16_t Position[4];
+	int16_t Normal[2];
+	int16_t Tangent[2];
+	uint16_t TexCoords[2];
+	int8_t BoneIDs[4];
+	uint8_t Weights[4];
+};
+
+// per-mesh dequantization of PackedVertex::Position
+struct VertexQuantization
+{
+	glm::vec3 offset = glm::vec3(0.0f);
+	glm::vec3 scale = glm::vec3(1.0f);
+};
+
+class VertexPacker
+{
+public:
+	// vertex types with the fields of Vertex; bone ids have to fit an int8
+	template <typename VertexType>
+	static bool CanPack(const VertexType* vertices, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+			for (int k = 0; k < 4; k++)
+				if (vertices[i].m_BoneIDs[k] > 127)
+					return false;
+		return true;
+	}
+
+	template <typename VertexType>
+	static VertexQuantization Pack(const VertexType* vertices, size_t count, std::vector<PackedVertex>& packed)
+	{
+		VertexQuantization quantization;
+		packed.resize(count);
+		if (count == 0)
+			return quantization;
+
+		glm::vec3 lower = vertices[0].Position, upper = vertices[0].Position;
+		for (size_t i = 1; i < count; i++)
+		{
+			lower = glm::min(lower, vertices[i].Position);
+			upper = glm::max(upper, vertices[i].Position);
+		}
+		quantization.offset = (lower + upper) * 0.5f;
+		quantization.scale = glm::max((upper - lower) * 0.5f, glm::vec3(1e-8f));
+
+		for (size_t i = 0; i < count; i++)
+		{
+			const VertexType& v = vertices[i];
+			PackedVertex& p = packed[i];
+			glm::vec3 position = (v.Position - quantization.offset) / quantization.scale;
+			for (int k = 0; k < 3; k++)
+				p.Position[k] = ToSnorm16(position[k]);
+			float handedness = glm::dot(glm::cross(v.Normal, v.Tangent), v.Bitangent);
+			p.Position[3] = handedness < 0.0f ? -32767 : 32767;
+
+			OctEncode(v.Normal, p.Normal);
+			OctEncode(v.Tangent, p.Tangent);
+			p.TexCoords[0] = ToHalf(v.TexCoords.x);
+			p.TexCoords[1] = ToHalf(v.TexCoords.y);
+			PackWeights(v.m_BoneIDs, v.m_Weights, p.BoneIDs, p.Weights);
+		}
+		return quantization;
+	}
+
+	// 16 bit copy of an index buffer, for meshes of up to 65536 vertices
+	static bool PackIndices(const unsigned int* indices, size_t count, size_t vertexCount, std::vector<uint16_t>& packed)
+	{
+		if (vertexCount > 65536)
+			return false;
+		packed.assign(indices, indices + count);
+		return true;
+	}
+
+	static int16_t ToSnorm16(float value)
+	{
+		return (int16_t)std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f);
+	}
+
+	// IEEE half, rounded to nearest. overflows to infinity, underflows through the denormals to zero
+	static uint16_t ToHalf(float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+		int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+		uint32_t mantissa = bits & 0x7fffff;
+
+		if (((bits >> 23) & 0xff) == 0xff)
+			return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+		if (exponent >= 31)
+			return sign | 0x7c00;
+		if (exponent <= 0)
+		{
+			if (exponent < -10)
+				return sign;
+			mantissa |= 0x800000;
+			int shift = 14 - exponent;
+			uint32_t half = mantissa >> shift;
+			uint32_t rest = mantissa & ((1u << shift) - 1);
+			uint32_t middle = 1u << (shift - 1);
+			if (rest > middle || (rest == middle && (half & 1)))
+				half++;
+			return sign | (uint16_t)half;
+		}
+		uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+		uint32_t rest = mantissa & 0x1fff;
+		// a carry out of the mantissa correctly bumps the exponent
+		if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+			half++;
+		return sign | (uint16_t)half;
+	}
+
+	// unit vector folded onto the octahedron, then its xy as snorm16
+	static void OctEncode(const glm::vec3& vector, int16_t out[2])
+	{
+		float sum = std::fabs(vector.x) + std::fabs(vector.y) + std::fabs(vector.z);
+		if (sum == 0.0f)
+		{
+			out[0] = out[1] = 0;
+			return;
+		}
+		float x = vector.x / sum, y = vector.y / sum;
+		if (vector.z < 0.0f)
+		{
+			float fx = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			float fy = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+			x = fx;
+			y = fy;
+		}
+		out[0] = ToSnorm16(x);
+		out[1] = ToSnorm16(y);
+	}
+
+private:
+	// rounds the weights so they still sum to 255, the rounding error going to the largest
+	static void PackWeights(const int* boneIDs, const float* weights, int8_t outIDs[4], uint8_t outWeights[4])
+	{
+		float total = 0.0f;
+		for (int k = 0; k < 4; k++)
+			if (boneIDs[k] >= 0)
+				total += weights[k];
+
+		int sum = 0, largest = -1;
+		for (int k = 0; k < 4; k++)
+		{
+			outIDs[k] = (int8_t)(boneIDs[k] >= 0 ? boneIDs[k] : -1);
+			int weight = boneIDs[k] >= 0 && total > 0.0f ? (int)std::lround(weights[k] / total * 255.0f) : 0;
+			outWeights[k] = (uint8_t)weight;
+			sum += weight;
+			if (boneIDs[k] >= 0 && (largest < 0 || weights[k] > weights[largest]))
+				largest = k;
+		}
+		if (largest >= 0)
+			outWeights[largest] = (uint8_t)(outWeights[largest] + 255 - sum);
+	}
+};
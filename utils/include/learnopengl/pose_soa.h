@@ -0,0 +1,364 @@
+#pragma once
+
+/* Structure-of-arrays pose and SIMD sampling kernels for bone channels */
+
+#include <glm/glm.hpp>
+#include <cstdlib>
+#include <cmath>
+#include <new>
+#include <vector>
+#include <algorithm>
+#include <learnopengl/bone.h>
+#include <learnopengl/animation.h>
+
+/*the kernels process POSE_SIMD_WIDTH bones per instruction : 8 with AVX2,
+4 with SSE2 and 1 (plain floats) everywhere else. every array is padded to a
+multiple of 8 so all widths can run over the same data. defining
+POSE_SIMD_WIDTH before the include forces a narrower width, which is how the
+SSE2 and scalar kernels get checked on an AVX2 machine.*/
+#if !defined(POSE_SIMD_WIDTH)
+#if defined(__AVX2__)
+#define POSE_SIMD_WIDTH 8
+#elif defined(__SSE2__) || defined(_M_X64)
+#define POSE_SIMD_WIDTH 4
+#else
+#define POSE_SIMD_WIDTH 1
+#endif
+#endif
+
+#if POSE_SIMD_WIDTH == 8
+#include <immintrin.h>
+typedef __m256 PoseVec;
+inline PoseVec PoseLoad(const float* p) { return _mm256_load_ps(p); }
+inline void PoseStore(float* p, PoseVec v) { _mm256_store_ps(p, v); }
+inline PoseVec PoseSet1(float s) { return _mm256_set1_ps(s); }
+inline PoseVec PoseAdd(PoseVec a, PoseVec b) { return _mm256_add_ps(a, b); }
+inline PoseVec PoseSub(PoseVec a, PoseVec b) { return _mm256_sub_ps(a, b); }
+inline PoseVec PoseMul(PoseVec a, PoseVec b) { return _mm256_mul_ps(a, b); }
+inline PoseVec PoseDiv(PoseVec a, PoseVec b) { return _mm256_div_ps(a, b); }
+inline PoseVec PoseSqrt(PoseVec a) { return _mm256_sqrt_ps(a); }
+// v with its sign flipped in every lane where s is negative
+inline PoseVec PoseFlipSign(PoseVec v, PoseVec s) { return _mm256_xor_ps(v, _mm256_and_ps(s, _mm256_set1_ps(-0.0f))); }
+// base[offsets[i]] in every lane i, offsets 32 byte aligned
+inline PoseVec PoseGather(const float* base, const int* offsets) { return _mm256_i32gather_ps(base, _mm256_load_si256((const __m256i*)offsets), 4); }
+#elif POSE_SIMD_WIDTH == 4
+#include <emmintrin.h>
+typedef __m128 PoseVec;
+inline PoseVec PoseLoad(const float* p) { return _mm_load_ps(p); }
+inline void PoseStore(float* p, PoseVec v) { _mm_store_ps(p, v); }
+inline PoseVec PoseSet1(float s) { return _mm_set1_ps(s); }
+inline PoseVec PoseAdd(PoseVec a, PoseVec b) { return _mm_add_ps(a, b); }
+inline PoseVec PoseSub(PoseVec a, PoseVec b) { return _mm_sub_ps(a, b); }
+inline PoseVec PoseMul(PoseVec a, PoseVec b) { return _mm_mul_ps(a, b); }
+inline PoseVec PoseDiv(PoseVec a, PoseVec b) { return _mm_div_ps(a, b); }
+inline PoseVec PoseSqrt(PoseVec a) { return _mm_sqrt_ps(a); }
+inline PoseVec PoseFlipSign(PoseVec v, PoseVec s) { return _mm_xor_ps(v, _mm_and_ps(s, _mm_set1_ps(-0.0f))); }
+inline PoseVec PoseGather(const float* base, const int* offsets) { return _mm_setr_ps(base[offsets[0]], base[offsets[1]], base[offsets[2]], base[offsets[3]]); }
+#else
+typedef float PoseVec;
+inline PoseVec PoseLoad(const float* p) { return *p; }
+inline void PoseStore(float* p, PoseVec v) { *p = v; }
+inline PoseVec PoseSet1(float s) { return s; }
+inline PoseVec PoseAdd(PoseVec a, PoseVec b) { return a + b; }
+inline PoseVec PoseSub(PoseVec a, PoseVec b) { return a - b; }
+inline PoseVec PoseMul(PoseVec a, PoseVec b) { return a * b; }
+inline PoseVec PoseDiv(PoseVec a, PoseVec b) { return a / b; }
+inline PoseVec PoseSqrt(PoseVec a) { return std::sqrt(a); }
+inline PoseVec PoseFlipSign(PoseVec v, PoseVec s) { return s < 0.0f ? -v : v; }
+inline PoseVec PoseGather(const float* base, const int* offsets) { return base[*offsets]; }
+#endif
+
+#define POSE_PADDING 8
+
+// minimal allocator giving the 32 byte alignment the AVX loads need
+template<typename T>
+struct PoseAllocator
+{
+	typedef T value_type;
+
+	PoseAllocator() = default;
+	template<typename U> PoseAllocator(const PoseAllocator<U>&) {}
+
+	T* allocate(size_t n)
+	{
+		void* p = ::operator new(n * sizeof(T), std::align_val_t(32));
+		return static_cast<T*>(p);
+	}
+	void deallocate(T* p, size_t) { ::operator delete(p, std::align_val_t(32)); }
+
+	template<typename U> bool operator==(const PoseAllocator<U>&) const { return true; }
+	template<typename U> bool operator!=(const PoseAllocator<U>&) const { return false; }
+};
+
+typedef std::vector<float, PoseAllocator<float>> PoseFloats;
+typedef std::vector<int, PoseAllocator<int>> PoseInts;
+
+/*local transforms of all bone channels, one array per component*/
+struct PoseSoA
+{
+	int count = 0;	//number of bones
+	int padded = 0;	//array length, count rounded up to POSE_PADDING
+
+	PoseFloats tx, ty, tz;
+	PoseFloats qx, qy, qz, qw;
+	PoseFloats sx, sy, sz;
+
+	void Resize(int numBones)
+	{
+		count = numBones;
+		padded = (numBones + POSE_PADDING - 1) / POSE_PADDING * POSE_PADDING;
+
+		//padding lanes hold the identity so the kernels never divide by zero
+		tx.assign(padded, 0.0f); ty.assign(padded, 0.0f); tz.assign(padded, 0.0f);
+		qx.assign(padded, 0.0f); qy.assign(padded, 0.0f); qz.assign(padded, 0.0f); qw.assign(padded, 1.0f);
+		sx.assign(padded, 1.0f); sy.assign(padded, 1.0f); sz.assign(padded, 1.0f);
+	}
+
+	void Set(int bone, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+	{
+		tx[bone] = position.x; ty[bone] = position.y; tz[bone] = position.z;
+		qx[bone] = rotation.x; qy[bone] = rotation.y; qz[bone] = rotation.z; qw[bone] = rotation.w;
+		sx[bone] = scale.x; sy[bone] = scale.y; sz[bone] = scale.z;
+	}
+
+	void Copy(int bone, const PoseSoA& src, int srcBone)
+	{
+		tx[bone] = src.tx[srcBone]; ty[bone] = src.ty[srcBone]; tz[bone] = src.tz[srcBone];
+		qx[bone] = src.qx[srcBone]; qy[bone] = src.qy[srcBone]; qz[bone] = src.qz[srcBone]; qw[bone] = src.qw[srcBone];
+		sx[bone] = src.sx[srcBone]; sy[bone] = src.sy[srcBone]; sz[bone] = src.sz[srcBone];
+	}
+
+	void Clear()
+	{
+		std::fill(tx.begin(), tx.end(), 0.0f); std::fill(ty.begin(), ty.end(), 0.0f); std::fill(tz.begin(), tz.end(), 0.0f);
+		std::fill(qx.begin(), qx.end(), 0.0f); std::fill(qy.begin(), qy.end(), 0.0f); std::fill(qz.begin(), qz.end(), 0.0f); std::fill(qw.begin(), qw.end(), 0.0f);
+		std::fill(sx.begin(), sx.end(), 0.0f); std::fill(sy.begin(), sy.end(), 0.0f); std::fill(sz.begin(), sz.end(), 0.0f);
+	}
+};
+
+/*out = a + (b - a) * t per lane*/
+inline void PoseLerp(const float* a, const float* b, const float* t, float* out, int padded)
+{
+	for (int i = 0; i < padded; i += POSE_SIMD_WIDTH)
+	{
+		PoseVec va = PoseLoad(a + i);
+		PoseStore(out + i, PoseAdd(va, PoseMul(PoseSub(PoseLoad(b + i), va), PoseLoad(t + i))));
+	}
+}
+
+/*normalized lerp along the shortest arc, per lane. for the small angles
+between neighbouring keys it stays within float noise of glm::slerp*/
+inline void PoseNlerp(const PoseSoA& a, const PoseSoA& b, const float* t, PoseSoA& out)
+{
+	for (int i = 0; i < a.padded; i += POSE_SIMD_WIDTH)
+	{
+		PoseVec ax = PoseLoad(&a.qx[i]), ay = PoseLoad(&a.qy[i]), az = PoseLoad(&a.qz[i]), aw = PoseLoad(&a.qw[i]);
+		PoseVec bx = PoseLoad(&b.qx[i]), by = PoseLoad(&b.qy[i]), bz = PoseLoad(&b.qz[i]), bw = PoseLoad(&b.qw[i]);
+		PoseVec d = PoseAdd(PoseAdd(PoseMul(ax, bx), PoseMul(ay, by)), PoseAdd(PoseMul(az, bz), PoseMul(aw, bw)));
+		bx = PoseFlipSign(bx, d); by = PoseFlipSign(by, d); bz = PoseFlipSign(bz, d); bw = PoseFlipSign(bw, d);
+
+		PoseVec vt = PoseLoad(t + i);
+		PoseVec x = PoseAdd(ax, PoseMul(PoseSub(bx, ax), vt));
+		PoseVec y = PoseAdd(ay, PoseMul(PoseSub(by, ay), vt));
+		PoseVec z = PoseAdd(az, PoseMul(PoseSub(bz, az), vt));
+		PoseVec w = PoseAdd(aw, PoseMul(PoseSub(bw, aw), vt));
+
+		PoseVec len = PoseSqrt(PoseAdd(PoseAdd(PoseMul(x, x), PoseMul(y, y)), PoseAdd(PoseMul(z, z), PoseMul(w, w))));
+		PoseStore(&out.qx[i], PoseDiv(x, len));
+		PoseStore(&out.qy[i], PoseDiv(y, len));
+		PoseStore(&out.qz[i], PoseDiv(z, len));
+		PoseStore(&out.qw[i], PoseDiv(w, len));
+	}
+}
+
+/*acc += pose * weights per lane, weightSum += weights. rotations are flipped
+onto the hemisphere of what is already accumulated before they are added*/
+inline void PoseAccumulate(const PoseSoA& pose, const float* weights, PoseSoA& acc, float* weightSum)
+{
+	for (int i = 0; i < pose.padded; i += POSE_SIMD_WIDTH)
+	{
+		PoseVec w = PoseLoad(weights + i);
+		PoseStore(weightSum + i, PoseAdd(PoseLoad(weightSum + i), w));
+
+		PoseStore(&acc.tx[i], PoseAdd(PoseLoad(&acc.tx[i]), PoseMul(PoseLoad(&pose.tx[i]), w)));
+		PoseStore(&acc.ty[i], PoseAdd(PoseLoad(&acc.ty[i]), PoseMul(PoseLoad(&pose.ty[i]), w)));
+		PoseStore(&acc.tz[i], PoseAdd(PoseLoad(&acc.tz[i]), PoseMul(PoseLoad(&pose.tz[i]), w)));
+		PoseStore(&acc.sx[i], PoseAdd(PoseLoad(&acc.sx[i]), PoseMul(PoseLoad(&pose.sx[i]), w)));
+		PoseStore(&acc.sy[i], PoseAdd(PoseLoad(&acc.sy[i]), PoseMul(PoseLoad(&pose.sy[i]), w)));
+		PoseStore(&acc.sz[i], PoseAdd(PoseLoad(&acc.sz[i]), PoseMul(PoseLoad(&pose.sz[i]), w)));
+
+		PoseVec ax = PoseLoad(&acc.qx[i]), ay = PoseLoad(&acc.qy[i]), az = PoseLoad(&acc.qz[i]), aw = PoseLoad(&acc.qw[i]);
+		PoseVec bx = PoseLoad(&pose.qx[i]), by = PoseLoad(&pose.qy[i]), bz = PoseLoad(&pose.qz[i]), bw = PoseLoad(&pose.qw[i]);
+		PoseVec d = PoseAdd(PoseAdd(PoseMul(ax, bx), PoseMul(ay, by)), PoseAdd(PoseMul(az, bz), PoseMul(aw, bw)));
+		PoseVec sw = PoseFlipSign(w, d);
+		PoseStore(&acc.qx[i], PoseAdd(ax, PoseMul(bx, sw)));
+		PoseStore(&acc.qy[i], PoseAdd(ay, PoseMul(by, sw)));
+		PoseStore(&acc.qz[i], PoseAdd(az, PoseMul(bz, sw)));
+		PoseStore(&acc.qw[i], PoseAdd(aw, PoseMul(bw, sw)));
+	}
+}
+
+/*turns an accumulated pose into a weighted average. lanes with a zero
+weightSum come out as NaN and have to be overwritten by the caller*/
+inline void PoseNormalizeBlend(PoseSoA& acc, const float* weightSum)
+{
+	for (int i = 0; i < acc.padded; i += POSE_SIMD_WIDTH)
+	{
+		PoseVec w = PoseLoad(weightSum + i);
+		PoseStore(&acc.tx[i], PoseDiv(PoseLoad(&acc.tx[i]), w));
+		PoseStore(&acc.ty[i], PoseDiv(PoseLoad(&acc.ty[i]), w));
+		PoseStore(&acc.tz[i], PoseDiv(PoseLoad(&acc.tz[i]), w));
+		PoseStore(&acc.sx[i], PoseDiv(PoseLoad(&acc.sx[i]), w));
+		PoseStore(&acc.sy[i], PoseDiv(PoseLoad(&acc.sy[i]), w));
+		PoseStore(&acc.sz[i], PoseDiv(PoseLoad(&acc.sz[i]), w));
+
+		PoseVec x = PoseLoad(&acc.qx[i]), y = PoseLoad(&acc.qy[i]), z = PoseLoad(&acc.qz[i]), q = PoseLoad(&acc.qw[i]);
+		PoseVec len = PoseSqrt(PoseAdd(PoseAdd(PoseMul(x, x), PoseMul(y, y)), PoseAdd(PoseMul(z, z), PoseMul(q, q))));
+		PoseStore(&acc.qx[i], PoseDiv(x, len));
+		PoseStore(&acc.qy[i], PoseDiv(y, len));
+		PoseStore(&acc.qz[i], PoseDiv(z, len));
+		PoseStore(&acc.qw[i], PoseDiv(q, len));
+	}
+}
+
+/*builds translation * rotation * scale for every bone of the pose, laid out
+exactly like glm::translate * glm::toMat4 * glm::scale*/
+inline void PoseCompose(const PoseSoA& pose, glm::mat4* localTransforms)
+{
+	alignas(32) float cols[12][POSE_SIMD_WIDTH];
+	PoseVec one = PoseSet1(1.0f), two = PoseSet1(2.0f);
+
+	for (int i = 0; i < pose.padded; i += POSE_SIMD_WIDTH)
+	{
+		PoseVec x = PoseLoad(&pose.qx[i]), y = PoseLoad(&pose.qy[i]), z = PoseLoad(&pose.qz[i]), w = PoseLoad(&pose.qw[i]);
+		PoseVec sx = PoseLoad(&pose.sx[i]), sy = PoseLoad(&pose.sy[i]), sz = PoseLoad(&pose.sz[i]);
+
+		PoseVec xx = PoseMul(x, x), yy = PoseMul(y, y), zz = PoseMul(z, z);
+		PoseVec xy = PoseMul(x, y), xz = PoseMul(x, z), yz = PoseMul(y, z);
+		PoseVec wx = PoseMul(w, x), wy = PoseMul(w, y), wz = PoseMul(w, z);
+
+		PoseStore(cols[0], PoseMul(PoseSub(one, PoseMul(two, PoseAdd(yy, zz))), sx));
+		PoseStore(cols[1], PoseMul(PoseMul(two, PoseAdd(xy, wz)), sx));
+		PoseStore(cols[2], PoseMul(PoseMul(two, PoseSub(xz, wy)), sx));
+		PoseStore(cols[3], PoseMul(PoseMul(two, PoseSub(xy, wz)), sy));
+		PoseStore(cols[4], PoseMul(PoseSub(one, PoseMul(two, PoseAdd(xx, zz))), sy));
+		PoseStore(cols[5], PoseMul(PoseMul(two, PoseAdd(yz, wx)), sy));
+		PoseStore(cols[6], PoseMul(PoseMul(two, PoseAdd(xz, wy)), sz));
+		PoseStore(cols[7], PoseMul(PoseMul(two, PoseSub(yz, wx)), sz));
+		PoseStore(cols[8], PoseMul(PoseSub(one, PoseMul(two, PoseAdd(xx, yy))), sz));
+		PoseStore(cols[9], PoseLoad(&pose.tx[i]));
+		PoseStore(cols[10], PoseLoad(&pose.ty[i]));
+		PoseStore(cols[11], PoseLoad(&pose.tz[i]));
+
+		int lanes = pose.count - i < POSE_SIMD_WIDTH ? pose.count - i : POSE_SIMD_WIDTH;
+		for (int l = 0; l < lanes; l++)
+		{
+			glm::mat4& m = localTransforms[i + l];
+			m[0] = glm::vec4(cols[0][l], cols[1][l], cols[2][l], 0.0f);
+			m[1] = glm::vec4(cols[3][l], cols[4][l], cols[5][l], 0.0f);
+			m[2] = glm::vec4(cols[6][l], cols[7][l], cols[8][l], 0.0f);
+			m[3] = glm::vec4(cols[9][l], cols[10][l], cols[11][l], 1.0f);
+		}
+	}
+}
+
+/*samples every bone channel of an animation into a PoseSoA. the key search
+stays scalar (each channel has its own key times); interpolation of all
+channels then runs through the SIMD kernels above. one sampler per thread,
+it only holds scratch memory*/
+class PoseSampler
+{
+public:
+	// channels with a non-zero entry in skipChannels are not sampled, their lanes of pose are left undefined
+	void Sample(const Animation& animation, float animationTime, BoneCursor* cursors, PoseSoA& pose,
+		const char* skipChannels = NULL)
+	{
+		int numChannels = animation.GetBoneChannelCount();
+		Reserve(numChannels);
+		if (pose.count != numChannels)
+			pose.Resize(numChannels);
+
+		const CompressedClip* compressed = animation.GetCompressedClip();
+		if (compressed)
+		{
+			for (int i = 0; i < numChannels; i++)
+			{
+				if (!skipChannels || !skipChannels[i])
+					GatherCompressedKeys(*compressed, animationTime, cursors[i], i);
+			}
+		}
+		else
+		{
+			for (int i = 0; i < numChannels; i++)
+			{
+				if (!skipChannels || !skipChannels[i])
+					GatherKeys(animation.GetBone(i), animationTime, cursors[i], i);
+			}
+		}
+
+		int padded = m_Key0.padded;
+		PoseLerp(m_Key0.tx.data(), m_Key1.tx.data(), m_PositionFactor.data(), pose.tx.data(), padded);
+		PoseLerp(m_Key0.ty.data(), m_Key1.ty.data(), m_PositionFactor.data(), pose.ty.data(), padded);
+		PoseLerp(m_Key0.tz.data(), m_Key1.tz.data(), m_PositionFactor.data(), pose.tz.data(), padded);
+		PoseNlerp(m_Key0, m_Key1, m_RotationFactor.data(), pose);
+		PoseLerp(m_Key0.sx.data(), m_Key1.sx.data(), m_ScaleFactor.data(), pose.sx.data(), padded);
+		PoseLerp(m_Key0.sy.data(), m_Key1.sy.data(), m_ScaleFactor.data(), pose.sy.data(), padded);
+		PoseLerp(m_Key0.sz.data(), m_Key1.sz.data(), m_ScaleFactor.data(), pose.sz.data(), padded);
+	}
+
+	// sizes the scratch for animations of numChannels channels, which Sample otherwise does on its first call
+	void Reserve(int numChannels)
+	{
+		if (m_Key0.count == numChannels)
+			return;
+		m_Key0.Resize(numChannels);
+		m_Key1.Resize(numChannels);
+		m_PositionFactor.assign(m_Key0.padded, 0.0f);
+		m_RotationFactor.assign(m_Key0.padded, 0.0f);
+		m_ScaleFactor.assign(m_Key0.padded, 0.0f);
+	}
+
+private:
+	template<typename KeyType>
+	static void FindKeyPair(const std::vector<KeyType>& keys, float animationTime, int& cursor,
+		const KeyType*& key0, const KeyType*& key1, float& factor)
+	{
+		if (keys.size() < 2)
+		{
+			key0 = key1 = keys.empty() ? &IdentityKey(keys) : &keys[0];
+			factor = 0.0f;
+			return;
+		}
+		int index = Bone::FindKeyIndex(keys, animationTime, cursor);
+		key0 = &keys[index];
+		key1 = &keys[index + 1];
+		factor = Bone::GetScaleFactor(key0->timeStamp, key1->timeStamp, animationTime);
+	}
+
+	void GatherKeys(const Bone& bone, float animationTime, BoneCursor& cursor, int i)
+	{
+		const KeyPosition *p0, *p1;
+		FindKeyPair(bone.GetPositionKeys(), animationTime, cursor.position, p0, p1, m_PositionFactor[i]);
+		const KeyRotation *r0, *r1;
+		FindKeyPair(bone.GetRotationKeys(), animationTime, cursor.rotation, r0, r1, m_RotationFactor[i]);
+		const KeyScale *s0, *s1;
+		FindKeyPair(bone.GetScaleKeys(), animationTime, cursor.scale, s0, s1, m_ScaleFactor[i]);
+
+		m_Key0.Set(i, p0->position, r0->orientation, s0->scale);
+		m_Key1.Set(i, p1->position, r1->orientation, s1->scale);
+	}
+
+	void GatherCompressedKeys(const CompressedClip& compressed, float animationTime, BoneCursor& cursor, int i)
+	{
+		glm::vec3 p0, p1, s0, s1;
+		glm::quat r0, r1;
+		compressed.GatherKeys(i, animationTime, cursor, p0, p1, m_PositionFactor[i],
+			r0, r1, m_RotationFactor[i], s0, s1, m_ScaleFactor[i]);
+
+		m_Key0.Set(i, p0, r0, s0);
+		m_Key1.Set(i, p1, r1, s1);
+	}
+
+	PoseSoA m_Key0, m_Key1;
+	PoseFloats m_PositionFactor, m_RotationFactor, m_ScaleFactor;
+};
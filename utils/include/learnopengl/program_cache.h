@@ -0,0 +1,269 @@
+#pragma once
+
+/* Linked program binaries kept on disk, so the Shader classes skip compiling and linking on later runs */
+
+#include <glad/glad.h>
+#include <learnopengl/cache_directory.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// what the cache did since the last ResetStats
+struct ProgramCacheStats
+{
+	unsigned int hits = 0;		// programs loaded from a binary
+	unsigned int misses = 0;	// no binary for the key, linked from source
+	unsigned int rejected = 0;	// a binary the driver refused (new driver, other GPU), linked from source
+	unsigned int stored = 0;	// binaries written after a link from source
+	unsigned int pruned = 0;	// binaries removed by Prune
+};
+
+/*programs are keyed by a hash of their sources (stage by stage, so any
+#define put into them is part of the key), extra defines given apart, and
+the driver identity : GL_VENDOR, GL_RENDERER, GL_VERSION and the GLSL
+version, so a driver update misses rather than loading stale binaries. a
+driver may still refuse a binary; the Shader then links from source as if
+nothing was cached, and its Store replaces the file.
+
+one file per program in the cache directory, which SetDirectory creates
+(demos use an ignored shader_cache/ next to their sources). the cache is
+off until SetDirectory, and stays off where the context cannot return
+program binaries (before GL 4.1, or with no binary format, as on macOS).
+
+a key changes with the sources and the driver, so old binaries are never
+loaded again but stay on disk : once every program of a run has been
+created, Prune removes the files of the keys the run did not ask for.
+
+a Shader constructor does, on the GL thread :
+	key = Key(sources); if (!Load(program, key)) { compile, attach, PrepareLink(program), link, Store(program, key) }*/
+class ProgramCache
+{
+public:
+	static ProgramCache& Get()
+	{
+		static ProgramCache cache;
+		return cache;
+	}
+
+	ProgramCache(const ProgramCache&) = delete;
+	ProgramCache& operator=(const ProgramCache&) = delete;
+
+	// GL thread. caches the programs linked from now on in directory, "" turns the cache off; returns whether it is on
+	bool SetDirectory(const std::string& directory)
+	{
+		m_Directory = directory;
+		m_UsedKeys.clear();
+		m_Enabled = !directory.empty() && IsSupported() && MakeCacheDirectory(directory);
+		if (m_Enabled)
+			m_DriverHash = DriverHash();
+		return m_Enabled;
+	}
+
+	const std::string& GetDirectory() const { return m_Directory; }
+	bool IsEnabled() const { return m_Enabled; }
+
+	// the program's sources in stage order, empty for the stages it does not have
+	uint64_t Key(const std::vector<std::string>& sources, const std::string& defines = "") const
+	{
+		if (!m_Enabled)
+			return 0;
+		uint32_t version = FILE_VERSION;
+		uint64_t hash = Hash(&version, sizeof(version), m_DriverHash);
+		for (const std::string& source : sources)
+		{
+			uint64_t size = source.size();
+			hash = Hash(&size, sizeof(size), hash);
+			hash = Hash(source.data(), source.size(), hash);
+		}
+		return Hash(defines.data(), defines.size(), hash);
+	}
+
+	// GL thread. program is a new program object; false when it has to be linked from source
+	bool Load(GLuint program, uint64_t key)
+	{
+		if (!m_Enabled)
+			return false;
+		m_UsedKeys.insert(key);
+#ifdef GL_VERSION_4_1
+		std::ifstream in(PathOf(key), std::ios::binary);
+		FileHeader header;
+		if (!in || !in.read((char*)&header, sizeof(header)) || header.magic != FILE_MAGIC ||
+			header.version != FILE_VERSION || header.key != key || header.length == 0)
+		{
+			m_Stats.misses++;
+			return false;
+		}
+		std::vector<char> binary(header.length);
+		if (!in.read(binary.data(), binary.size()))
+		{
+			m_Stats.misses++;
+			return false;
+		}
+
+		glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+		GLint success = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			m_Stats.rejected++;
+			return false;
+		}
+		m_Stats.hits++;
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	// GL thread. before linking from source, so the driver keeps what Store asks for
+	void PrepareLink(GLuint program) const
+	{
+#ifdef GL_VERSION_4_1
+		if (m_Enabled)
+			glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+	}
+
+	// GL thread. after linking from source; writes nothing for a program that failed to link
+	bool Store(GLuint program, uint64_t key)
+	{
+		if (!m_Enabled)
+			return false;
+		m_UsedKeys.insert(key);
+#ifdef GL_VERSION_4_1
+		GLint success = 0, length = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (!success || length <= 0)
+			return false;
+		std::vector<char> binary(length);
+		FileHeader header;
+		header.magic = FILE_MAGIC;
+		header.version = FILE_VERSION;
+		header.key = key;
+		GLsizei written = 0;
+		glGetProgramBinary(program, length, &written, &header.format, binary.data());
+		if (written <= 0)
+			return false;
+		header.length = (uint32_t)written;
+
+		// per thread, two processes may store the same program at once
+		std::string path = PathOf(key);
+		std::string tmpPath = path + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+		{
+			std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+			if (!out)
+				return false;
+			out.write((const char*)&header, sizeof(header));
+			out.write(binary.data(), written);
+			if (!out)
+				return false;
+		}
+		if (std::rename(tmpPath.c_str(), path.c_str()) != 0)
+			return false;
+		m_Stats.stored++;
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	/*removes the binaries of every key not loaded or stored since SetDirectory :
+	programs of edited sources or of another driver. call it once the run has
+	created all the programs it uses, those it creates later are linked again
+	next time. returns the number of files removed*/
+	unsigned int Prune()
+	{
+		if (!m_Enabled)
+			return 0;
+		unsigned int pruned = 0;
+		for (const std::string& name : ListCacheDirectory(m_Directory, ".program"))
+		{
+			// PathOf names : 16 hex digits and the suffix
+			std::string digits = name.substr(0, name.find('.'));
+			char* end = NULL;
+			uint64_t key = std::strtoull(digits.c_str(), &end, 16);
+			if (digits.size() != 16 || *end || m_UsedKeys.count(key))
+				continue;
+			if (std::remove((m_Directory + "/" + name).c_str()) == 0)
+				pruned++;
+		}
+		m_Stats.pruned += pruned;
+		return pruned;
+	}
+
+	const ProgramCacheStats& GetStats() const { return m_Stats; }
+	void ResetStats() { m_Stats = ProgramCacheStats(); }
+
+private:
+	ProgramCache()
+	{
+	}
+
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key;
+		GLenum format;
+		uint32_t length;	// bytes of binary after the header
+	};
+
+	static const uint32_t FILE_MAGIC = 0x4e494250;	// "PBIN"
+	static const uint32_t FILE_VERSION = 1;
+
+	static bool IsSupported()
+	{
+#ifdef GL_VERSION_4_1
+		if (!GLAD_GL_VERSION_4_1)
+			return false;
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		return formats > 0;
+#else
+		return false;
+#endif
+	}
+
+	static uint64_t DriverHash()
+	{
+		uint64_t hash = 14695981039346656037ull;
+		const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION };
+		for (GLenum name : names)
+		{
+			const char* value = (const char*)glGetString(name);
+			if (value)
+				hash = Hash(value, std::strlen(value) + 1, hash);
+		}
+		return hash;
+	}
+
+	// 64 bit FNV-1a
+	static uint64_t Hash(const void* bytes, size_t size, uint64_t hash)
+	{
+		const unsigned char* p = (const unsigned char*)bytes;
+		for (size_t i = 0; i < size; i++)
+			hash = (hash ^ p[i]) * 1099511628211ull;
+		return hash;
+	}
+
+	std::string PathOf(uint64_t key) const
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "/%016llx.program", (unsigned long long)key);
+		return m_Directory + name;
+	}
+
+	std::string m_Directory;
+	bool m_Enabled = false;
+	uint64_t m_DriverHash = 0;
+	std::unordered_set<uint64_t> m_UsedKeys;	// looked up since SetDirectory
+	ProgramCacheStats m_Stats;
+};
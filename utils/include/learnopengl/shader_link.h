@@ -0,0 +1,114 @@
+#pragma once
+
+/* Shader compiles and links that the Shader classes submit without waiting for them */
+
+#include <glad/glad.h>
+#include <iostream>
+#include <string>
+
+// one compiled stage of a program, checked with the program's link
+struct ShaderStage
+{
+	GLuint shader;
+	const char* type;	// "VERTEX", "FRAGMENT", ... for the error messages
+};
+
+/*by default a Shader constructor compiles, links and checks its program
+before returning, which waits for the driver on every program in turn.
+with deferred links on, it returns right after glLinkProgram, so the driver
+works through every program while the application goes on loading models
+and textures; the checks (error messages, binary cache, uniform reflection)
+happen at the program's first use() or uniform lookup, which only waits for
+a link not finished by then.
+
+with GL_KHR_parallel_shader_compile (or the ARB version) the driver compiles
+on its own threads, and IsComplete asks GL_COMPLETION_STATUS without
+blocking; otherwise it cannot tell, and a link counts as complete since the
+first use will finish it anyway.*/
+class ShaderLinking
+{
+public:
+	static ShaderLinking& Get()
+	{
+		static ShaderLinking linking;
+		return linking;
+	}
+
+	ShaderLinking(const ShaderLinking&) = delete;
+	ShaderLinking& operator=(const ShaderLinking&) = delete;
+
+	// GL thread. defers the checks of the programs constructed from now on; returns whether the driver compiles in parallel
+	bool SetDeferred(bool defer)
+	{
+		m_Deferred = defer;
+		m_Parallel = false;
+#if defined(GL_KHR_parallel_shader_compile)
+		if (defer && GLAD_GL_KHR_parallel_shader_compile)
+		{
+			// as many compiler threads as the driver wants
+			glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+			m_CompletionStatus = GL_COMPLETION_STATUS_KHR;
+			m_Parallel = true;
+		}
+#endif
+#if defined(GL_ARB_parallel_shader_compile)
+		if (defer && !m_Parallel && GLAD_GL_ARB_parallel_shader_compile)
+		{
+			glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+			m_CompletionStatus = GL_COMPLETION_STATUS_ARB;
+			m_Parallel = true;
+		}
+#endif
+		return m_Parallel;
+	}
+
+	bool IsDeferred() const { return m_Deferred; }
+	bool IsParallel() const { return m_Parallel; }
+
+	// whether the link of program is done, never blocking
+	bool IsComplete(GLuint program) const
+	{
+		if (!m_Parallel)
+			return true;
+		GLint complete = GL_TRUE;
+		glGetProgramiv(program, m_CompletionStatus, &complete);
+		return complete == GL_TRUE;
+	}
+
+	// waits for the stage's compile; reports and returns false when it failed
+	static bool CheckCompile(const ShaderStage& stage)
+	{
+		GLint success;
+		GLchar infoLog[1024];
+		glGetShaderiv(stage.shader, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			glGetShaderInfoLog(stage.shader, 1024, NULL, infoLog);
+			std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << stage.type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+		}
+		return success != 0;
+	}
+
+	// waits for the program's link; reports and returns false when it failed
+	static bool CheckLink(GLuint program)
+	{
+		GLint success;
+		GLchar infoLog[1024];
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			glGetProgramInfoLog(program, 1024, NULL, infoLog);
+			std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: PROGRAM\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+		}
+		return success != 0;
+	}
+
+private:
+	ShaderLinking()
+	{
+	}
+
+	bool m_Deferred = false;
+	bool m_Parallel = false;
+	GLenum m_CompletionStatus = 0;
+};
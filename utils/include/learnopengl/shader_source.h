@@ -0,0 +1,156 @@
+#pragma once
+
+/* GLSL source as the Shader classes compile it : #include lines resolved, a variant's #defines injected */
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// the #defines of a shader variant, kept sorted so equal sets give equal keys
+class ShaderDefines
+{
+public:
+	ShaderDefines& Set(const std::string& name, int value = 1)
+	{
+		m_Values[name] = std::to_string(value);
+		return *this;
+	}
+
+	ShaderDefines& Set(const std::string& name, const std::string& value)
+	{
+		m_Values[name] = value;
+		return *this;
+	}
+
+	bool IsEmpty() const { return m_Values.empty(); }
+
+	// one "#define NAME VALUE" line per define
+	std::string ToSource() const
+	{
+		std::string source;
+		for (const auto& define : m_Values)
+			source += "#define " + define.first + " " + define.second + "\n";
+		return source;
+	}
+
+	// "NAME=VALUE;..." in name order, the empty string without defines
+	std::string Key() const
+	{
+		std::string key;
+		for (const auto& define : m_Values)
+			key += define.first + "=" + define.second + ";";
+		return key;
+	}
+
+private:
+	std::map<std::string, std::string> m_Values;
+};
+
+/*Process turns the text of a shader file into the source handed to GL :
+
+- the defines go right after the #version line (at the top without one),
+  so the file can test them with #ifdef / #if like any other macro.
+- a line #include "file" is replaced by the file, looked up relative to the
+  file including it. includes nest, and every file goes in once per
+  source whoever includes it, as with #pragma once. included files have no
+  #version line.
+
+#line directives keep the compiler's error messages on the lines of the
+files : source string 0 is the shader file, the included files are 1, 2...
+in the order they were first included.*/
+class ShaderSource
+{
+public:
+	static std::string Process(const std::string& code, const std::string& path, const ShaderDefines& defines = ShaderDefines())
+	{
+		std::vector<std::string> included;
+		std::string source;
+		bool versionFound = false;
+		Expand(code, path, 0, &defines, included, source, versionFound);
+		if (!versionFound && !defines.IsEmpty())
+			source = defines.ToSource() + "#line 1 0\n" + source;
+		return source;
+	}
+
+	// the file name of a line #include "file", false for any other line
+	static bool ParseInclude(const std::string& line, std::string& file)
+	{
+		size_t start = line.find_first_not_of(" \t");
+		if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+			return false;
+		size_t open = line.find('"', start + 8);
+		size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+		if (close == std::string::npos)
+			return false;
+		file = line.substr(open + 1, close - open - 1);
+		return true;
+	}
+
+private:
+	// defines only for the shader file itself, not for what it includes
+	static void Expand(const std::string& code, const std::string& path, int sourceNumber, const ShaderDefines* defines,
+		std::vector<std::string>& included, std::string& source, bool& versionFound)
+	{
+		std::istringstream lines(code);
+		std::string line, file;
+		int lineNumber = 0;
+		while (std::getline(lines, line))
+		{
+			lineNumber++;
+			if (defines && !versionFound && line.compare(0, 8, "#version") == 0)
+			{
+				versionFound = true;
+				source += line + "\n";
+				if (!defines->IsEmpty())
+					source += defines->ToSource() + LineDirective(lineNumber + 1, sourceNumber);
+				continue;
+			}
+			if (!ParseInclude(line, file))
+			{
+				source += line + "\n";
+				continue;
+			}
+
+			std::string includePath = Directory(path) + file;
+			bool alreadyIncluded = false;
+			for (const std::string& other : included)
+				alreadyIncluded = alreadyIncluded || other == includePath;
+			std::string includeCode;
+			if (!alreadyIncluded && !ReadFile(includePath, includeCode))
+				std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND: " << includePath << " in " << path << std::endl;
+			else if (!alreadyIncluded)
+			{
+				included.push_back(includePath);
+				source += LineDirective(1, (int)included.size());
+				Expand(includeCode, includePath, (int)included.size(), NULL, included, source, versionFound);
+			}
+			source += LineDirective(lineNumber + 1, sourceNumber);
+		}
+	}
+
+	static bool ReadFile(const std::string& path, std::string& code)
+	{
+		std::ifstream file(path);
+		if (!file)
+			return false;
+		std::stringstream stream;
+		stream << file.rdbuf();
+		code = stream.str();
+		return true;
+	}
+
+	// the directory of path with its trailing '/', "" for a bare file name
+	static std::string Directory(const std::string& path)
+	{
+		size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+	}
+
+	static std::string LineDirective(int line, int sourceNumber)
+	{
+		return "#line " + std::to_string(line) + " " + std::to_string(sourceNumber) + "\n";
+	}
+};
@@ -0,0 +1,298 @@
+#pragma once
+
+/* Uniform locations of a program reflected once at link time, and the setters every Shader class shares */
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/frame_uniforms.h>
+#include <learnopengl/program_cache.h>
+#include <learnopengl/shader_link.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// a uniform of one program, from Shader::uniform(); slot -1 for uniforms the program does not use
+struct UniformHandle
+{
+    int slot = -1;
+};
+
+// what the Shader setters did since the last Reset, for per-frame counters
+struct UniformStats
+{
+    unsigned long sets = 0;       // setter calls
+    unsigned long uploads = 0;    // of those, the ones that reached GL; the rest repeated the value already set
+    unsigned long lookups = 0;    // glGetUniformLocation calls
+
+    static UniformStats& Get()
+    {
+        static UniformStats stats;
+        return stats;
+    }
+
+    void Reset()
+    {
+        sets = uploads = lookups = 0;
+    }
+};
+
+/*location and last value of every active uniform of a program. Reflect
+walks glGetActiveUniform after the link, so the name lookups of the setters
+are a hash lookup instead of a glGetUniformLocation. arrays are registered
+element by element, "lights[2]" as well as "lights" for the first one;
+names reflection did not produce are asked to GL once and remembered, even
+when the program does not have them.*/
+class UniformCache
+{
+public:
+    void Reflect(GLuint program)
+    {
+        m_Program = program;
+        m_Entries.clear();
+        m_Slots.clear();
+
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(std::max(maxLength, 1));
+        for (GLint i = 0; i < count; i++)
+        {
+            GLint size = 0;
+            GLenum type = GL_NONE;
+            GLsizei length = 0;
+            glGetActiveUniform(program, (GLuint)i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+            std::string name(buffer.data(), length);
+
+            // members of uniform blocks have no location
+            GLint location = glGetUniformLocation(program, name.c_str());
+            UniformStats::Get().lookups++;
+            if (location < 0)
+                continue;
+            if (size > 1 && name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            {
+                std::string base = name.substr(0, name.size() - 3);
+                m_Slots[base] = AddEntry(location);
+                m_Slots[name] = m_Slots[base];
+                for (GLint element = 1; element < size; element++)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    UniformStats::Get().lookups++;
+                    m_Slots[elementName] = AddEntry(glGetUniformLocation(program, elementName.c_str()));
+                }
+            }
+            else
+                m_Slots[name] = AddEntry(location);
+        }
+    }
+
+    int Find(const std::string& name)
+    {
+        auto found = m_Slots.find(name);
+        if (found != m_Slots.end())
+            return found->second;
+
+        UniformStats::Get().lookups++;
+        GLint location = glGetUniformLocation(m_Program, name.c_str());
+        int slot = location < 0 ? -1 : AddEntry(location);
+        m_Slots[name] = slot;
+        return slot;
+    }
+
+    GLint GetLocation(int slot) const
+    {
+        return m_Entries[slot].location;
+    }
+
+    // whether value differs from the last one set at slot, which it then becomes
+    bool Update(int slot, const void* value, size_t size)
+    {
+        UniformStats::Get().sets++;
+        Entry& entry = m_Entries[slot];
+        if (entry.size == size && std::memcmp(entry.value, value, size) == 0)
+            return false;
+        std::memcpy(entry.value, value, size);
+        entry.size = (unsigned int)size;
+        UniformStats::Get().uploads++;
+        return true;
+    }
+
+    // forgets the last values, so the next set of every uniform reaches GL
+    void Invalidate()
+    {
+        for (Entry& entry : m_Entries)
+            entry.size = 0;
+    }
+
+private:
+    struct Entry
+    {
+        GLint location;
+        unsigned int size;      // bytes of value in use, 0 before the first set
+        float value[16];
+    };
+
+    int AddEntry(GLint location)
+    {
+        Entry entry;
+        entry.location = location;
+        entry.size = 0;
+        m_Entries.push_back(entry);
+        return (int)m_Entries.size() - 1;
+    }
+
+    GLuint m_Program = 0;
+    std::vector<Entry> m_Entries;
+    std::unordered_map<std::string, int> m_Slots;
+};
+
+/*base of the Shader classes : the program ID, the end of its link and its
+uniform setters. the setters by name hash the name into the UniformCache,
+the ones by handle go straight to the slot; both skip a value equal to the
+last one set, which assumes the program's uniforms are only set through them
+(otherwise see invalidateUniforms). like glUniform, they act on the program
+in use.
+
+a link deferred by ShaderLinking is finished by the first use() or
+uniform(), so the constructor does not wait for the driver.*/
+class ShaderUniforms
+{
+public:
+    unsigned int ID;
+
+    // whether the program can be used without waiting for the driver to link it
+    bool isReady() const
+    {
+        return !linkPending || ShaderLinking::Get().IsComplete(ID);
+    }
+
+    // the uniform name, for the setters by handle; valid until the program is linked again
+    UniformHandle uniform(const std::string &name) const
+    {
+        completeLink();
+        UniformHandle handle;
+        handle.slot = uniformCache.Find(name);
+        return handle;
+    }
+
+    // after glUniform calls that did not go through the setters
+    void invalidateUniforms() const
+    {
+        uniformCache.Invalidate();
+    }
+
+    // utility uniform functions
+    // ------------------------------------------------------------------------
+    void setBool(const std::string &name, bool value) const { setInt(uniform(name), (int)value); }
+    void setBool(UniformHandle handle, bool value) const { setInt(handle, (int)value); }
+    // ------------------------------------------------------------------------
+    void setInt(const std::string &name, int value) const { setInt(uniform(name), value); }
+    void setInt(UniformHandle handle, int value) const
+    {
+        if (handle.slot >= 0 && uniformCache.Update(handle.slot, &value, sizeof(value)))
+            glUniform1i(uniformCache.GetLocation(handle.slot), value);
+    }
+    // ------------------------------------------------------------------------
+    void setFloat(const std::string &name, float value) const { setFloat(uniform(name), value); }
+    void setFloat(UniformHandle handle, float value) const
+    {
+        if (handle.slot >= 0 && uniformCache.Update(handle.slot, &value, sizeof(value)))
+            glUniform1f(uniformCache.GetLocation(handle.slot), value);
+    }
+    // ------------------------------------------------------------------------
+    void setVec2(const std::string &name, const glm::vec2 &value) const { setVec2(uniform(name), value); }
+    void setVec2(const std::string &name, float x, float y) const { setVec2(uniform(name), glm::vec2(x, y)); }
+    void setVec2(UniformHandle handle, const glm::vec2 &value) const
+    {
+        if (handle.slot >= 0 && uniformCache.Update(handle.slot, &value[0], sizeof(value)))
+            glUniform2fv(uniformCache.GetLocation(handle.slot), 1, &value[0]);
+    }
+    // ------------------------------------------------------------------------
+    void setVec3(const std::string &name, const glm::vec3 &value) const { setVec3(uniform(name), value); }
+    void setVec3(const std::string &name, float x, float y, float z) const { setVec3(uniform(name), glm::vec3(x, y, z)); }
+    void setVec3(UniformHandle handle, const glm::vec3 &value) const
+    {
+        if (handle.slot >= 0 && uniformCache.Update(handle.slot, &value[0], sizeof(value)))
+            glUniform3fv(uniformCache.GetLocation(handle.slot), 1, &value[0]);
+    }
+    // ------------------------------------------------------------------------
+    void setVec4(const std::string &name, const glm::vec4 &value) const { setVec4(uniform(name), value); }
+    void setVec4(const std::string &name, float x, float y, float z, float w) const { setVec4(uniform(name), glm::vec4(x, y, z, w)); }
+    void setVec4(UniformHandle handle, const glm::vec4 &value) const
+    {
+        if (handle.slot >= 0 && uniformCache.Update(handle.slot, &value[0], sizeof(value)))
+            glUniform4fv(uniformCache.GetLocation(handle.slot), 1, &value[0]);
+    }
+    // ------------------------------------------------------------------------
+    void setMat2(const std::string &name, const glm::mat2 &mat) const { setMat2(uniform(name), mat); }
+    void setMat2(UniformHandle handle, const glm::mat2 &mat) const
+    {
+        if (handle.slot >= 0 && uniformCache.Update(handle.slot, &mat[0][0], sizeof(mat)))
+            glUniformMatrix2fv(uniformCache.GetLocation(handle.slot), 1, GL_FALSE, &mat[0][0]);
+    }
+    // ------------------------------------------------------------------------
+    void setMat3(const std::string &name, const glm::mat3 &mat) const { setMat3(uniform(name), mat); }
+    void setMat3(UniformHandle handle, const glm::mat3 &mat) const
+    {
+        if (handle.slot >= 0 && uniformCache.Update(handle.slot, &mat[0][0], sizeof(mat)))
+            glUniformMatrix3fv(uniformCache.GetLocation(handle.slot), 1, GL_FALSE, &mat[0][0]);
+    }
+    // ------------------------------------------------------------------------
+    void setMat4(const std::string &name, const glm::mat4 &mat) const { setMat4(uniform(name), mat); }
+    void setMat4(UniformHandle handle, const glm::mat4 &mat) const
+    {
+        if (handle.slot >= 0 && uniformCache.Update(handle.slot, &mat[0][0], sizeof(mat)))
+            glUniformMatrix4fv(uniformCache.GetLocation(handle.slot), 1, GL_FALSE, &mat[0][0]);
+    }
+
+protected:
+    // after glLinkProgram : checks the stages and the link now, or at the first use when ShaderLinking defers them
+    void finishLink(const std::vector<ShaderStage> &stages, uint64_t programKey)
+    {
+        pendingStages = stages;
+        pendingKey = programKey;
+        linkPending = true;
+        if (!ShaderLinking::Get().IsDeferred())
+            completeLink();
+    }
+
+    // waits for a pending link, reports its errors, caches its binary and reflects its uniforms
+    void completeLink() const
+    {
+        if (!linkPending)
+            return;
+        linkPending = false;
+        bool compiled = true;
+        for (const ShaderStage &stage : pendingStages)
+            compiled = ShaderLinking::CheckCompile(stage) && compiled;
+        if (ShaderLinking::CheckLink(ID) && compiled)
+            ProgramCache::Get().Store(ID, pendingKey);
+        reflectUniforms();
+        // delete the shaders as they're linked into our program now and no longer necessary
+        for (const ShaderStage &stage : pendingStages)
+            glDeleteShader(stage.shader);
+        pendingStages.clear();
+    }
+
+    // after every successful link; also attaches the program's frame blocks (FrameUniforms::Blocks) to their binding points
+    void reflectUniforms() const
+    {
+        uniformCache.Reflect(ID);
+        for (int block = 0; block < FRAME_BLOCK_COUNT; block++)
+            bindFrameBlock(FrameUniforms::Blocks()[block].name, FrameUniforms::Blocks()[block].binding);
+    }
+
+    void bindFrameBlock(const char *name, GLuint binding) const
+    {
+        GLuint index = glGetUniformBlockIndex(ID, name);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
+    }
+
+    mutable UniformCache uniformCache;
+    mutable bool linkPending = false;
+    mutable std::vector<ShaderStage> pendingStages;
+    uint64_t pendingKey = 0;
+};
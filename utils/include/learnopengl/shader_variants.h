@@ -0,0 +1,46 @@
+#pragma once
+
+/* Specialized versions of one shader, compiled the first time they are asked for */
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <learnopengl/shader_source.h>
+
+/*each set of defines is one variant of the shader files, built as
+ShaderType(vertexPath, fragmentPath, defines) on its first Get and kept for
+the next ones. the files test the defines with #ifdef / #if, so a variant
+has no loop or branch for the features its mesh or material lacks, which
+the generic shader (no defines) has to keep.
+
+Get builds a key string, so callers pick the variant of a mesh or material
+once and keep the reference; references stay valid as long as the
+ShaderVariants.*/
+template <typename ShaderType>
+class ShaderVariants
+{
+public:
+	ShaderVariants(const std::string& vertexPath, const std::string& fragmentPath)
+		: m_VertexPath(vertexPath), m_FragmentPath(fragmentPath)
+	{
+	}
+
+	ShaderVariants(const ShaderVariants&) = delete;
+	ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+	// GL thread. the variant for defines, compiled on the first request (deferred like any Shader when ShaderLinking defers)
+	ShaderType& Get(const ShaderDefines& defines = ShaderDefines())
+	{
+		std::unique_ptr<ShaderType>& variant = m_Variants[defines.Key()];
+		if (!variant)
+			variant.reset(new ShaderType(m_VertexPath.c_str(), m_FragmentPath.c_str(), defines));
+		return *variant;
+	}
+
+	// variants compiled so far
+	size_t GetCount() const { return m_Variants.size(); }
+
+private:
+	std::string m_VertexPath, m_FragmentPath;
+	std::unordered_map<std::string, std::unique_ptr<ShaderType>> m_Variants;
+};
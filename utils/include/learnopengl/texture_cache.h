@@ -0,0 +1,363 @@
+#pragma once
+
+/* Process-wide cache of textures loaded from image files, decoded on a thread pool */
+
+#include <glad/glad.h>
+#include <stb_image.h>
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <learnopengl/cache_directory.h>
+#include <learnopengl/compressed_texture.h>
+#include <learnopengl/worker_pool.h>
+
+struct TextureRequest
+{
+	std::string path;
+	bool flip;	//flip vertically, for images stored top row first
+};
+
+// 8 bit pixels from stb_image, freed with the image
+struct DecodedImage
+{
+	unsigned char* data = nullptr;
+	int width = 0, height = 0, nrComponents = 0;
+
+	DecodedImage() {}
+	DecodedImage(DecodedImage&& other) { *this = std::move(other); }
+	DecodedImage& operator=(DecodedImage&& other)
+	{
+		std::swap(data, other.data);
+		width = other.width;
+		height = other.height;
+		nrComponents = other.nrComponents;
+		return *this;
+	}
+	~DecodedImage() { stbi_image_free(data); }
+};
+
+// what a worker hands to the GL thread : blocks when compression is on, else pixels
+struct PreparedTexture
+{
+	DecodedImage image;
+	CompressedImage compressed;
+};
+
+/*textures are keyed by canonical path and flip, so models that share image
+files (or name them through different relative paths) share one texture.
+
+Load decodes every missing texture of a batch at once : the calling thread
+and the pool's workers take images through an atomic counter, then the
+calling thread uploads them. the cache itself can be queried from any thread,
+uploads have to run on the GL thread.
+
+with compression on, a worker reads the image's KTX file from the cache
+directory when it was written for the image as it is now, else transcodes
+the image with TextureCompressor and writes the file for the next run. the
+files are named after the texture's key, so nothing is written next to the
+images (demos use an ignored texture_cache/ next to their sources).
+
+stb_image 2.22 only has a global flip flag (no per thread one, no getter),
+which is not safe to change while other threads decode. the cache turns it
+off once and flips rows itself per request, so code decoding with stb on its
+own sets the flag only around its stbi_load calls and turns it back off.*/
+class TextureCache
+{
+public:
+	static TextureCache& Get()
+	{
+		static TextureCache cache;
+		return cache;
+	}
+
+	TextureCache(const TextureCache&) = delete;
+	TextureCache& operator=(const TextureCache&) = delete;
+
+	// GL thread. returns one texture per request, decoding and uploading the ones not cached yet
+	std::vector<unsigned int> Load(const std::vector<TextureRequest>& requests)
+	{
+		std::vector<unsigned int> ids(requests.size(), 0);
+		std::vector<std::string> keys(requests.size());
+		std::unordered_map<std::string, int> missing;	//key -> index in m_Batch
+		std::vector<int> batchIndex(requests.size(), -1);
+
+		std::lock_guard<std::mutex> batchLock(m_BatchMutex);
+		m_Batch.clear();
+		for (size_t i = 0; i < requests.size(); i++)
+		{
+			keys[i] = Key(requests[i].path, requests[i].flip);
+			if (Find(keys[i], ids[i]))
+				continue;
+			auto found = missing.find(keys[i]);
+			if (found == missing.end())
+			{
+				found = missing.insert(std::make_pair(keys[i], (int)m_Batch.size())).first;
+				m_Batch.push_back(BatchItem{ &requests[i], keys[i], PreparedTexture() });
+			}
+			batchIndex[i] = found->second;
+		}
+
+		DecodeBatch();
+
+		std::vector<unsigned int> uploaded(m_Batch.size());
+		for (size_t b = 0; b < m_Batch.size(); b++)
+			uploaded[b] = Insert(m_Batch[b].key, m_Batch[b].texture);
+		for (size_t i = 0; i < requests.size(); i++)
+		{
+			if (batchIndex[i] >= 0)
+				ids[i] = uploaded[batchIndex[i]];
+		}
+		m_Batch.clear();
+		return ids;
+	}
+
+	unsigned int Load(const std::string& path, bool flip)
+	{
+		return Load(std::vector<TextureRequest>{ TextureRequest{ path, flip } })[0];
+	}
+
+	/*GL thread, between loads. compresses the textures loaded from now on, if
+	the GL supports it, and keeps their KTX files in cacheDirectory (created
+	if missing; "" transcodes on every load). returns whether it compresses*/
+	bool SetCompression(bool enable, const std::string& cacheDirectory = "")
+	{
+		m_Compression = enable && TextureCompressor::IsSupported();
+		m_CacheDirectory = m_Compression && !cacheDirectory.empty() && MakeCacheDirectory(cacheDirectory) ? cacheDirectory : "";
+		return m_Compression;
+	}
+
+	// the KTX file of request in the cache directory, "" without one
+	std::string CachePath(const TextureRequest& request) const
+	{
+		if (m_CacheDirectory.empty())
+			return "";
+		// 64 bit FNV-1a of the key
+		std::string key = Key(request.path, request.flip);
+		uint64_t hash = 14695981039346656037ull;
+		for (char c : key)
+			hash = (hash ^ (unsigned char)c) * 1099511628211ull;
+		char name[32];
+		std::snprintf(name, sizeof(name), "/%016llx.ktx", (unsigned long long)hash);
+		return m_CacheDirectory + name;
+	}
+
+	bool GetCompression() const { return m_Compression; }
+
+	// any thread. the texture data of a request, ready for Insert
+	PreparedTexture Prepare(const TextureRequest& request) const
+	{
+		PreparedTexture texture;
+		if (!m_Compression)
+		{
+			texture.image = Decode(request.path, request.flip);
+			return texture;
+		}
+
+		std::string ktxPath = CachePath(request);
+		uint64_t stamp = TextureCompressor::SourceStamp(request.path);
+		if (stamp != 0 && !ktxPath.empty() && TextureCompressor::ReadKtx(ktxPath, stamp, texture.compressed))
+			return texture;
+
+		DecodedImage image = Decode(request.path, request.flip);
+		if (!image.data)
+		{
+			texture.compressed = CompressedImage();
+			return texture;
+		}
+		texture.compressed = TextureCompressor::Compress(image.data, image.width, image.height, image.nrComponents);
+		if (!ktxPath.empty())
+			TextureCompressor::WriteKtx(ktxPath, stamp, texture.compressed);
+		return texture;
+	}
+
+	// any thread. reports a failed decode and returns an empty image
+	static DecodedImage Decode(const std::string& path, bool flip)
+	{
+		DecodedImage image;
+		image.data = stbi_load(path.c_str(), &image.width, &image.height, &image.nrComponents, 0);
+		if (!image.data)
+		{
+			std::cout << "Texture failed to load at path: " << path << std::endl;
+			return image;
+		}
+		if (flip)
+		{
+			size_t rowSize = (size_t)image.width * image.nrComponents;
+			std::vector<unsigned char> row(rowSize);
+			for (int y = 0; y < image.height / 2; y++)
+			{
+				unsigned char* top = image.data + y * rowSize;
+				unsigned char* bottom = image.data + (image.height - 1 - y) * rowSize;
+				std::memcpy(row.data(), top, rowSize);
+				std::memcpy(top, bottom, rowSize);
+				std::memcpy(bottom, row.data(), rowSize);
+			}
+		}
+		return image;
+	}
+
+	// canonical path of the file, plus the flip option
+	static std::string Key(const std::string& path, bool flip)
+	{
+		std::string key = path;
+#ifdef _WIN32
+		char resolved[_MAX_PATH];
+		if (_fullpath(resolved, path.c_str(), _MAX_PATH))
+			key = resolved;
+#else
+		char resolved[PATH_MAX];
+		if (realpath(path.c_str(), resolved))
+			key = resolved;
+#endif
+		return key + (flip ? "|flip" : "|");
+	}
+
+	// any thread
+	bool Find(const std::string& key, unsigned int& id) const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto found = m_Textures.find(key);
+		if (found == m_Textures.end())
+			return false;
+		id = found->second;
+		return true;
+	}
+
+	// GL thread. uploads texture under key, or returns the texture another load already cached under it
+	unsigned int Insert(const std::string& key, const PreparedTexture& texture)
+	{
+		unsigned int id;
+		if (Find(key, id))
+			return id;
+
+		size_t bytes;
+		if (!texture.compressed.Empty())
+		{
+			id = TextureCompressor::Upload(texture.compressed);
+			bytes = texture.compressed.GetBytes();
+		}
+		else
+		{
+			id = Upload(texture.image);
+			//the mip chain adds a third
+			bytes = (size_t)texture.image.width * texture.image.height * texture.image.nrComponents * 4 / 3;
+		}
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Textures[key] = id;
+		m_Bytes[id] = bytes;
+		return id;
+	}
+
+	// GL thread. creates a mipmapped texture, left empty when the image failed to decode
+	static unsigned int Upload(const DecodedImage& image)
+	{
+		unsigned int textureID;
+		glGenTextures(1, &textureID);
+		if (!image.data)
+			return textureID;
+
+		GLenum format = GL_RED;
+		if (image.nrComponents == 1)
+			format = GL_RED;
+		else if (image.nrComponents == 3)
+			format = GL_RGB;
+		else if (image.nrComponents == 4)
+			format = GL_RGBA;
+
+		glBindTexture(GL_TEXTURE_2D, textureID);
+		glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
+		glGenerateMipmap(GL_TEXTURE_2D);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		return textureID;
+	}
+
+	// GL thread. deletes every cached texture; models still holding their ids must not be drawn afterwards
+	void Clear()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (auto& texture : m_Textures)
+			glDeleteTextures(1, &texture.second);
+		m_Textures.clear();
+		m_Bytes.clear();
+	}
+
+	// video memory of a cached texture, mips included
+	size_t GetTextureBytes(unsigned int id) const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto found = m_Bytes.find(id);
+		return found == m_Bytes.end() ? 0 : found->second;
+	}
+
+	size_t GetSize() const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Textures.size();
+	}
+
+	int GetThreadCount() const { return m_Pool.GetWorkerCount() + 1; }
+
+private:
+	struct BatchItem
+	{
+		const TextureRequest* request;
+		std::string key;
+		PreparedTexture texture;
+	};
+
+	TextureCache()
+		:
+		m_Compression(false),
+		m_NextItem(0),
+		m_Pool(WorkerPool::ThreadCount(0) - 1)
+	{
+		stbi_set_flip_vertically_on_load(false);
+	}
+
+	// decodes m_Batch on the workers and the calling thread, returns once every image is done
+	void DecodeBatch()
+	{
+		if (m_Batch.empty())
+			return;
+		m_NextItem = 0;
+		if (m_Batch.size() > 1)
+			m_Pool.Run([this](int) { DecodeItems(); });
+		else
+			DecodeItems();
+	}
+
+	void DecodeItems()
+	{
+		int item;
+		while ((item = m_NextItem.fetch_add(1)) < (int)m_Batch.size())
+			m_Batch[item].texture = Prepare(*m_Batch[item].request);
+	}
+
+	mutable std::mutex m_Mutex;
+	std::unordered_map<std::string, unsigned int> m_Textures;
+	std::unordered_map<unsigned int, size_t> m_Bytes;
+	std::atomic<bool> m_Compression;
+	std::string m_CacheDirectory;	//KTX files, "" for none
+
+	//one batch at a time
+	std::mutex m_BatchMutex;
+	std::vector<BatchItem> m_Batch;
+	std::atomic<int> m_NextItem;
+
+	WorkerPool m_Pool;	//last, so its workers stop before the members they use go
+};
@@ -0,0 +1,144 @@
+#pragma once
+
+/* Worker threads for the parallel utilities : fork-join runs and a job queue */
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*Run hands one task to every worker and to the calling thread, and returns
+once all of them are done : the frame-synchronous work of CpuSkinningEngine,
+AnimatorPool and TextureCache, which split it themselves (atomic counters,
+work stealing queues) by the thread index the task gets. Post queues a job
+for the first free worker : the imports and decodes of AsyncModelLoader.
+
+every user owns its own pool, so a long import never holds up a frame's
+skinning. one Run at a time; a Run waits for the jobs the workers are busy
+with. jobs still queued when the pool is destroyed are dropped.*/
+class WorkerPool
+{
+public:
+	// threads for a request of numThreads, 0 meaning every hardware thread
+	static unsigned int ThreadCount(unsigned int numThreads)
+	{
+		if (numThreads == 0)
+			numThreads = std::thread::hardware_concurrency();
+		return numThreads > 0 ? numThreads : 1;
+	}
+
+	WorkerPool(unsigned int numWorkers)
+		:
+		m_Task(NULL),
+		m_Generation(0),
+		m_Quit(false),
+		m_Busy(0)
+	{
+		for (unsigned int i = 0; i < numWorkers; i++)
+			m_Workers.push_back(std::thread(&WorkerPool::WorkerLoop, this, (int)i + 1));
+	}
+
+	~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Quit = true;
+		}
+		m_Wake.notify_all();
+		for (auto& worker : m_Workers)
+			worker.join();
+	}
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	// runs task(0) on the calling thread and task(1..GetWorkerCount()) on the workers, returns when all returned
+	void Run(const std::function<void(int)>& task)
+	{
+		if (m_Workers.empty())
+		{
+			task(0);
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Task = &task;
+			m_Busy = (int)m_Workers.size();
+			m_Generation++;
+		}
+		m_Wake.notify_all();
+
+		task(0);
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Done.wait(lock, [this] { return m_Busy == 0; });
+		m_Task = NULL;
+	}
+
+	// queues job for the first free worker and returns at once
+	void Post(std::function<void()> job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Jobs.push_back(std::move(job));
+		}
+		m_Wake.notify_one();
+	}
+
+	int GetWorkerCount() const { return (int)m_Workers.size(); }
+
+private:
+	void WorkerLoop(int index)
+	{
+		unsigned long long generation = 0;
+		while (true)
+		{
+			std::function<void()> job;
+			const std::function<void(int)>* task = NULL;
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_Wake.wait(lock, [&] { return m_Quit || m_Generation != generation || !m_Jobs.empty(); });
+				if (m_Quit)
+					return;
+				//a Run goes before the queue, the calling thread is waiting for it
+				if (m_Generation != generation)
+				{
+					generation = m_Generation;
+					task = m_Task;
+				}
+				else
+				{
+					job = std::move(m_Jobs.front());
+					m_Jobs.pop_front();
+				}
+			}
+
+			if (job)
+			{
+				job();
+				continue;
+			}
+
+			(*task)(index);
+			bool last;
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				last = --m_Busy == 0;
+			}
+			if (last)
+				m_Done.notify_one();
+		}
+	}
+
+	std::vector<std::thread> m_Workers;
+	std::mutex m_Mutex;
+	std::condition_variable m_Wake;
+	std::condition_variable m_Done;
+	std::deque<std::function<void()>> m_Jobs;
+	const std::function<void(int)>* m_Task;	//of the current Run
+	unsigned long long m_Generation;	//Runs so far
+	bool m_Quit;
+	int m_Busy;	//workers still in the current Run
+};